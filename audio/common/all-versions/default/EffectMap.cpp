@@ -34,21 +34,25 @@ uint64_t EffectMap::makeUniqueId() {
 uint64_t EffectMap::add(effect_handle_t handle) {
     uint64_t newId = makeUniqueId();
     std::lock_guard<std::mutex> lock(mLock);
-    mEffects.add(newId, handle);
+    std::shared_ptr<Effects> effects = std::make_shared<Effects>(*mEffects);
+    effects->add(newId, handle);
+    std::atomic_store(&mEffects, std::shared_ptr<const Effects>(std::move(effects)));
     return newId;
 }
 
 effect_handle_t EffectMap::get(const uint64_t& id) {
-    std::lock_guard<std::mutex> lock(mLock);
-    ssize_t idx = mEffects.indexOfKey(id);
-    return idx >= 0 ? mEffects[idx] : NULL;
+    std::shared_ptr<const Effects> effects = std::atomic_load(&mEffects);
+    ssize_t idx = effects->indexOfKey(id);
+    return idx >= 0 ? effects->valueAt(idx) : NULL;
 }
 
 void EffectMap::remove(effect_handle_t handle) {
     std::lock_guard<std::mutex> lock(mLock);
-    for (size_t i = 0; i < mEffects.size(); ++i) {
-        if (mEffects[i] == handle) {
-            mEffects.removeItemsAt(i);
+    for (size_t i = 0; i < mEffects->size(); ++i) {
+        if (mEffects->valueAt(i) == handle) {
+            std::shared_ptr<Effects> effects = std::make_shared<Effects>(*mEffects);
+            effects->removeItemsAt(i);
+            std::atomic_store(&mEffects, std::shared_ptr<const Effects>(std::move(effects)));
             break;
         }
     }
@@ -17,6 +17,7 @@
 #ifndef android_hardware_audio_common_EffectMap_H_
 #define android_hardware_audio_common_EffectMap_H_
 
+#include <memory>
 #include <mutex>
 
 #include <hardware/audio_effect.h>
@@ -35,10 +36,15 @@ class EffectMap : public Singleton<EffectMap> {
     void remove(effect_handle_t handle);
 
    private:
+    typedef KeyedVector<uint64_t, effect_handle_t> Effects;
+
     static uint64_t makeUniqueId();
 
+    // 'get' takes a reference to the current snapshot of the map and doesn't contend on
+    // mLock. std::atomic_load of a shared_ptr still takes a short internal lock, so this
+    // is not lock-free. Updates are serialized by mLock and publish a modified copy.
     std::mutex mLock;
-    KeyedVector<uint64_t, effect_handle_t> mEffects;
+    std::shared_ptr<const Effects> mEffects = std::make_shared<const Effects>();
 };
 
 }  // namespace android
@@ -21,6 +21,7 @@
 
 #include "Device.h"
 #include "Stream.h"
+#include "StreamTimingStats.h"
 
 #define AUDIO_HAL_VERSION V4_0
 #include <core/all-versions/default/StreamIn.h>
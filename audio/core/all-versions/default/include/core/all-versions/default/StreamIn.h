@@ -129,6 +129,7 @@ struct StreamIn : public IStreamIn {
     EventFlag* mEfGroup;
     std::atomic<bool> mStopReadThread;
     sp<Thread> mReadThread;
+    StreamTimingStats mTimingStats;
 
     virtual ~StreamIn();
 };
@@ -41,7 +41,8 @@ class ReadThread : public Thread {
    public:
     // ReadThread's lifespan never exceeds StreamIn's lifespan.
     ReadThread(std::atomic<bool>* stop, audio_stream_in_t* stream, StreamIn::CommandMQ* commandMQ,
-               StreamIn::DataMQ* dataMQ, StreamIn::StatusMQ* statusMQ, EventFlag* efGroup)
+               StreamIn::DataMQ* dataMQ, StreamIn::StatusMQ* statusMQ, EventFlag* efGroup,
+               StreamTimingStats* timingStats)
         : Thread(false /*canCallJava*/),
           mStop(stop),
           mStream(stream),
@@ -49,6 +50,7 @@ class ReadThread : public Thread {
           mDataMQ(dataMQ),
           mStatusMQ(statusMQ),
           mEfGroup(efGroup),
+          mTimingStats(timingStats),
           mBuffer(nullptr) {}
     bool init() {
         mBuffer.reset(new (std::nothrow) uint8_t[mDataMQ->getQuantumCount()]);
@@ -63,6 +65,7 @@ class ReadThread : public Thread {
     StreamIn::DataMQ* mDataMQ;
     StreamIn::StatusMQ* mStatusMQ;
     EventFlag* mEfGroup;
+    StreamTimingStats* mTimingStats;
     std::unique_ptr<uint8_t[]> mBuffer;
     IStreamIn::ReadParameters mParameters;
     IStreamIn::ReadStatus mStatus;
@@ -74,6 +77,7 @@ class ReadThread : public Thread {
 };
 
 void ReadThread::doRead() {
+    mTimingStats->onWakeup();
     size_t availableToWrite = mDataMQ->availableToWrite();
     size_t requestedToRead = mParameters.params.read;
     if (requestedToRead > availableToWrite) {
@@ -82,12 +86,26 @@ void ReadThread::doRead() {
             "space",
             (int32_t)requestedToRead, (int32_t)availableToWrite);
         requestedToRead = availableToWrite;
+        mTimingStats->onQueueFull();
     }
-    ssize_t readResult = mStream->read(mStream, &mBuffer[0], requestedToRead);
+    // Let the HAL read straight into the queue if the free space is
+    // contiguous, and only bounce the data through mBuffer when it would wrap
+    // around the ring end.
+    StreamIn::DataMQ::MemTransaction tx;
+    const bool inPlace = mDataMQ->beginWrite(requestedToRead, &tx) &&
+                         tx.getFirstRegion().getLength() >= requestedToRead;
+    uint8_t* data = inPlace ? tx.getFirstRegion().getAddress() : &mBuffer[0];
+    const nsecs_t readStartNs = systemTime(SYSTEM_TIME_MONOTONIC);
+    ssize_t readResult = mStream->read(mStream, data, requestedToRead);
+    mTimingStats->onTransfer(readStartNs, requestedToRead, readResult);
     mStatus.retval = Result::OK;
     if (readResult >= 0) {
         mStatus.reply.read = readResult;
-        if (!mDataMQ->write(&mBuffer[0], readResult)) {
+        if (inPlace) {
+            if (!mDataMQ->commitWrite(readResult)) {
+                ALOGW("data message queue write commit failed");
+            }
+        } else if (!mDataMQ->write(&mBuffer[0], readResult)) {
             ALOGW("data message queue write failed");
         }
     } else {
@@ -389,7 +407,8 @@ Return<void> StreamIn::prepareForReading(uint32_t frameSize, uint32_t framesCoun
     // Create and launch the thread.
     auto tempReadThread =
         std::make_unique<ReadThread>(&mStopReadThread, mStream, tempCommandMQ.get(),
-                                     tempDataMQ.get(), tempStatusMQ.get(), tempElfGroup.get());
+                                     tempDataMQ.get(), tempStatusMQ.get(), tempElfGroup.get(),
+                                     &mTimingStats);
     if (!tempReadThread->init()) {
         ALOGW("failed to start reader thread: %s", strerror(-status));
         sendError(Result::INVALID_ARGUMENTS);
@@ -445,7 +464,11 @@ Return<void> StreamIn::getCapturePosition(getCapturePosition_cb _hidl_cb) {
 }
 
 Return<void> StreamIn::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& options) {
-    return mStreamCommon->debug(fd, options);
+    mStreamCommon->debug(fd, options);
+    if (fd.getNativeHandle() != nullptr && fd->numFds == 1 && mReadThread.get()) {
+        mTimingStats.dump(fd->data[0], "read latency");
+    }
+    return Void();
 }
 
 #ifdef AUDIO_HAL_VERSION_4_0
@@ -141,6 +141,7 @@ struct StreamOut : public IStreamOut {
     EventFlag* mEfGroup;
     std::atomic<bool> mStopWriteThread;
     sp<Thread> mWriteThread;
+    StreamTimingStats mTimingStats;
 
     virtual ~StreamOut();
 
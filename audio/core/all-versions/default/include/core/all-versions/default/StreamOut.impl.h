@@ -40,7 +40,8 @@ class WriteThread : public Thread {
     // WriteThread's lifespan never exceeds StreamOut's lifespan.
     WriteThread(std::atomic<bool>* stop, audio_stream_out_t* stream,
                 StreamOut::CommandMQ* commandMQ, StreamOut::DataMQ* dataMQ,
-                StreamOut::StatusMQ* statusMQ, EventFlag* efGroup)
+                StreamOut::StatusMQ* statusMQ, EventFlag* efGroup,
+                StreamTimingStats* timingStats)
         : Thread(false /*canCallJava*/),
           mStop(stop),
           mStream(stream),
@@ -48,6 +49,7 @@ class WriteThread : public Thread {
           mDataMQ(dataMQ),
           mStatusMQ(statusMQ),
           mEfGroup(efGroup),
+          mTimingStats(timingStats),
           mBuffer(nullptr) {}
     bool init() {
         mBuffer.reset(new (std::nothrow) uint8_t[mDataMQ->getQuantumCount()]);
@@ -62,6 +64,7 @@ class WriteThread : public Thread {
     StreamOut::DataMQ* mDataMQ;
     StreamOut::StatusMQ* mStatusMQ;
     EventFlag* mEfGroup;
+    StreamTimingStats* mTimingStats;
     std::unique_ptr<uint8_t[]> mBuffer;
     IStreamOut::WriteStatus mStatus;
 
@@ -73,16 +76,36 @@ class WriteThread : public Thread {
 };
 
 void WriteThread::doWrite() {
+    mTimingStats->onWakeup();
     const size_t availToRead = mDataMQ->availableToRead();
     mStatus.retval = Result::OK;
     mStatus.reply.written = 0;
-    if (mDataMQ->read(&mBuffer[0], availToRead)) {
-        ssize_t writeResult = mStream->write(mStream, &mBuffer[0], availToRead);
-        if (writeResult >= 0) {
-            mStatus.reply.written = writeResult;
-        } else {
-            mStatus.retval = Stream::analyzeStatus("write", writeResult);
+    if (availToRead == mDataMQ->getQuantumCount()) {
+        mTimingStats->onQueueFull();
+    }
+    StreamOut::DataMQ::MemTransaction tx;
+    if (!mDataMQ->beginRead(availToRead, &tx)) {
+        return;
+    }
+    // Hand the data to the HAL straight from the queue if it is contiguous,
+    // and only bounce it through mBuffer when it wraps around the ring end.
+    const uint8_t* data = tx.getFirstRegion().getAddress();
+    if (tx.getFirstRegion().getLength() < availToRead) {
+        if (!tx.copyFrom(&mBuffer[0], 0, availToRead)) {
+            ALOGE("failed to copy data from the data message queue");
+            mDataMQ->commitRead(availToRead);
+            return;
         }
+        data = &mBuffer[0];
+    }
+    const nsecs_t writeStartNs = systemTime(SYSTEM_TIME_MONOTONIC);
+    ssize_t writeResult = mStream->write(mStream, data, availToRead);
+    mTimingStats->onTransfer(writeStartNs, availToRead, writeResult);
+    mDataMQ->commitRead(availToRead);
+    if (writeResult >= 0) {
+        mStatus.reply.written = writeResult;
+    } else {
+        mStatus.retval = Stream::analyzeStatus("write", writeResult);
     }
 }
 
@@ -372,7 +395,8 @@ Return<void> StreamOut::prepareForWriting(uint32_t frameSize, uint32_t framesCou
     // Create and launch the thread.
     auto tempWriteThread =
         std::make_unique<WriteThread>(&mStopWriteThread, mStream, tempCommandMQ.get(),
-                                      tempDataMQ.get(), tempStatusMQ.get(), tempElfGroup.get());
+                                      tempDataMQ.get(), tempStatusMQ.get(), tempElfGroup.get(),
+                                      &mTimingStats);
     if (!tempWriteThread->init()) {
         ALOGW("failed to start writer thread: %s", strerror(-status));
         sendError(Result::INVALID_ARGUMENTS);
@@ -542,7 +566,11 @@ Return<void> StreamOut::getMmapPosition(getMmapPosition_cb _hidl_cb) {
 }
 
 Return<void> StreamOut::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& options) {
-    return mStreamCommon->debug(fd, options);
+    mStreamCommon->debug(fd, options);
+    if (fd.getNativeHandle() != nullptr && fd->numFds == 1 && mWriteThread.get()) {
+        mTimingStats.dump(fd->data[0], "write latency");
+    }
+    return Void();
 }
 
 #ifdef AUDIO_HAL_VERSION_4_0
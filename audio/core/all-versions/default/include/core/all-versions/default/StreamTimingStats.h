@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <common/all-versions/IncludeGuard.h>
+
+#include <stdio.h>
+
+#include <array>
+#include <atomic>
+
+#include <utils/Timers.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace AUDIO_HAL_VERSION {
+namespace implementation {
+
+/** Histogram of durations with power of two microsecond buckets.
+ * Updates are lock-free so that it can be fed from the audio I/O thread
+ * and dumped concurrently from a binder thread.
+ */
+class DurationHistogram {
+   public:
+    /** Bucket i counts durations in [2^(i-1), 2^i) us, the last bucket
+     * also counts everything longer. */
+    static constexpr size_t kBucketCount = 18;  // Last bucket starts at 65ms.
+
+    void record(nsecs_t duration) {
+        uint64_t us = duration > 0 ? static_cast<uint64_t>(duration) / 1000 : 0;
+        size_t bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+        if (bucket >= kBucketCount) bucket = kBucketCount - 1;
+        mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        mCount.fetch_add(1, std::memory_order_relaxed);
+        mTotalNs.fetch_add(duration > 0 ? duration : 0, std::memory_order_relaxed);
+        nsecs_t max = mMaxNs.load(std::memory_order_relaxed);
+        while (duration > max &&
+               !mMaxNs.compare_exchange_weak(max, duration, std::memory_order_relaxed)) {
+        }
+    }
+
+    void dump(int fd, const char* name) const {
+        const uint64_t count = mCount.load(std::memory_order_relaxed);
+        const uint64_t avgUs =
+            count != 0 ? mTotalNs.load(std::memory_order_relaxed) / count / 1000 : 0;
+        dprintf(fd, "  %s: count %llu, avg %lluus, max %lldus\n", name,
+                (unsigned long long)count, (unsigned long long)avgUs,
+                (long long)(mMaxNs.load(std::memory_order_relaxed) / 1000));
+        if (count == 0) return;
+        dprintf(fd, "   ");
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            const uint32_t bucketCount = mBuckets[i].load(std::memory_order_relaxed);
+            if (bucketCount == 0) continue;
+            dprintf(fd, " %s%lluus:%u", i + 1 == kBucketCount ? ">=" : "<",
+                    i + 1 == kBucketCount ? 1ULL << (i - 1) : 1ULL << i, bucketCount);
+        }
+        dprintf(fd, "\n");
+    }
+
+   private:
+    std::array<std::atomic<uint32_t>, kBucketCount> mBuckets{};
+    std::atomic<uint64_t> mCount{0};
+    std::atomic<uint64_t> mTotalNs{0};
+    std::atomic<nsecs_t> mMaxNs{0};
+};
+
+/** Timing statistics of a stream I/O thread (WriteThread or ReadThread).
+ * Only the I/O thread updates the statistics, any thread can dump them.
+ */
+class StreamTimingStats {
+   public:
+    /** Called each time the I/O thread is woken up to transfer data. */
+    void onWakeup() {
+        const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (mLastWakeupNs != 0) {
+            const nsecs_t interval = now - mLastWakeupNs;
+            if (mLastIntervalNs != 0) {
+                mWakeupJitter.record(interval > mLastIntervalNs ? interval - mLastIntervalNs
+                                                                : mLastIntervalNs - interval);
+            }
+            mLastIntervalNs = interval;
+        }
+        mLastWakeupNs = now;
+    }
+
+    /** Called after each call to the legacy HAL read or write. */
+    void onTransfer(nsecs_t startNs, size_t requested, ssize_t transferred) {
+        mTransferLatency.record(systemTime(SYSTEM_TIME_MONOTONIC) - startNs);
+        if (transferred < 0) {
+            mErrors.fetch_add(1, std::memory_order_relaxed);
+        } else if (static_cast<size_t>(transferred) < requested) {
+            mShortTransfers.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /** Called when the data message queue limits the size of a transfer. */
+    void onQueueFull() { mQueueFull.fetch_add(1, std::memory_order_relaxed); }
+
+    void dump(int fd, const char* transferName) const {
+        dprintf(fd, " Stream I/O thread timing:\n");
+        mTransferLatency.dump(fd, transferName);
+        mWakeupJitter.dump(fd, "wakeup jitter");
+        dprintf(fd, "  short transfers: %u, errors: %u, data MQ full: %u\n",
+                mShortTransfers.load(std::memory_order_relaxed),
+                mErrors.load(std::memory_order_relaxed),
+                mQueueFull.load(std::memory_order_relaxed));
+    }
+
+   private:
+    // Only accessed by the I/O thread.
+    nsecs_t mLastWakeupNs = 0;
+    nsecs_t mLastIntervalNs = 0;
+
+    DurationHistogram mTransferLatency;
+    DurationHistogram mWakeupJitter;
+    std::atomic<uint32_t> mShortTransfers{0};
+    std::atomic<uint32_t> mErrors{0};
+    std::atomic<uint32_t> mQueueFull{0};
+};
+
+}  // namespace implementation
+}  // namespace AUDIO_HAL_VERSION
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
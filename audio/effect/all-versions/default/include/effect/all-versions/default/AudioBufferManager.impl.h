@@ -45,9 +45,15 @@ bool AudioBufferManager::wrap(const AudioBuffer& buffer, sp<AudioBufferWrapper>*
 }
 
 void AudioBufferManager::removeEntry(uint64_t id) {
+    // Declared before the lock so that it is released after it, a replacement wrapper
+    // destroyed here calls back into removeEntry.
+    sp<AudioBufferWrapper> replacement;
     std::lock_guard<std::mutex> lock(mLock);
     ssize_t idx = mBuffers.indexOfKey(id);
-    if (idx >= 0) mBuffers.removeItemsAt(idx);
+    if (idx < 0) return;
+    // The entry may already have been replaced by a new wrapper for the same buffer.
+    replacement = mBuffers[idx].promote();
+    if (replacement == nullptr) mBuffers.removeItemsAt(idx);
 }
 
 namespace hardware {
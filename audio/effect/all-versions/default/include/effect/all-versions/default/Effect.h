@@ -18,6 +18,7 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include <fmq/EventFlag.h>
@@ -174,6 +175,8 @@ struct Effect : public IEffect {
     static const char* sContextResultOfCommand;
     static const char* sContextCallToCommand;
     static const char* sContextCallFunction;
+    // Large enough for the parameters of all the standard effects.
+    static constexpr size_t kHalParamBufferInitialSize = 256;
 
     bool mIsClosed;
     effect_handle_t mHandle;
@@ -185,6 +188,14 @@ struct Effect : public IEffect {
     EventFlag* mEfGroup;
     std::atomic<bool> mStopProcessThread;
     sp<Thread> mProcessThread;
+    // Scratch buffers for get/setParameter, kept to avoid allocating on every call.
+    std::mutex mHalParamBuffersLock;
+    std::vector<uint8_t> mHalParamCmdBuffer;
+    std::vector<uint8_t> mHalParamReplyBuffer;
+    // The value returned by getParameter, handed to the callback once mHalParamBuffersLock is
+    // released. mHalParamValueLock serializes getParameter calls and is taken first.
+    std::mutex mHalParamValueLock;
+    std::vector<uint8_t> mHalParamValueBuffer;
 
     virtual ~Effect();
 
@@ -204,8 +215,8 @@ struct Effect : public IEffect {
     static void effectConfigToHal(const EffectConfig& config, effect_config_t* halConfig);
     static void effectOffloadParamToHal(const EffectOffloadParameter& offload,
                                         effect_offload_param_t* halOffload);
-    static std::vector<uint8_t> parameterToHal(uint32_t paramSize, const void* paramData,
-                                               uint32_t valueSize, const void** valueData);
+    static void parameterToHal(uint32_t paramSize, const void* paramData, uint32_t valueSize,
+                               const void** valueData, std::vector<uint8_t>* halParamBuffer);
 
     Result analyzeCommandStatus(const char* commandName, const char* context, status_t status);
     Result analyzeStatus(const char* funcName, const char* subFuncName,
@@ -18,6 +18,8 @@
 
 #include <memory.h>
 
+#include <algorithm>
+
 #define ATRACE_TAG ATRACE_TAG_AUDIO
 
 #include <android/log.h>
@@ -134,7 +136,11 @@ const char* Effect::sContextCallToCommand = "error";
 const char* Effect::sContextCallFunction = sContextCallToCommand;
 
 Effect::Effect(effect_handle_t handle)
-    : mIsClosed(false), mHandle(handle), mEfGroup(nullptr), mStopProcessThread(false) {}
+    : mIsClosed(false), mHandle(handle), mEfGroup(nullptr), mStopProcessThread(false) {
+    mHalParamCmdBuffer.reserve(kHalParamBufferInitialSize);
+    mHalParamReplyBuffer.reserve(kHalParamBufferInitialSize);
+    mHalParamValueBuffer.reserve(kHalParamBufferInitialSize);
+}
 
 Effect::~Effect() {
     ATRACE_CALL();
@@ -237,12 +243,13 @@ void Effect::effectOffloadParamToHal(const EffectOffloadParameter& offload,
 }
 
 // static
-std::vector<uint8_t> Effect::parameterToHal(uint32_t paramSize, const void* paramData,
-                                            uint32_t valueSize, const void** valueData) {
+void Effect::parameterToHal(uint32_t paramSize, const void* paramData, uint32_t valueSize,
+                            const void** valueData, std::vector<uint8_t>* halParamBuffer) {
     size_t valueOffsetFromData = alignedSizeIn<uint32_t>(paramSize) * sizeof(uint32_t);
     size_t halParamBufferSize = sizeof(effect_param_t) + valueOffsetFromData + valueSize;
-    std::vector<uint8_t> halParamBuffer(halParamBufferSize, 0);
-    effect_param_t* halParam = reinterpret_cast<effect_param_t*>(&halParamBuffer[0]);
+    // The buffer is reused between calls, this only allocates if it needs to grow.
+    halParamBuffer->assign(halParamBufferSize, 0);
+    effect_param_t* halParam = reinterpret_cast<effect_param_t*>(&(*halParamBuffer)[0]);
     halParam->psize = paramSize;
     halParam->vsize = valueSize;
     memcpy(halParam->data, paramData, paramSize);
@@ -255,7 +262,6 @@ std::vector<uint8_t> Effect::parameterToHal(uint32_t paramSize, const void* para
             *valueData = halParam->data + valueOffsetFromData;
         }
     }
-    return halParamBuffer;
 }
 
 Result Effect::analyzeCommandStatus(const char* commandName, const char* context, status_t status) {
@@ -312,21 +318,38 @@ Result Effect::getCurrentConfigImpl(uint32_t featureId, uint32_t configSize,
 Result Effect::getParameterImpl(uint32_t paramSize, const void* paramData,
                                 uint32_t requestValueSize, uint32_t replyValueSize,
                                 GetParameterSuccessCallback onSuccess) {
-    // As it is unknown what method HAL uses for copying the provided parameter data,
-    // it is safer to make sure that input and output buffers do not overlap.
-    std::vector<uint8_t> halCmdBuffer =
-        parameterToHal(paramSize, paramData, requestValueSize, nullptr);
-    const void* valueData = nullptr;
-    std::vector<uint8_t> halParamBuffer =
-        parameterToHal(paramSize, paramData, replyValueSize, &valueData);
-    uint32_t halParamBufferSize = halParamBuffer.size();
-
-    return sendCommandReturningStatusAndData(
-        EFFECT_CMD_GET_PARAM, "GET_PARAM", halCmdBuffer.size(), &halCmdBuffer[0],
-        &halParamBufferSize, &halParamBuffer[0], sizeof(effect_param_t), [&] {
-            effect_param_t* halParam = reinterpret_cast<effect_param_t*>(&halParamBuffer[0]);
-            onSuccess(halParam->vsize, valueData);
-        });
+    std::lock_guard<std::mutex> valueLock(mHalParamValueLock);
+    bool success = false;
+    Result retval;
+    {
+        std::lock_guard<std::mutex> lock(mHalParamBuffersLock);
+        // As it is unknown what method HAL uses for copying the provided parameter data,
+        // it is safer to make sure that input and output buffers do not overlap.
+        std::vector<uint8_t>& halCmdBuffer = mHalParamCmdBuffer;
+        parameterToHal(paramSize, paramData, requestValueSize, nullptr, &halCmdBuffer);
+        const void* valueData = nullptr;
+        std::vector<uint8_t>& halParamBuffer = mHalParamReplyBuffer;
+        parameterToHal(paramSize, paramData, replyValueSize, &valueData, &halParamBuffer);
+        uint32_t halParamBufferSize = halParamBuffer.size();
+
+        retval = sendCommandReturningStatusAndData(
+            EFFECT_CMD_GET_PARAM, "GET_PARAM", halCmdBuffer.size(), &halCmdBuffer[0],
+            &halParamBufferSize, &halParamBuffer[0], sizeof(effect_param_t), [&] {
+                effect_param_t* halParam =
+                    reinterpret_cast<effect_param_t*>(&halParamBuffer[0]);
+                // Never read past the space reserved for the value.
+                const uint8_t* valueBegin = static_cast<const uint8_t*>(valueData);
+                mHalParamValueBuffer.assign(
+                    valueBegin, valueBegin + std::min(halParam->vsize, replyValueSize));
+                success = true;
+            });
+    }
+    // The scratch buffers are released before calling back, as the callback may reply to
+    // the client and must not hold up setParameter calls on this effect.
+    if (success) {
+        onSuccess(mHalParamValueBuffer.size(), mHalParamValueBuffer.data());
+    }
+    return retval;
 }
 
 Result Effect::getSupportedConfigsImpl(uint32_t featureId, uint32_t maxConfigs, uint32_t configSize,
@@ -473,8 +496,9 @@ Result Effect::setConfigImpl(int commandCode, const char* commandName, const Eff
 
 Result Effect::setParameterImpl(uint32_t paramSize, const void* paramData, uint32_t valueSize,
                                 const void* valueData) {
-    std::vector<uint8_t> halParamBuffer =
-        parameterToHal(paramSize, paramData, valueSize, &valueData);
+    std::lock_guard<std::mutex> lock(mHalParamBuffersLock);
+    std::vector<uint8_t>& halParamBuffer = mHalParamCmdBuffer;
+    parameterToHal(paramSize, paramData, valueSize, &valueData, &halParamBuffer);
     return sendCommandReturningStatus(EFFECT_CMD_SET_PARAM, "SET_PARAM", halParamBuffer.size(),
                                       &halParamBuffer[0]);
 }
@@ -647,14 +671,20 @@ Return<Result> Effect::setParameter(const hidl_vec<uint8_t>& parameter,
 
 Return<void> Effect::getParameter(const hidl_vec<uint8_t>& parameter, uint32_t valueMaxSize,
                                   getParameter_cb _hidl_cb) {
-    hidl_vec<uint8_t> value;
+    bool replied = false;
     Result retval = getParameterImpl(
         parameter.size(), &parameter[0], valueMaxSize,
         [&](uint32_t valueSize, const void* valueData) {
+            // The value is only valid during the callback, so reply from here.
+            hidl_vec<uint8_t> value;
             value.setToExternal(reinterpret_cast<uint8_t*>(const_cast<void*>(valueData)),
                                 valueSize);
+            _hidl_cb(Result::OK, value);
+            replied = true;
         });
-    _hidl_cb(retval, value);
+    if (!replied) {
+        _hidl_cb(retval, hidl_vec<uint8_t>());
+    }
     return Void();
 }
 
@@ -27,13 +27,18 @@
 #include <log/log.h>
 #include <vector>
 #include "fcntl.h"
-#include "sys/select.h"
+#include "stdio.h"
+#include "sys/epoll.h"
+#include "sys/timerfd.h"
 #include "unistd.h"
 
 static const int INVALID_FD = -1;
 
 static const int BT_RT_PRIORITY = 1;
 
+// Events handled per wakeup; more ready events are picked up by the next one.
+static const int MAX_EVENTS = 8;
+
 namespace android {
 namespace hardware {
 namespace bluetooth {
@@ -41,14 +46,39 @@ namespace async {
 
 int AsyncFdWatcher::WatchFdForNonBlockingReads(
     int file_descriptor, const ReadCallback& on_read_fd_ready_callback) {
-  // Add file descriptor and callback
-  {
-    std::unique_lock<std::mutex> guard(internal_mutex_);
-    watched_fds_[file_descriptor] = on_read_fd_ready_callback;
-  }
+  return watchFd(file_descriptor, on_read_fd_ready_callback, EPOLLIN);
+}
+
+int AsyncFdWatcher::WatchFdForEdgeTriggeredReads(
+    int file_descriptor, const ReadCallback& on_read_fd_ready_callback) {
+  return watchFd(file_descriptor, on_read_fd_ready_callback,
+                 EPOLLIN | EPOLLET);
+}
 
+int AsyncFdWatcher::watchFd(int file_descriptor, const ReadCallback& callback,
+                            uint32_t events) {
   // Start the thread if not started yet
-  return tryStartThread();
+  int result = tryStartThread();
+  if (result) return result;
+
+  // Add file descriptor and callback
+  std::unique_lock<std::mutex> guard(internal_mutex_);
+  watched_fds_[file_descriptor] = callback;
+
+  struct epoll_event event = {};
+  event.events = events;
+  event.data.fd = file_descriptor;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, file_descriptor, &event) == 0) {
+    return 0;
+  }
+  if (errno == EEXIST &&
+      epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, file_descriptor, &event) == 0) {
+    return 0;
+  }
+  ALOGE("%s unable to watch fd %d: %s", __func__, file_descriptor,
+        strerror(errno));
+  watched_fds_.erase(file_descriptor);
+  return -1;
 }
 
 int AsyncFdWatcher::ConfigureTimeout(
@@ -67,6 +97,25 @@ int AsyncFdWatcher::ConfigureTimeout(
 
 void AsyncFdWatcher::StopWatchingFileDescriptors() { stopThread(); }
 
+AsyncFdWatcher::Stats AsyncFdWatcher::GetStats() const {
+  return {wakeups_.load(), callbacks_.load(), total_dispatch_delay_us_.load(),
+          max_dispatch_delay_us_.load(), max_batch_size_.load()};
+}
+
+void AsyncFdWatcher::DumpStats(int fd) const {
+  Stats stats = GetStats();
+  dprintf(fd,
+          "AsyncFdWatcher: %llu callbacks in %llu wakeups, max batch %llu, "
+          "dispatch delay avg %llu us max %llu us\n",
+          static_cast<unsigned long long>(stats.callbacks),
+          static_cast<unsigned long long>(stats.wakeups),
+          static_cast<unsigned long long>(stats.max_batch_size),
+          static_cast<unsigned long long>(
+              stats.callbacks ? stats.total_dispatch_delay_us / stats.callbacks
+                              : 0),
+          static_cast<unsigned long long>(stats.max_dispatch_delay_us));
+}
+
 AsyncFdWatcher::~AsyncFdWatcher() {}
 
 // Make sure to call this with at least one file descriptor ready to be
@@ -81,6 +130,19 @@ int AsyncFdWatcher::tryStartThread() {
   notification_listen_fd_ = pipe_fds[0];
   notification_write_fd_ = pipe_fds[1];
 
+  // Wait for the watched FDs, the notification FD and the timeout together
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) return -1;
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd_ < 0) return -1;
+
+  for (int fd : {notification_listen_fd_, timer_fd_}) {
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event)) return -1;
+  }
+
   thread_ = std::thread([this]() { ThreadRoutine(); });
   if (!thread_.joinable()) return -1;
 
@@ -107,6 +169,17 @@ int AsyncFdWatcher::stopThread() {
 
   close(notification_listen_fd_);
   close(notification_write_fd_);
+  close(epoll_fd_);
+  close(timer_fd_);
+
+  Stats stats = GetStats();
+  ALOGI("%s: %llu callbacks in %llu wakeups, dispatch delay avg %llu us max %llu us",
+        __func__, static_cast<unsigned long long>(stats.callbacks),
+        static_cast<unsigned long long>(stats.wakeups),
+        static_cast<unsigned long long>(
+            stats.callbacks ? stats.total_dispatch_delay_us / stats.callbacks
+                            : 0),
+        static_cast<unsigned long long>(stats.max_dispatch_delay_us));
 
   return 0;
 }
@@ -128,33 +201,64 @@ void AsyncFdWatcher::ThreadRoutine() {
           getpid(), gettid(), strerror(errno));
   }
 
+  rearmTimeout();
   while (running_) {
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(notification_listen_fd_, &read_fds);
-    int max_read_fd = INVALID_FD;
-    for (auto& it : watched_fds_) {
-      FD_SET(it.first, &read_fds);
-      max_read_fd = std::max(max_read_fd, it.first);
-    }
+    // Wait until there is data available to read on some FD.
+    struct epoll_event events[MAX_EVENTS];
+    int nfds = TEMP_FAILURE_RETRY(epoll_wait(epoll_fd_, events, MAX_EVENTS, -1));
 
-    struct timeval timeout;
-    struct timeval* timeout_ptr = NULL;
-    if (timeout_ms_ > std::chrono::milliseconds(0)) {
-      timeout.tv_sec = timeout_ms_.count() / 1000;
-      timeout.tv_usec = (timeout_ms_.count() % 1000) * 1000;
-      timeout_ptr = &timeout;
+    // There was some error.
+    if (nfds < 0) continue;
+
+    const auto wakeup_time = std::chrono::steady_clock::now();
+    wakeups_++;
+
+    bool notified = false;
+    bool timed_out = false;
+    int ready_fds[MAX_EVENTS];
+    int ready_count = 0;
+    for (int i = 0; i < nfds; i++) {
+      int fd = events[i].data.fd;
+      if (fd == notification_listen_fd_) {
+        // Read data from the notification FD.
+        char buffer[16];
+        while (TEMP_FAILURE_RETRY(read(fd, buffer, sizeof(buffer))) > 0) {
+        }
+        notified = true;
+      } else if (fd == timer_fd_) {
+        uint64_t expirations;
+        TEMP_FAILURE_RETRY(read(fd, &expirations, sizeof(expirations)));
+        timed_out = true;
+      } else {
+        ready_fds[ready_count++] = fd;
+      }
     }
 
-    // Wait until there is data available to read on some FD.
-    int nfds = std::max(notification_listen_fd_, max_read_fd);
-    int retval = select(nfds + 1, &read_fds, NULL, NULL, timeout_ptr);
+    // Invoke the data ready callbacks if appropriate.
+    if (ready_count > 0) {
+      uint64_t max_batch = max_batch_size_.load(std::memory_order_relaxed);
+      if (static_cast<uint64_t>(ready_count) > max_batch) {
+        max_batch_size_.store(ready_count, std::memory_order_relaxed);
+      }
 
-    // There was some error.
-    if (retval < 0) continue;
+      // Hold the mutex to make sure that the callbacks are still valid.
+      std::unique_lock<std::mutex> guard(internal_mutex_);
+      for (int i = 0; i < ready_count; i++) {
+        auto it = watched_fds_.find(ready_fds[i]);
+        if (it == watched_fds_.end()) continue;
+        recordDispatch(std::chrono::steady_clock::now() - wakeup_time);
+        it->second(it->first);
+      }
+    }
+
+    // Any activity restarts the idle timeout.
+    if (notified || ready_count > 0) {
+      rearmTimeout();
+      continue;
+    }
 
     // Timeout.
-    if (retval == 0) {
+    if (timed_out) {
       // Allow the timeout callback to modify the timeout.
       TimeoutCallback saved_cb;
       {
@@ -164,26 +268,40 @@ void AsyncFdWatcher::ThreadRoutine() {
       }
       if (saved_cb != nullptr)
         saved_cb();
-      continue;
     }
+  }
+}
 
-    // Read data from the notification FD.
-    if (FD_ISSET(notification_listen_fd_, &read_fds)) {
-      char buffer[] = {0};
-      TEMP_FAILURE_RETRY(read(notification_listen_fd_, buffer, 1));
-      continue;
-    }
+void AsyncFdWatcher::rearmTimeout() {
+  std::chrono::milliseconds timeout;
+  {
+    std::unique_lock<std::mutex> guard(timeout_mutex_);
+    timeout = timeout_ms_;
+  }
 
-    // Invoke the data ready callbacks if appropriate.
-    {
-      // Hold the mutex to make sure that the callbacks are still valid.
-      std::unique_lock<std::mutex> guard(internal_mutex_);
-      for (auto& it : watched_fds_) {
-        if (FD_ISSET(it.first, &read_fds)) {
-        it.second(it.first);
-        }
-      }
-    }
+  // A zero timeout disarms the timer. Otherwise it repeats until the next
+  // activity.
+  struct itimerspec spec = {};
+  if (timeout > std::chrono::milliseconds(0)) {
+    spec.it_value.tv_sec = timeout.count() / 1000;
+    spec.it_value.tv_nsec = (timeout.count() % 1000) * 1000000;
+    spec.it_interval = spec.it_value;
+  }
+  if (timerfd_settime(timer_fd_, 0, &spec, NULL)) {
+    ALOGE("%s unable to set the timeout: %s", __func__, strerror(errno));
+  }
+}
+
+void AsyncFdWatcher::recordDispatch(
+    std::chrono::steady_clock::duration delay) {
+  uint64_t delay_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(delay).count();
+  callbacks_.fetch_add(1, std::memory_order_relaxed);
+  total_dispatch_delay_us_.fetch_add(delay_us, std::memory_order_relaxed);
+  uint64_t max = max_dispatch_delay_us_.load(std::memory_order_relaxed);
+  while (delay_us > max &&
+         !max_dispatch_delay_us_.compare_exchange_weak(
+             max, delay_us, std::memory_order_relaxed)) {
   }
 }
 
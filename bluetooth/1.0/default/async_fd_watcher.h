@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <map>
 #include <mutex>
 #include <thread>
@@ -35,10 +38,30 @@ class AsyncFdWatcher {
 
   int WatchFdForNonBlockingReads(int file_descriptor,
                                  const ReadCallback& on_read_fd_ready_callback);
+  // The callback only runs when new data arrives, so it must read until the
+  // file descriptor returns EAGAIN.
+  int WatchFdForEdgeTriggeredReads(
+      int file_descriptor, const ReadCallback& on_read_fd_ready_callback);
   int ConfigureTimeout(const std::chrono::milliseconds timeout,
                        const TimeoutCallback& on_timeout_callback);
   void StopWatchingFileDescriptors();
 
+  // The dispatch delay of a callback is the time from epoll_wait() returning
+  // with its file descriptor ready to the start of the callback. It covers
+  // waiting for the watcher lock and running the earlier callbacks of the same
+  // batch. It does not cover the time from the data arriving to the thread
+  // waking up.
+  struct Stats {
+    uint64_t wakeups;
+    uint64_t callbacks;
+    uint64_t total_dispatch_delay_us;
+    uint64_t max_dispatch_delay_us;
+    uint64_t max_batch_size;
+  };
+  Stats GetStats() const;
+  // Writes the stats to |fd| in a human-readable form.
+  void DumpStats(int fd) const;
+
  private:
   AsyncFdWatcher(const AsyncFdWatcher&) = delete;
   AsyncFdWatcher& operator=(const AsyncFdWatcher&) = delete;
@@ -47,6 +70,10 @@ class AsyncFdWatcher {
   int stopThread();
   int notifyThread();
   void ThreadRoutine();
+  int watchFd(int file_descriptor, const ReadCallback& callback,
+              uint32_t events);
+  void rearmTimeout();
+  void recordDispatch(std::chrono::steady_clock::duration delay);
 
   std::atomic_bool running_{false};
   std::thread thread_;
@@ -56,8 +83,16 @@ class AsyncFdWatcher {
   std::map<int, ReadCallback> watched_fds_;
   int notification_listen_fd_;
   int notification_write_fd_;
+  int epoll_fd_;
+  int timer_fd_;
   TimeoutCallback timeout_cb_;
-  std::chrono::milliseconds timeout_ms_;
+  std::chrono::milliseconds timeout_ms_{0};
+
+  std::atomic<uint64_t> wakeups_{0};
+  std::atomic<uint64_t> callbacks_{0};
+  std::atomic<uint64_t> total_dispatch_delay_us_{0};
+  std::atomic<uint64_t> max_dispatch_delay_us_{0};
+  std::atomic<uint64_t> max_batch_size_{0};
 };
 
 
@@ -18,6 +18,7 @@
 #include "bluetooth_hci.h"
 
 #include <log/log.h>
+#include <stdio.h>
 
 #include "vendor_interface.h"
 
@@ -114,6 +115,21 @@ Return<void> BluetoothHci::close() {
   return Void();
 }
 
+Return<void> BluetoothHci::debug(const hidl_handle& handle,
+                                const hidl_vec<hidl_string>& /* options */) {
+  if (handle == nullptr || handle->numFds < 1) {
+    ALOGE("%s: invalid file handle", __func__);
+    return Void();
+  }
+  VendorInterface* vendor_interface = VendorInterface::get();
+  if (vendor_interface == nullptr) {
+    dprintf(handle->data[0], "Bluetooth HCI is not initialized\n");
+    return Void();
+  }
+  vendor_interface->Dump(handle->data[0]);
+  return Void();
+}
+
 Return<void> BluetoothHci::sendHciCommand(const hidl_vec<uint8_t>& command) {
   sendDataToController(HCI_DATA_TYPE_COMMAND, command);
   return Void();
@@ -66,32 +66,23 @@ void H4Protocol::OnPacketReady() {
 }
 
 void H4Protocol::OnDataReady(int fd) {
-  if (hci_packet_type_ == HCI_PACKET_TYPE_UNKNOWN) {
-    uint8_t buffer[1] = {0};
-    ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer, 1));
-    if (bytes_read != 1) {
-      if (bytes_read == 0) {
-        // This is only expected if the UART got closed when shutting down.
-        ALOGE("%s: Unexpected EOF reading the packet type!", __func__);
-        sleep(5);  // Expect to be shut down within 5 seconds.
-        return;
-      } else if (bytes_read < 0) {
-        LOG_ALWAYS_FATAL("%s: Read packet type error: %s", __func__,
-                         strerror(errno));
-      } else {
-        LOG_ALWAYS_FATAL("%s: More bytes read than expected (%u)!", __func__,
-                         static_cast<unsigned int>(bytes_read));
-      }
+  size_t bytes_read =
+      HciPacketizer::ReadAvailable(fd, read_buffer_, sizeof(read_buffer_));
+  size_t offset = 0;
+  while (offset < bytes_read) {
+    if (hci_packet_type_ != HCI_PACKET_TYPE_UNKNOWN) {
+      offset += hci_packetizer_.OnDataReceived(
+          hci_packet_type_, read_buffer_ + offset, bytes_read - offset);
+      continue;
     }
-    hci_packet_type_ = static_cast<HciPacketType>(buffer[0]);
+
+    hci_packet_type_ = static_cast<HciPacketType>(read_buffer_[offset++]);
     if (hci_packet_type_ != HCI_PACKET_TYPE_ACL_DATA &&
         hci_packet_type_ != HCI_PACKET_TYPE_SCO_DATA &&
         hci_packet_type_ != HCI_PACKET_TYPE_EVENT) {
       LOG_ALWAYS_FATAL("%s: Unimplemented packet type %d", __func__,
                        static_cast<int>(hci_packet_type_));
     }
-  } else {
-    hci_packetizer_.OnDataReady(fd, hci_packet_type_);
   }
 }
 
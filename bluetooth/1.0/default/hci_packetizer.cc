@@ -24,6 +24,8 @@
 #include <unistd.h>
 #include <utils/Log.h>
 
+#include <algorithm>
+
 namespace {
 
 const size_t preamble_size_for_type[] = {
@@ -50,60 +52,61 @@ const hidl_vec<uint8_t>& HciPacketizer::GetPacket() const {
   return packet_;
 }
 
+size_t HciPacketizer::ReadAvailable(int fd, uint8_t* data, size_t length) {
+  ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, data, length));
+  if (bytes_read == 0) {
+    // This is only expected if the UART got closed when shutting down.
+    ALOGE("%s: Unexpected EOF reading from the UART!", __func__);
+    sleep(5);  // Expect to be shut down within 5 seconds.
+    return 0;
+  }
+  if (bytes_read < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+    LOG_ALWAYS_FATAL("%s: Read error: %s", __func__, strerror(errno));
+  }
+  return bytes_read;
+}
+
 void HciPacketizer::OnDataReady(int fd, HciPacketType packet_type) {
-  switch (state_) {
-    case HCI_PREAMBLE: {
-      ssize_t bytes_read = TEMP_FAILURE_RETRY(
-          read(fd, preamble_ + bytes_read_,
-               preamble_size_for_type[packet_type] - bytes_read_));
-      if (bytes_read == 0) {
-        // This is only expected if the UART got closed when shutting down.
-        ALOGE("%s: Unexpected EOF reading the header!", __func__);
-        sleep(5);  // Expect to be shut down within 5 seconds.
-        return;
-      }
-      if (bytes_read < 0) {
-        LOG_ALWAYS_FATAL("%s: Read header error: %s", __func__,
-                         strerror(errno));
-      }
-      bytes_read_ += bytes_read;
-      if (bytes_read_ == preamble_size_for_type[packet_type]) {
-        size_t packet_length =
-            HciGetPacketLengthForType(packet_type, preamble_);
-        packet_.resize(preamble_size_for_type[packet_type] + packet_length);
-        memcpy(packet_.data(), preamble_, preamble_size_for_type[packet_type]);
-        bytes_remaining_ = packet_length;
-        state_ = HCI_PAYLOAD;
-        bytes_read_ = 0;
-      }
-      break;
-    }
-
-    case HCI_PAYLOAD: {
-      ssize_t bytes_read = TEMP_FAILURE_RETRY(read(
-          fd,
-          packet_.data() + preamble_size_for_type[packet_type] + bytes_read_,
-          bytes_remaining_));
-      if (bytes_read == 0) {
-        // This is only expected if the UART got closed when shutting down.
-        ALOGE("%s: Unexpected EOF reading the payload!", __func__);
-        sleep(5);  // Expect to be shut down within 5 seconds.
-        return;
-      }
-      if (bytes_read < 0) {
-        LOG_ALWAYS_FATAL("%s: Read payload error: %s", __func__,
-                         strerror(errno));
-      }
-      bytes_remaining_ -= bytes_read;
-      bytes_read_ += bytes_read;
-      if (bytes_remaining_ == 0) {
-        packet_ready_cb_();
-        state_ = HCI_PREAMBLE;
-        bytes_read_ = 0;
-      }
-      break;
-    }
+  size_t bytes_read = ReadAvailable(fd, read_buffer_, sizeof(read_buffer_));
+  size_t offset = 0;
+  while (offset < bytes_read) {
+    offset += OnDataReceived(packet_type, read_buffer_ + offset,
+                             bytes_read - offset);
+  }
+}
+
+size_t HciPacketizer::OnDataReceived(HciPacketType packet_type,
+                                     const uint8_t* data, size_t length) {
+  const size_t preamble_size = preamble_size_for_type[packet_type];
+  size_t consumed = 0;
+
+  if (state_ == HCI_PREAMBLE) {
+    consumed = std::min(length, preamble_size - bytes_read_);
+    memcpy(preamble_ + bytes_read_, data, consumed);
+    bytes_read_ += consumed;
+    if (bytes_read_ < preamble_size) return consumed;
+
+    size_t packet_length = HciGetPacketLengthForType(packet_type, preamble_);
+    packet_.resize(preamble_size + packet_length);
+    memcpy(packet_.data(), preamble_, preamble_size);
+    bytes_remaining_ = packet_length;
+    state_ = HCI_PAYLOAD;
+    bytes_read_ = 0;
+  }
+
+  size_t payload_bytes = std::min(length - consumed, bytes_remaining_);
+  memcpy(packet_.data() + preamble_size + bytes_read_, data + consumed,
+         payload_bytes);
+  consumed += payload_bytes;
+  bytes_remaining_ -= payload_bytes;
+  bytes_read_ += payload_bytes;
+  if (bytes_remaining_ == 0) {
+    state_ = HCI_PREAMBLE;
+    bytes_read_ = 0;
+    packet_ready_cb_();
   }
+  return consumed;
 }
 
 }  // namespace hci
@@ -30,13 +30,31 @@ namespace hci {
 using ::android::hardware::hidl_vec;
 using HciPacketReadyCallback = std::function<void(void)>;
 
+// Size of the buffers the HCI transports read into. A single read() returns
+// everything that is available up to this size, which may contain several
+// packets.
+const size_t HCI_READ_BUFFER_SIZE = 4096;
+
 class HciPacketizer {
  public:
   HciPacketizer(HciPacketReadyCallback packet_cb)
       : packet_ready_cb_(packet_cb){};
+
+  // Reads the bytes available on fd and parses all packets of packet_type in
+  // them. The callback runs once per complete packet.
   void OnDataReady(int fd, HciPacketType packet_type);
+
+  // Parses packet_type bytes from data. Stops at the end of a packet so that
+  // the caller can switch packet types, and returns the number of bytes used.
+  size_t OnDataReceived(HciPacketType packet_type, const uint8_t* data,
+                        size_t length);
+
   const hidl_vec<uint8_t>& GetPacket() const;
 
+  // Reads up to length bytes, as many as are available, from fd. Returns 0
+  // if there was nothing to read or the fd was closed.
+  static size_t ReadAvailable(int fd, uint8_t* data, size_t length);
+
  protected:
   enum State { HCI_PREAMBLE, HCI_PAYLOAD };
   State state_{HCI_PREAMBLE};
@@ -45,6 +63,7 @@ class HciPacketizer {
   size_t bytes_remaining_{0};
   size_t bytes_read_{0};
   HciPacketReadyCallback packet_ready_cb_;
+  uint8_t read_buffer_[HCI_READ_BUFFER_SIZE];
 };
 
 }  // namespace hci
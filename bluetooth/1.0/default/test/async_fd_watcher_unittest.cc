@@ -18,10 +18,12 @@
 
 #include "async_fd_watcher.h"
 #include <gtest/gtest.h>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <vector>
 
+#include <fcntl.h>
 #include <log/log.h>
 #include <netdb.h>
 #include <netinet/in.h>
@@ -385,6 +387,55 @@ TEST_F(AsyncFdWatcherSocketTest, RepeatedTimeOutTest) {
   CleanUpServer();
 }
 
+// An edge-triggered callback runs once per arrival and drains the FD.
+TEST_F(AsyncFdWatcherSocketTest, WatchEdgeTriggered) {
+  int sockfd[2];
+  socketpair(AF_LOCAL, SOCK_STREAM, 0, sockfd);
+  fcntl(sockfd[0], F_SETFL, O_NONBLOCK);
+  std::atomic<int> callbacks{0};
+  std::atomic<int> bytes{0};
+
+  AsyncFdWatcher watcher;
+  watcher.WatchFdForEdgeTriggeredReads(sockfd[0], [&](int fd) {
+    char read_buf[2];
+    int n;
+    while ((n = TEMP_FAILURE_RETRY(read(fd, read_buf, sizeof(read_buf)))) > 0)
+      bytes += n;
+    EXPECT_TRUE(n < 0 && errno == EAGAIN);
+    callbacks++;
+  });
+
+  char buf[5] = {'1', '2', '3', '4', '5'};
+  TEMP_FAILURE_RETRY(write(sockfd[1], buf, sizeof(buf)));
+  sleep(1);
+  EXPECT_EQ(1, callbacks);
+  EXPECT_EQ(5, bytes);
+
+  TEMP_FAILURE_RETRY(write(sockfd[1], buf, 1));
+  sleep(1);
+  EXPECT_EQ(2, callbacks);
+  EXPECT_EQ(6, bytes);
+
+  AsyncFdWatcher::Stats stats = watcher.GetStats();
+  EXPECT_EQ(2u, stats.callbacks);
+  EXPECT_EQ(1u, stats.max_batch_size);
+  EXPECT_LE(stats.total_dispatch_delay_us, 2 * stats.max_dispatch_delay_us);
+
+  // The stats can be dumped while the watcher is running.
+  int dump_fds[2];
+  ASSERT_EQ(0, pipe(dump_fds));
+  watcher.DumpStats(dump_fds[1]);
+  close(dump_fds[1]);
+  char dump[256] = {};
+  ASSERT_GT(TEMP_FAILURE_RETRY(read(dump_fds[0], dump, sizeof(dump) - 1)), 0);
+  close(dump_fds[0]);
+  EXPECT_NE(nullptr, strstr(dump, "2 callbacks in"));
+
+  watcher.StopWatchingFileDescriptors();
+  close(sockfd[0]);
+  close(sockfd[1]);
+}
+
 } // namespace implementation
 } // namespace V1_0
 } // namespace bluetooth
@@ -350,6 +350,8 @@ void VendorInterface::OnFirmwareConfigured(uint8_t result) {
                                [this]() { OnTimeout(); });
 }
 
+void VendorInterface::Dump(int fd) { fd_watcher_.DumpStats(fd); }
+
 void VendorInterface::OnTimeout() {
   ALOGV("%s", __func__);
   std::unique_lock<std::mutex> lock(wakeup_mutex_);
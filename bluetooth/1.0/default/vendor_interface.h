@@ -46,6 +46,8 @@ class VendorInterface {
 
   void OnFirmwareConfigured(uint8_t result);
 
+  void Dump(int fd);
+
  private:
   virtual ~VendorInterface() = default;
 
@@ -40,6 +40,10 @@ using std::mutex;
 using std::sort;
 using std::vector;
 
+/* Limits the size of a single onProgramListUpdated transaction for long lists
+ * (i.e. DAB or HD Radio multiplexes). */
+static constexpr size_t kMaxProgramListChunkSize = 100;
+
 namespace delay {
 
 static constexpr auto seek = 200ms;
@@ -219,6 +223,11 @@ void TunerSession::cancelLocked() {
     if (utils::getType(mCurrentProgram.primaryId) != IdentifierType::INVALID) {
         mIsTuneCompleted = true;
     }
+
+    // cancelAll() also dropped the pending program list update.
+    if (mIsProgramListUpdatePending) {
+        scheduleProgramListUpdateLocked(delay::list);
+    }
 }
 
 Return<void> TunerSession::cancel() {
@@ -236,30 +245,47 @@ Return<Result> TunerSession::startProgramListUpdates(const ProgramFilter& filter
     lock_guard<mutex> lk(mMut);
     if (mIsClosed) return Result::INVALID_STATE;
 
-    auto list = virtualRadio().getProgramList();
-    vector<VirtualProgram> filteredList;
-    auto filterCb = [&filter](const VirtualProgram& program) {
-        return utils::satisfies(filter, program.selector);
-    };
-    std::copy_if(list.begin(), list.end(), std::back_inserter(filteredList), filterCb);
+    mProgramFilter = filter;
+    scheduleProgramListUpdateLocked(delay::list);
 
-    auto task = [this, list]() {
+    return Result::OK;
+}
+
+void TunerSession::scheduleProgramListUpdateLocked(std::chrono::milliseconds delay) {
+    mIsProgramListUpdatePending = true;
+    auto generation = ++mProgramListGeneration;
+    auto task = [this, generation]() {
         lock_guard<mutex> lk(mMut);
+        if (generation != mProgramListGeneration) return;
+        updateProgramListLocked();
+    };
+    mThread.schedule(task, delay);
+}
 
-        ProgramListChunk chunk = {};
-        chunk.purge = true;
-        chunk.complete = true;
-        chunk.modified = hidl_vec<ProgramInfo>(list.begin(), list.end());
+void TunerSession::updateProgramListLocked() {
+    mIsProgramListUpdatePending = false;
+    if (mIsClosed || !mProgramFilter) return;
 
-        mCallback->onProgramListUpdated(chunk);
-    };
-    mThread.schedule(task, delay::list);
+    utils::ProgramInfoSet list;
+    for (auto&& program : virtualRadio().getProgramList(*mProgramFilter)) {
+        list.insert(static_cast<ProgramInfo>(program));
+    }
 
-    return Result::OK;
+    // The client starts over with an empty list, so it gets the whole list. The virtual
+    // radio's programs never change, so there is nothing to refresh afterwards.
+    auto chunks = utils::makeProgramListChunks(nullptr, list, mProgramFilter->excludeModifications,
+                                               kMaxProgramListChunkSize);
+    for (auto&& chunk : chunks) {
+        mCallback->onProgramListUpdated(chunk);
+    }
 }
 
 Return<void> TunerSession::stopProgramListUpdates() {
     ALOGV("%s", __func__);
+    lock_guard<mutex> lk(mMut);
+
+    mProgramFilter.reset();
+    mIsProgramListUpdatePending = false;
     return {};
 }
 
@@ -63,7 +63,15 @@ struct TunerSession : public ITunerSession {
     bool mIsTuneCompleted = false;
     ProgramSelector mCurrentProgram = {};
 
+    // Filter of the active program list updates, if any.
+    std::optional<ProgramFilter> mProgramFilter;
+    bool mIsProgramListUpdatePending = false;
+    // Invalidates the already scheduled program list updates.
+    uint64_t mProgramListGeneration = 0;
+
     void cancelLocked();
+    void scheduleProgramListUpdateLocked(std::chrono::milliseconds delay);
+    void updateProgramListLocked();
     void tuneInternalLocked(const ProgramSelector& sel);
     const VirtualRadio& virtualRadio() const;
     const BroadcastRadio& module() const;
@@ -21,6 +21,8 @@
 #include <broadcastradio-utils-2x/Utils.h>
 #include <log/log.h>
 
+#include <algorithm>
+
 namespace android {
 namespace hardware {
 namespace broadcastradio {
@@ -46,7 +48,15 @@ VirtualRadio gAmFmRadio(
     });
 
 VirtualRadio::VirtualRadio(const std::string& name, const vector<VirtualProgram>& initialList)
-    : mName(name), mPrograms(initialList) {}
+    : mName(name), mPrograms(initialList) {
+    for (size_t i = 0; i < mPrograms.size(); i++) {
+        for (auto&& id : mPrograms[i].selector) {
+            auto& positions = mProgramsByIdType[id.type];
+            // A selector may carry several identifiers of the same type.
+            if (positions.empty() || positions.back() != i) positions.push_back(i);
+        }
+    }
+}
 
 std::string VirtualRadio::getName() const {
     return mName;
@@ -57,6 +67,34 @@ vector<VirtualProgram> VirtualRadio::getProgramList() const {
     return mPrograms;
 }
 
+vector<VirtualProgram> VirtualRadio::getProgramList(const ProgramFilter& filter) const {
+    utils::ProgramFilterMatcher matcher(filter);
+    lock_guard<mutex> lk(mMut);
+
+    vector<VirtualProgram> list;
+    if (matcher.identifierTypes().empty()) {
+        for (auto&& program : mPrograms) {
+            if (matcher.matches(program.selector)) list.push_back(program);
+        }
+        return list;
+    }
+
+    // Only programs carrying one of the requested identifier types can match.
+    vector<size_t> candidates;
+    for (auto type : matcher.identifierTypes()) {
+        auto it = mProgramsByIdType.find(type);
+        if (it == mProgramsByIdType.end()) continue;
+        candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (auto i : candidates) {
+        if (matcher.matches(mPrograms[i].selector)) list.push_back(mPrograms[i]);
+    }
+    return list;
+}
+
 bool VirtualRadio::getProgram(const ProgramSelector& selector, VirtualProgram& programOut) const {
     lock_guard<mutex> lk(mMut);
     for (auto&& program : mPrograms) {
@@ -19,6 +19,7 @@
 #include "VirtualProgram.h"
 
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 
 namespace android {
@@ -41,12 +42,16 @@ class VirtualRadio {
 
     std::string getName() const;
     std::vector<VirtualProgram> getProgramList() const;
+    /** Returns the programs that satisfy the filter, in the order of the full list. */
+    std::vector<VirtualProgram> getProgramList(const ProgramFilter& filter) const;
     bool getProgram(const ProgramSelector& selector, VirtualProgram& program) const;
 
    private:
     mutable std::mutex mMut;
     std::string mName;
     std::vector<VirtualProgram> mPrograms;
+    // Positions in mPrograms of the programs carrying each identifier type.
+    std::unordered_map<uint32_t, std::vector<size_t>> mProgramsByIdType;
 };
 
 /** AM/FM virtual radio space. */
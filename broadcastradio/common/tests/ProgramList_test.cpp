@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <broadcastradio-utils-2x/Utils.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+namespace V2_0 = android::hardware::broadcastradio::V2_0;
+namespace utils = android::hardware::broadcastradio::utils;
+
+using V2_0::IdentifierType;
+using V2_0::ProgramFilter;
+using V2_0::ProgramInfo;
+using V2_0::ProgramSelector;
+
+static ProgramInfo makeProgram(uint32_t frequency, uint32_t signalQuality = 0) {
+    ProgramInfo info = {};
+    info.selector = utils::make_selector_amfm(frequency);
+    info.signalQuality = signalQuality;
+    return info;
+}
+
+static utils::ProgramInfoSet makeList(uint32_t first, size_t count) {
+    utils::ProgramInfoSet list;
+    for (size_t i = 0; i < count; i++) list.insert(makeProgram(first + 200 * i));
+    return list;
+}
+
+static utils::ProgramInfoSet apply(utils::ProgramInfoSet list,
+                                   const std::vector<V2_0::ProgramListChunk>& chunks) {
+    for (auto&& chunk : chunks) utils::updateProgramList(list, chunk);
+    return list;
+}
+
+TEST(ProgramListTest, filterMatcherAgreesWithSatisfies) {
+    // clang-format off
+    ProgramSelector rds {
+        utils::make_identifier(IdentifierType::RDS_PI, 0xBEEF),
+        {utils::make_identifier(IdentifierType::AMFM_FREQUENCY, 100100)}
+    };
+    ProgramSelector ensemble {
+        utils::make_identifier(IdentifierType::DAB_ENSEMBLE, 0x1234), {}
+    };
+    // clang-format on
+    auto amfm = utils::make_selector_amfm(97300);
+
+    std::vector<ProgramFilter> filters(4);
+    filters[1].identifierTypes = {static_cast<uint32_t>(IdentifierType::RDS_PI)};
+    filters[2].identifiers = {utils::make_identifier(IdentifierType::AMFM_FREQUENCY, 100100)};
+    filters[3].includeCategories = true;
+
+    for (auto&& filter : filters) {
+        utils::ProgramFilterMatcher matcher(filter);
+        for (auto&& sel : {rds, ensemble, amfm}) {
+            EXPECT_EQ(utils::satisfies(filter, sel), matcher.matches(sel))
+                << toString(filter) << " " << toString(sel);
+        }
+    }
+}
+
+TEST(ProgramListTest, fullListIsPurgedAndChunked) {
+    auto list = makeList(87500, 25);
+
+    auto chunks = utils::makeProgramListChunks(nullptr, list, false, 10);
+
+    ASSERT_EQ(3u, chunks.size());
+    EXPECT_TRUE(chunks[0].purge);
+    EXPECT_FALSE(chunks[1].purge);
+    EXPECT_FALSE(chunks[0].complete);
+    EXPECT_TRUE(chunks[2].complete);
+    EXPECT_EQ(10u, chunks[0].modified.size());
+    EXPECT_EQ(5u, chunks[2].modified.size());
+    EXPECT_EQ(list, apply(makeList(107900, 3), chunks));
+}
+
+TEST(ProgramListTest, emptyFullList) {
+    auto chunks = utils::makeProgramListChunks(nullptr, {}, false, 10);
+
+    ASSERT_EQ(1u, chunks.size());
+    EXPECT_TRUE(chunks[0].purge);
+    EXPECT_TRUE(chunks[0].complete);
+    EXPECT_EQ(0u, chunks[0].modified.size());
+}
+
+TEST(ProgramListTest, unchangedListSendsNothing) {
+    auto list = makeList(87500, 25);
+
+    EXPECT_EQ(0u, utils::makeProgramListChunks(&list, list, false, 10).size());
+}
+
+TEST(ProgramListTest, onlyChangesAreSent) {
+    auto previous = makeList(87500, 25);
+    auto current = previous;
+    current.erase(makeProgram(87500));
+    current.erase(makeProgram(87700));
+    current.insert(makeProgram(107900));
+    current.erase(makeProgram(87900));
+    current.insert(makeProgram(87900, 50));
+
+    auto chunks = utils::makeProgramListChunks(&previous, current, false, 2);
+
+    ASSERT_EQ(2u, chunks.size());
+    size_t modified = 0, removed = 0;
+    for (auto&& chunk : chunks) {
+        EXPECT_FALSE(chunk.purge);
+        EXPECT_LE(chunk.modified.size() + chunk.removed.size(), 2u);
+        modified += chunk.modified.size();
+        removed += chunk.removed.size();
+    }
+    EXPECT_EQ(2u, modified);
+    EXPECT_EQ(2u, removed);
+    EXPECT_TRUE(chunks.back().complete);
+
+    auto updated = apply(previous, chunks);
+    EXPECT_EQ(current, updated);
+    EXPECT_EQ(50u, updated.find(makeProgram(87900))->signalQuality);
+}
+
+TEST(ProgramListTest, excludeModificationsSendsOnlyAdditionsAndRemovals) {
+    auto previous = makeList(87500, 5);
+    auto current = previous;
+    current.erase(makeProgram(87500));
+    current.insert(makeProgram(107900));
+    current.erase(makeProgram(87900));
+    current.insert(makeProgram(87900, 50));
+
+    auto chunks = utils::makeProgramListChunks(&previous, current, true, 10);
+
+    ASSERT_EQ(1u, chunks.size());
+    EXPECT_FALSE(chunks[0].purge);
+    EXPECT_TRUE(chunks[0].complete);
+    ASSERT_EQ(1u, chunks[0].modified.size());
+    EXPECT_EQ(makeProgram(107900).selector, chunks[0].modified[0].selector);
+    ASSERT_EQ(1u, chunks[0].removed.size());
+    EXPECT_EQ(makeProgram(87500).selector.primaryId, chunks[0].removed[0]);
+
+    // The client keeps its stale copy of the modified entry.
+    auto updated = apply(previous, chunks);
+    EXPECT_EQ(current, updated);
+    EXPECT_EQ(0u, updated.find(makeProgram(87900))->signalQuality);
+}
+
+TEST(ProgramListTest, excludeModificationsWithOnlyModificationsSendsNothing) {
+    auto previous = makeList(87500, 5);
+    auto current = previous;
+    current.erase(makeProgram(87700));
+    current.insert(makeProgram(87700, 50));
+
+    EXPECT_EQ(0u, utils::makeProgramListChunks(&previous, current, true, 10).size());
+}
+
+TEST(ProgramListTest, excludeModificationsStillSendsFullList) {
+    auto list = makeList(87500, 5);
+
+    auto chunks = utils::makeProgramListChunks(nullptr, list, true, 10);
+
+    ASSERT_EQ(1u, chunks.size());
+    EXPECT_TRUE(chunks[0].purge);
+    EXPECT_EQ(5u, chunks[0].modified.size());
+}
+
+}  // anonymous namespace
@@ -356,10 +356,52 @@ bool ProgramInfoKeyEqual::operator()(const ProgramInfo& info1, const ProgramInfo
     return id1.type == id2.type && id1.value == id2.value;
 }
 
+ProgramFilterMatcher::ProgramFilterMatcher(const ProgramFilter& filter)
+    : mIdentifierTypes(filter.identifierTypes.begin(), filter.identifierTypes.end()),
+      mIdentifiers(filter.identifiers.begin(), filter.identifiers.end()),
+      mIncludeCategories(filter.includeCategories) {}
+
+size_t ProgramFilterMatcher::IdentifierHasher::operator()(const ProgramIdentifier& id) const {
+    auto h = std::hash<uint32_t>{}(id.type);
+    h += 0x9e3779b9;
+    h ^= std::hash<uint64_t>{}(id.value);
+    return h;
+}
+
+bool ProgramFilterMatcher::matches(const ProgramSelector& sel) const {
+    if (!mIdentifierTypes.empty()) {
+        auto typeMatches = [this](const ProgramIdentifier& id) {
+            return mIdentifierTypes.count(id.type) != 0;
+        };
+        if (std::none_of(begin(sel), end(sel), typeMatches)) return false;
+    }
+
+    if (!mIdentifiers.empty()) {
+        auto idMatches = [this](const ProgramIdentifier& id) {
+            return mIdentifiers.count(id) != 0;
+        };
+        if (std::none_of(begin(sel), end(sel), idMatches)) return false;
+    }
+
+    if (!mIncludeCategories) {
+        if (getType(sel.primaryId) == IdentifierType::DAB_ENSEMBLE) return false;
+    }
+
+    return true;
+}
+
 void updateProgramList(ProgramInfoSet& list, const ProgramListChunk& chunk) {
-    if (chunk.purge) list.clear();
+    if (chunk.purge) {
+        list.clear();
+        list.reserve(chunk.modified.size());
+    }
 
-    list.insert(chunk.modified.begin(), chunk.modified.end());
+    for (auto&& info : chunk.modified) {
+        // insert() would keep the stale entry with the same key.
+        auto it = list.find(info);
+        if (it != list.end()) it = list.erase(it);
+        list.insert(it, info);
+    }
 
     for (auto&& id : chunk.removed) {
         ProgramInfo info = {};
@@ -368,6 +410,54 @@ void updateProgramList(ProgramInfoSet& list, const ProgramListChunk& chunk) {
     }
 }
 
+vector<ProgramListChunk> makeProgramListChunks(const ProgramInfoSet* previous,
+                                               const ProgramInfoSet& current,
+                                               bool excludeModifications, size_t maxChunkSize) {
+    if (maxChunkSize == 0) maxChunkSize = 1;
+
+    vector<const ProgramInfo*> modified;
+    vector<ProgramIdentifier> removed;
+    if (previous == nullptr) {
+        modified.reserve(current.size());
+        for (auto&& info : current) modified.push_back(&info);
+    } else {
+        for (auto&& info : current) {
+            auto it = previous->find(info);
+            if (it == previous->end()) {
+                modified.push_back(&info);
+            } else if (!excludeModifications && !(*it == info)) {
+                modified.push_back(&info);
+            }
+        }
+        for (auto&& info : *previous) {
+            if (current.count(info) == 0) removed.push_back(info.selector.primaryId);
+        }
+        if (modified.empty() && removed.empty()) return {};
+    }
+
+    vector<ProgramListChunk> chunks;
+    auto nextModified = modified.begin();
+    auto nextRemoved = removed.begin();
+    do {
+        ProgramListChunk chunk = {};
+        chunk.purge = previous == nullptr && chunks.empty();
+
+        size_t modifiedCount = std::min<size_t>(maxChunkSize, modified.end() - nextModified);
+        chunk.modified.resize(modifiedCount);
+        for (size_t i = 0; i < modifiedCount; i++) chunk.modified[i] = **nextModified++;
+
+        size_t removedCount =
+            std::min<size_t>(maxChunkSize - modifiedCount, removed.end() - nextRemoved);
+        chunk.removed = hidl_vec<ProgramIdentifier>(nextRemoved, nextRemoved + removedCount);
+        nextRemoved += removedCount;
+
+        chunks.push_back(std::move(chunk));
+    } while (nextModified != modified.end() || nextRemoved != removed.end());
+    chunks.back().complete = true;
+
+    return chunks;
+}
+
 std::optional<std::string> getMetadataString(const V2_0::ProgramInfo& info,
                                              const V2_0::MetadataKey key) {
     auto isKey = [key](const V2_0::Metadata& item) {
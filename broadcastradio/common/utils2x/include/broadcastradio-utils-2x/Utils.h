@@ -142,8 +142,50 @@ struct ProgramInfoKeyEqual {
 typedef std::unordered_set<V2_0::ProgramInfo, ProgramInfoHasher, ProgramInfoKeyEqual>
     ProgramInfoSet;
 
+/**
+ * A ProgramFilter prepared for matching a long program list.
+ *
+ * satisfies() compares every identifier of a selector against every entry of the filter.
+ * The matcher hashes the filter's identifier types and identifiers once, so matching
+ * a selector takes one lookup per identifier it carries.
+ */
+class ProgramFilterMatcher {
+   public:
+    explicit ProgramFilterMatcher(const V2_0::ProgramFilter& filter);
+
+    /** Same as satisfies(filter, sel) for the filter the matcher was made of. */
+    bool matches(const V2_0::ProgramSelector& sel) const;
+
+    /** Identifier types required by the filter, empty if any type is accepted. */
+    const std::unordered_set<uint32_t>& identifierTypes() const { return mIdentifierTypes; }
+
+   private:
+    struct IdentifierHasher {
+        size_t operator()(const V2_0::ProgramIdentifier& id) const;
+    };
+
+    std::unordered_set<uint32_t> mIdentifierTypes;
+    std::unordered_set<V2_0::ProgramIdentifier, IdentifierHasher> mIdentifiers;
+    bool mIncludeCategories;
+};
+
 void updateProgramList(ProgramInfoSet& list, const V2_0::ProgramListChunk& chunk);
 
+/**
+ * Prepares the chunks that turn the client's program list from {@code previous} into
+ * {@code current}.
+ *
+ * Only added, modified and removed entries are sent, at most {@code maxChunkSize} of them
+ * per chunk, and the last chunk is marked complete. With {@code excludeModifications} set
+ * (see ProgramFilter), entries the client already has are not sent again even if they
+ * changed. Without a previous list, the whole current list is sent and the first chunk
+ * purges the client's list. Returns no chunk if nothing is to be sent.
+ */
+std::vector<V2_0::ProgramListChunk> makeProgramListChunks(const ProgramInfoSet* previous,
+                                                          const ProgramInfoSet& current,
+                                                          bool excludeModifications,
+                                                          size_t maxChunkSize);
+
 std::optional<std::string> getMetadataString(const V2_0::ProgramInfo& info,
                                              const V2_0::MetadataKey key);
 
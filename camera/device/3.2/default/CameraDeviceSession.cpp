@@ -192,37 +192,37 @@ bool CameraDeviceSession::handleAePrecaptureCancelRequestLocked(
         return false;
     }
 
+    // Look the trigger up in place; the settings are only copied when they need to be changed.
+    camera_metadata_ro_entry_t aePrecaptureTrigger;
+    if (find_camera_metadata_ro_entry(halRequest.settings, ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER,
+                                      &aePrecaptureTrigger) != OK ||
+            aePrecaptureTrigger.count == 0 ||
+            aePrecaptureTrigger.data.u8[0] != ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_CANCEL) {
+        return false;
+    }
+
     settings->clear();
     settings->append(halRequest.settings);
-    camera_metadata_entry_t aePrecaptureTrigger =
-            settings->find(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER);
-    if (aePrecaptureTrigger.count > 0 &&
-            aePrecaptureTrigger.data.u8[0] ==
-                    ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_CANCEL) {
-        // Always override CANCEL to IDLE
-        uint8_t aePrecaptureTrigger =
-                ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_IDLE;
-        settings->update(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER,
-                &aePrecaptureTrigger, 1);
-        *override = { false, ANDROID_CONTROL_AE_LOCK_OFF,
-                true, ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_CANCEL };
-
-        if (mIsAELockAvailable == true) {
-            camera_metadata_entry_t aeLock = settings->find(
-                    ANDROID_CONTROL_AE_LOCK);
-            if (aeLock.count == 0 || aeLock.data.u8[0] ==
-                    ANDROID_CONTROL_AE_LOCK_OFF) {
-                uint8_t aeLock = ANDROID_CONTROL_AE_LOCK_ON;
-                settings->update(ANDROID_CONTROL_AE_LOCK, &aeLock, 1);
-                override->applyAeLock = true;
-                override->aeLock = ANDROID_CONTROL_AE_LOCK_OFF;
-            }
-        }
 
-        return true;
+    // Always override CANCEL to IDLE
+    uint8_t aePrecaptureTriggerIdle = ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_IDLE;
+    settings->update(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER, &aePrecaptureTriggerIdle, 1);
+    *override = { false, ANDROID_CONTROL_AE_LOCK_OFF,
+            true, ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_CANCEL };
+
+    if (mIsAELockAvailable == true) {
+        camera_metadata_entry_t aeLock = settings->find(
+                ANDROID_CONTROL_AE_LOCK);
+        if (aeLock.count == 0 || aeLock.data.u8[0] ==
+                ANDROID_CONTROL_AE_LOCK_OFF) {
+            uint8_t aeLock = ANDROID_CONTROL_AE_LOCK_ON;
+            settings->update(ANDROID_CONTROL_AE_LOCK, &aeLock, 1);
+            override->applyAeLock = true;
+            override->aeLock = ANDROID_CONTROL_AE_LOCK_OFF;
+        }
     }
 
-    return false;
+    return true;
 }
 
 /**
@@ -1106,6 +1106,22 @@ Return<void> CameraDeviceSession::processCaptureRequest(
     return Void();
 }
 
+bool CameraDeviceSession::readSettingsFromFmq(uint64_t settingsSize,
+        const camera_metadata_t** settings) {
+    // non-blocking read; client must write metadata before calling
+    // processOneCaptureRequest
+    if (mSettingsFmqBuffer.size() < settingsSize) {
+        mSettingsFmqBuffer.resize(settingsSize);
+    }
+    if (!mRequestMetadataQueue->read(mSettingsFmqBuffer.data(), settingsSize)) {
+        ALOGE("%s: capture request settings metadata couldn't be read from fmq!", __FUNCTION__);
+        return false;
+    }
+    CameraMetadata settingsFmq;  // settings from FMQ
+    settingsFmq.setToExternal(mSettingsFmqBuffer.data(), settingsSize);
+    return convertFromHidl(settingsFmq, settings);
+}
+
 Status CameraDeviceSession::processOneCaptureRequest(const CaptureRequest& request)  {
     Status status = initStatus();
     if (status != Status::OK) {
@@ -1117,18 +1133,8 @@ Status CameraDeviceSession::processOneCaptureRequest(const CaptureRequest& reque
     halRequest.frame_number = request.frameNumber;
 
     bool converted = true;
-    CameraMetadata settingsFmq;  // settings from FMQ
     if (request.fmqSettingsSize > 0) {
-        // non-blocking read; client must write metadata before calling
-        // processOneCaptureRequest
-        settingsFmq.resize(request.fmqSettingsSize);
-        bool read = mRequestMetadataQueue->read(settingsFmq.data(), request.fmqSettingsSize);
-        if (read) {
-            converted = convertFromHidl(settingsFmq, &halRequest.settings);
-        } else {
-            ALOGE("%s: capture request settings metadata couldn't be read from fmq!", __FUNCTION__);
-            converted = false;
-        }
+        converted = readSettingsFromFmq(request.fmqSettingsSize, &halRequest.settings);
     } else {
         converted = convertFromHidl(request.settings, &halRequest.settings);
     }
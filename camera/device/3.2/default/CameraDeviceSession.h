@@ -179,6 +179,9 @@ protected:
 
     using RequestMetadataQueue = MessageQueue<uint8_t, kSynchronizedReadWrite>;
     std::unique_ptr<RequestMetadataQueue> mRequestMetadataQueue;
+    // Backing storage of the settings read from mRequestMetadataQueue. Reused across
+    // requests so that it only gets reallocated when larger settings come in.
+    std::vector<uint8_t> mSettingsFmqBuffer;
     using ResultMetadataQueue = MessageQueue<uint8_t, kSynchronizedReadWrite>;
     std::shared_ptr<ResultMetadataQueue> mResultMetadataQueue;
 
@@ -326,6 +329,10 @@ protected:
             ::android::hardware::camera::common::V1_0::helper::CameraMetadata *settings /*out*/);
 
     Status processOneCaptureRequest(const CaptureRequest& request);
+    // Reads |settingsSize| bytes of request settings from mRequestMetadataQueue.
+    // On success |settings| points into mSettingsFmqBuffer and stays valid until
+    // the next call.
+    bool readSettingsFromFmq(uint64_t settingsSize, const camera_metadata_t** settings);
     /**
      * Static callback forwarding methods from HAL to instance
      */
@@ -338,18 +338,8 @@ Status CameraDeviceSession::processOneCaptureRequest_3_4(const V3_4::CaptureRequ
     halRequest.frame_number = request.v3_2.frameNumber;
 
     bool converted = true;
-    V3_2::CameraMetadata settingsFmq;  // settings from FMQ
     if (request.v3_2.fmqSettingsSize > 0) {
-        // non-blocking read; client must write metadata before calling
-        // processOneCaptureRequest
-        settingsFmq.resize(request.v3_2.fmqSettingsSize);
-        bool read = mRequestMetadataQueue->read(settingsFmq.data(), request.v3_2.fmqSettingsSize);
-        if (read) {
-            converted = V3_2::implementation::convertFromHidl(settingsFmq, &halRequest.settings);
-        } else {
-            ALOGE("%s: capture request settings metadata couldn't be read from fmq!", __FUNCTION__);
-            converted = false;
-        }
+        converted = readSettingsFromFmq(request.v3_2.fmqSettingsSize, &halRequest.settings);
     } else {
         converted = V3_2::implementation::convertFromHidl(request.v3_2.settings,
                 &halRequest.settings);
@@ -231,6 +231,32 @@ class WriteState {
 WriteState writeHeader(WriteState wState, Type type, const uint64_t value);
 bool checkUTF8Copy(const char* begin, const char* const end, uint8_t* out);
 
+/**
+ * Returns the number of bytes writeHeader emits for the given value.
+ */
+constexpr size_t headerSize(uint64_t value) {
+    if (value < 24) return 1;
+    if (value < 0x100) return 2;
+    if (value < 0x10000) return 3;
+    if (value < 0x100000000) return 5;
+    return 9;
+}
+
+/**
+ * Same as writeHeader(wState, type, value) but for headers known at compile time, such as the
+ * element count of a Map or Array. Values below 24 are written as a single precomputed byte.
+ */
+template <Type type, uint64_t value>
+WriteState writeHeader(WriteState wState) {
+    if (value >= 24) return writeHeader(wState, type, value);
+    constexpr uint8_t header = (static_cast<uint8_t>(type) << 5) | static_cast<uint8_t>(value);
+    if (!wState) return wState;
+    uint8_t* pos = wState.data_;
+    if (!++wState) return wState;
+    *pos = header;
+    return wState;
+}
+
 template <typename T>
 WriteState writeNumber(WriteState wState, const T& v) {
     if (!wState) return wState;
@@ -266,6 +292,75 @@ inline WriteState write(const WriteState& wState, const int64_t& v) {
     return writeNumber(wState, v);
 }
 
+/**
+ * encodedSize returns the exact number of bytes write emits for the same arguments. This allows
+ * callers to size their buffers up front instead of guessing and retrying.
+ */
+template <typename T>
+constexpr size_t numberSize(const T& v) {
+    return v >= 0 ? headerSize(v) : headerSize(UINT64_C(-1) - v);
+}
+
+inline size_t encodedSize(const uint8_t& v) {
+    return numberSize(v);
+}
+inline size_t encodedSize(const int8_t& v) {
+    return numberSize(v);
+}
+inline size_t encodedSize(const uint16_t& v) {
+    return numberSize(v);
+}
+inline size_t encodedSize(const int16_t& v) {
+    return numberSize(v);
+}
+inline size_t encodedSize(const uint32_t& v) {
+    return numberSize(v);
+}
+inline size_t encodedSize(const int32_t& v) {
+    return numberSize(v);
+}
+inline size_t encodedSize(const uint64_t& v) {
+    return numberSize(v);
+}
+inline size_t encodedSize(const int64_t& v) {
+    return numberSize(v);
+}
+
+template <typename T, typename Variant>
+size_t encodedSize(const StringBuffer<T, Variant>& v) {
+    return headerSize(v.size()) + v.size();
+}
+
+template <template <typename...> class Arr>
+size_t encodedSizeArrayHelper(const Arr<>&) {
+    return 0;
+}
+
+template <template <typename...> class Arr, typename Head, typename... Tail>
+size_t encodedSizeArrayHelper(const Arr<Head, Tail...>& arr) {
+    return encodedSize(arr.head_) + encodedSizeArrayHelper(arr.tail_);
+}
+
+template <typename... Elems>
+size_t encodedSize(const Map<Elems...>& map) {
+    return headerSize(sizeof...(Elems)) + encodedSizeArrayHelper(map);
+}
+
+template <typename... Elems>
+size_t encodedSize(const Array<Elems...>& arr) {
+    return headerSize(sizeof...(Elems)) + encodedSizeArrayHelper(arr);
+}
+
+template <typename Key, typename Value>
+size_t encodedSize(const MapElement<Key, Value>& element) {
+    return encodedSize(element.key_) + encodedSize(element.value_);
+}
+
+template <typename Head, typename... Tail>
+size_t encodedSize(const Head& head, const Tail&... tail) {
+    return encodedSize(head) + encodedSize(tail...);
+}
+
 template <typename T>
 WriteState write(WriteState wState, const StringBuffer<T, TextStr>& v) {
     wState = writeHeader(wState, Type::TEXT_STRING, v.size());
@@ -303,14 +398,14 @@ WriteState writeArrayHelper(WriteState wState, const Arr<Head, Tail...>& arr) {
 template <typename... Elems>
 WriteState write(WriteState wState, const Map<Elems...>& map) {
     if (!wState) return wState;
-    wState = writeHeader(wState, Type::MAP, map.size());
+    wState = writeHeader<Type::MAP, sizeof...(Elems)>(wState);
     return writeArrayHelper(wState, map);
 }
 
 template <typename... Elems>
 WriteState write(WriteState wState, const Array<Elems...>& arr) {
     if (!wState) return wState;
-    wState = writeHeader(wState, Type::ARRAY, arr.size());
+    wState = writeHeader<Type::ARRAY, sizeof...(Elems)>(wState);
     return writeArrayHelper(wState, arr);
 }
 
@@ -17,6 +17,8 @@
 
 #include <android/hardware/confirmationui/support/cbor.h>
 
+#include <string.h>
+
 namespace android {
 namespace hardware {
 namespace confirmationui {
@@ -76,8 +78,23 @@ WriteState writeHeader(WriteState wState, Type type, const uint64_t value) {
 }
 
 bool checkUTF8Copy(const char* begin, const char* const end, uint8_t* out) {
+    constexpr uint64_t kHighBits = UINT64_C(0x8080808080808080);
     uint32_t multi_byte_length = 0;
     while (begin != end) {
+        if (!multi_byte_length) {
+            // Runs of 7bit characters need no validation, so check and copy them a word at a time.
+            while (size_t(end - begin) >= sizeof(uint64_t)) {
+                uint64_t word;
+                memcpy(&word, begin, sizeof(word));
+                if (word & kHighBits) break;
+                if (out) {
+                    memcpy(out, &word, sizeof(word));
+                    out += sizeof(word);
+                }
+                begin += sizeof(word);
+            }
+            if (begin == end) break;
+        }
         if (multi_byte_length) {
             // parsing multi byte character - must start with 10xxxxxx
             --multi_byte_length;
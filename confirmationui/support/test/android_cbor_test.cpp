@@ -21,6 +21,7 @@
 #include <cstdint>
 #include <iomanip>
 #include <iostream>
+#include <string>
 
 #include <gtest/gtest.h>
 
@@ -195,3 +196,43 @@ TEST(Cbor, MinimalViableHeaderSizeTest) {
     state = writeHeader(state, Type::NUMBER, 0xffffffffffffffff);
     ASSERT_EQ(state.data_ - buffer, 9);
 }
+
+TEST(Cbor, EncodedSizeTest) {
+    uint8_t buffer[0x1000];
+    WriteState state(buffer);
+    state = writeTest(state);
+    ASSERT_EQ(Error::OK, state.error_);
+    ASSERT_EQ(size_t(state.data_ - buffer),
+              encodedSize(map(pair(text("key"), text("value")),
+                              pair(text("key"), bytes("100101010010")), pair(4, 7),
+                              pair((UINT64_C(1) << 62), INT64_C(-2000000000000000))),
+                          arr(text("♨⚖ⶖ"), bytes(fourHundredAs))));
+}
+
+TEST(Cbor, UTF8Test_LongMixed) {
+    // Exercise multi byte characters on and across the word boundaries of the ASCII fast path.
+    for (size_t prefix = 0; prefix < 17; ++prefix) {
+        std::string str(prefix, 'a');
+        str += "♨";
+        str += std::string(prefix, 'b');
+        str += "⚖ⶖ";
+        str += std::string(23, 'c');
+        uint8_t buffer[0x100];
+        WriteState state(buffer);
+        state = write(state, text(str.data(), str.size()));
+        ASSERT_EQ(Error::OK, state.error_);
+        ASSERT_EQ(0, memcmp(buffer + headerSize(str.size()), str.data(), str.size()));
+    }
+}
+
+TEST(Cbor, MalformedUTF8Test_LongStray) {
+    for (size_t prefix = 0; prefix < 17; ++prefix) {
+        std::string str(prefix, 'a');
+        str += char(0x82);
+        str += std::string(prefix, 'b');
+        uint8_t buffer[0x100];
+        WriteState state(buffer);
+        state = write(state, text(str.data(), str.size()));
+        ASSERT_EQ(Error::MALFORMED_UTF8, state.error_);
+    }
+}
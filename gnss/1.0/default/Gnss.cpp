@@ -17,6 +17,10 @@
 #define LOG_TAG "GnssHAL_GnssInterface"
 
 #include "Gnss.h"
+
+#include <android-base/file.h>
+
+#include <GnssCallbackDispatcher.h>
 #include <GnssUtils.h>
 
 namespace android {
@@ -30,6 +34,9 @@ sp<IGnssCallback> Gnss::sGnssCbIface = nullptr;
 bool Gnss::sInterfaceExists = false;
 bool Gnss::sWakelockHeldGnss = false;
 bool Gnss::sWakelockHeldFused = false;
+std::mutex Gnss::sWakelockLock;
+uint64_t Gnss::sPendingWakelockRelease = 0;
+uint64_t Gnss::sLastWakelockRelease = 0;
 
 GpsCallbacks Gnss::sGnssCb = {
     .size = sizeof(GpsCallbacks),
@@ -80,10 +87,14 @@ void Gnss::locationCb(GpsLocation* location) {
     }
 
     android::hardware::gnss::V1_0::GnssLocation gnssLocation = convertToGnssLocation(location);
-    auto ret = sGnssCbIface->gnssLocationCb(gnssLocation);
-    if (!ret.isOk()) {
-        ALOGE("%s: Unable to invoke callback", __func__);
-    }
+    GnssCallbackDispatcher::getInstance().post(
+            GnssCallbackDispatcher::Stream::LOCATION,
+            [cbIface = sGnssCbIface, gnssLocation]() {
+                auto ret = cbIface->gnssLocationCb(gnssLocation);
+                if (!ret.isOk()) {
+                    ALOGE("locationCb: Unable to invoke callback");
+                }
+            });
 }
 
 void Gnss::statusCb(GpsStatus* gnssStatus) {
@@ -100,10 +111,24 @@ void Gnss::statusCb(GpsStatus* gnssStatus) {
     IGnssCallback::GnssStatusValue status =
             static_cast<IGnssCallback::GnssStatusValue>(gnssStatus->status);
 
-    auto ret = sGnssCbIface->gnssStatusCb(status);
-    if (!ret.isOk()) {
-        ALOGE("%s: Unable to invoke callback", __func__);
-    }
+    // Queued behind the fixes reported so far so that e.g. SESSION_END never overtakes them.
+    GnssCallbackDispatcher::getInstance().post(
+            GnssCallbackDispatcher::Stream::CONTROL, [cbIface = sGnssCbIface, status]() {
+                auto ret = cbIface->gnssStatusCb(status);
+                if (!ret.isOk()) {
+                    ALOGE("statusCb: Unable to invoke callback");
+                }
+            });
+}
+
+void Gnss::postSvStatus(const IGnssCallback::GnssSvStatus& svStatus) {
+    // Only the latest satellite list matters, a pending one is replaced instead of queued.
+    GnssCallbackDispatcher::getInstance().postSvStatus([cbIface = sGnssCbIface, svStatus]() {
+        auto ret = cbIface->gnssSvStatusCb(svStatus);
+        if (!ret.isOk()) {
+            ALOGE("gnssSvStatusCb: Unable to invoke callback");
+        }
+    });
 }
 
 void Gnss::gnssSvStatusCb(GnssSvStatus* status) {
@@ -145,10 +170,7 @@ void Gnss::gnssSvStatusCb(GnssSvStatus* status) {
         svStatus.gnssSvList[i] = gnssSvInfo;
     }
 
-    auto ret = sGnssCbIface->gnssSvStatusCb(svStatus);
-    if (!ret.isOk()) {
-        ALOGE("%s: Unable to invoke callback", __func__);
-    }
+    postSvStatus(svStatus);
 }
 
 /*
@@ -248,10 +270,7 @@ void Gnss::gpsSvStatusCb(GpsSvStatus* svInfo) {
         }
     }
 
-    auto ret = sGnssCbIface->gnssSvStatusCb(svStatus);
-    if (!ret.isOk()) {
-        ALOGE("%s: Unable to invoke callback", __func__);
-    }
+    postSvStatus(svStatus);
 }
 
 void Gnss::nmeaCb(GpsUtcTime timestamp, const char* nmea, int length) {
@@ -260,12 +279,16 @@ void Gnss::nmeaCb(GpsUtcTime timestamp, const char* nmea, int length) {
         return;
     }
 
-    android::hardware::hidl_string nmeaString;
-    nmeaString.setToExternal(nmea, length);
-    auto ret = sGnssCbIface->gnssNmeaCb(timestamp, nmeaString);
-    if (!ret.isOk()) {
-        ALOGE("%s: Unable to invoke callback", __func__);
-    }
+    // The sentence buffer belongs to the legacy HAL, copy it as delivery is deferred.
+    android::hardware::hidl_string nmeaString(nmea, length);
+    GnssCallbackDispatcher::getInstance().post(
+            GnssCallbackDispatcher::Stream::NMEA,
+            [cbIface = sGnssCbIface, timestamp, nmeaString]() {
+                auto ret = cbIface->gnssNmeaCb(timestamp, nmeaString);
+                if (!ret.isOk()) {
+                    ALOGE("nmeaCb: Unable to invoke callback");
+                }
+            });
 }
 
 void Gnss::setCapabilitiesCb(uint32_t capabilities) {
@@ -274,10 +297,13 @@ void Gnss::setCapabilitiesCb(uint32_t capabilities) {
         return;
     }
 
-    auto ret = sGnssCbIface->gnssSetCapabilitesCb(capabilities);
-    if (!ret.isOk()) {
-        ALOGE("%s: Unable to invoke callback", __func__);
-    }
+    GnssCallbackDispatcher::getInstance().post(
+            GnssCallbackDispatcher::Stream::CONTROL, [cbIface = sGnssCbIface, capabilities]() {
+                auto ret = cbIface->gnssSetCapabilitesCb(capabilities);
+                if (!ret.isOk()) {
+                    ALOGE("setCapabilitiesCb: Unable to invoke callback");
+                }
+            });
 
     // Save for reconnection when some legacy hal's don't resend this info
     sCapabilitiesCached = capabilities;
@@ -327,9 +353,17 @@ void Gnss::updateWakelock() {
             ALOGI("%s: GNSS HAL Wakelock acquired due to gps: %d, fused: %d", __func__,
                     sWakelockHeldGnss, sWakelockHeldFused);
             sWakelockHeld = true;
-            auto ret = sGnssCbIface->gnssAcquireWakelockCb();
-            if (!ret.isOk()) {
-                ALOGE("%s: Unable to invoke callback", __func__);
+            // Acquire right away, so that the device can't suspend before the callbacks that
+            // follow are delivered. If the previous release is still queued the framework never
+            // let go of its wakelock; withdrawing the release is enough then.
+            std::lock_guard<std::mutex> lock(sWakelockLock);
+            if (sPendingWakelockRelease != 0) {
+                sPendingWakelockRelease = 0;
+            } else {
+                auto ret = sGnssCbIface->gnssAcquireWakelockCb();
+                if (!ret.isOk()) {
+                    ALOGE("updateWakelock: Unable to invoke callback");
+                }
             }
         }
     } else {
@@ -341,10 +375,24 @@ void Gnss::updateWakelock() {
             ALOGW("%s: GNSS HAL Wakelock released, duplicate request", __func__);
         }
         sWakelockHeld = false;
-        auto ret = sGnssCbIface->gnssReleaseWakelockCb();
-        if (!ret.isOk()) {
-            ALOGE("%s: Unable to invoke callback", __func__);
-        }
+        // The release is queued behind the callbacks reported while the wakelock was held, so
+        // the framework keeps the device awake until they have all been delivered.
+        std::lock_guard<std::mutex> lock(sWakelockLock);
+        const uint64_t release = ++sLastWakelockRelease;
+        sPendingWakelockRelease = release;
+        GnssCallbackDispatcher::getInstance().post(
+                GnssCallbackDispatcher::Stream::CONTROL, [cbIface = sGnssCbIface, release]() {
+                    // Held across the call so that a concurrent acquire is ordered after it.
+                    std::lock_guard<std::mutex> lock(sWakelockLock);
+                    if (sPendingWakelockRelease != release) {
+                        return;  // Withdrawn by a later acquire, or superseded.
+                    }
+                    sPendingWakelockRelease = 0;
+                    auto ret = cbIface->gnssReleaseWakelockCb();
+                    if (!ret.isOk()) {
+                        ALOGE("updateWakelock: Unable to invoke callback");
+                    }
+                });
     }
 }
 
@@ -354,10 +402,13 @@ void Gnss::requestUtcTimeCb() {
         return;
     }
 
-    auto ret = sGnssCbIface->gnssRequestTimeCb();
-    if (!ret.isOk()) {
-            ALOGE("%s: Unable to invoke callback", __func__);
-    }
+    GnssCallbackDispatcher::getInstance().post(
+            GnssCallbackDispatcher::Stream::CONTROL, [cbIface = sGnssCbIface]() {
+                auto ret = cbIface->gnssRequestTimeCb();
+                if (!ret.isOk()) {
+                    ALOGE("requestUtcTimeCb: Unable to invoke callback");
+                }
+            });
 }
 
 pthread_t Gnss::createThreadCb(const char* name, void (*start)(void*), void* arg) {
@@ -379,10 +430,13 @@ void Gnss::setSystemInfoCb(const LegacyGnssSystemInfo* info) {
         .yearOfHw = info->year_of_hw
     };
 
-    auto ret = sGnssCbIface->gnssSetSystemInfoCb(gnssInfo);
-    if (!ret.isOk()) {
-            ALOGE("%s: Unable to invoke callback", __func__);
-    }
+    GnssCallbackDispatcher::getInstance().post(
+            GnssCallbackDispatcher::Stream::CONTROL, [cbIface = sGnssCbIface, gnssInfo]() {
+                auto ret = cbIface->gnssSetSystemInfoCb(gnssInfo);
+                if (!ret.isOk()) {
+                    ALOGE("setSystemInfoCb: Unable to invoke callback");
+                }
+            });
 
     // Save for reconnection when some legacy hal's don't resend this info
     sYearOfHwCached = info->year_of_hw;
@@ -711,6 +765,16 @@ Return<sp<IGnssBatching>> Gnss::getExtensionGnssBatching()  {
     return mGnssBatching;
 }
 
+// Methods from ::android::hidl::base::V1_0::IBase follow.
+Return<void> Gnss::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& /* options */) {
+    if (fd.getNativeHandle() == nullptr || fd->numFds < 1) {
+        ALOGE("%s: Invalid dump file descriptor", __func__);
+        return Void();
+    }
+    android::base::WriteStringToFd(GnssCallbackDispatcher::getInstance().dumpStats(), fd->data[0]);
+    return Void();
+}
+
 void Gnss::handleHidlDeath() {
     ALOGW("GNSS service noticed HIDL death. Stopping all GNSS operations.");
 
@@ -733,6 +797,12 @@ void Gnss::handleHidlDeath() {
      * before HAL processes above messages.
      */
     sGnssCbIface = nullptr;
+    GnssCallbackDispatcher::getInstance().clear();
+    {
+        // The queued release, if any, was dropped with the rest of the callbacks.
+        std::lock_guard<std::mutex> lock(sWakelockLock);
+        sPendingWakelockRelease = 0;
+    }
 }
 
 IGnss* HIDL_FETCH_IGnss(const char* /* hal */) {
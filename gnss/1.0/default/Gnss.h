@@ -28,6 +28,8 @@
 #include <GnssNi.h>
 #include <GnssXtra.h>
 
+#include <mutex>
+
 #include <ThreadCreationWrapper.h>
 #include <android/hardware/gnss/1.0/IGnss.h>
 #include <hardware/fused_location.h>
@@ -43,6 +45,7 @@ namespace implementation {
 using ::android::hardware::Return;
 using ::android::hardware::Void;
 using ::android::hardware::hidl_vec;
+using ::android::hardware::hidl_handle;
 using ::android::hardware::hidl_string;
 using ::android::sp;
 
@@ -88,6 +91,12 @@ class Gnss : public IGnss {
     Return<sp<IGnssDebug>> getExtensionGnssDebug() override;
     Return<sp<IGnssBatching>> getExtensionGnssBatching() override;
 
+    /*
+     * Methods from ::android::hidl::base::V1_0::IBase follow.
+     * Dumps the callback delivery statistics.
+     */
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& options) override;
+
     /*
      * Callback methods to be passed into the conventional GNSS HAL by the default
      * implementation. These methods are not part of the IGnss base class.
@@ -143,8 +152,19 @@ class Gnss : public IGnss {
     static void acquireWakelockGnss();
     static void releaseWakelockGnss();
     static void updateWakelock();
+    /*
+     * Hands a converted SV status over to the callback dispatcher thread.
+     */
+    static void postSvStatus(const IGnssCallback::GnssSvStatus& svStatus);
     static bool sWakelockHeldGnss;
     static bool sWakelockHeldFused;
+    /*
+     * Identifies the wakelock release that is queued on the callback dispatcher but not yet
+     * delivered, or 0 if there is none. Guarded by sWakelockLock.
+     */
+    static std::mutex sWakelockLock;
+    static uint64_t sPendingWakelockRelease;
+    static uint64_t sLastWakelockRelease;
 
     /*
      * Cleanup for death notification
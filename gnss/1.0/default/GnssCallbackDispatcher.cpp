@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "GnssHAL_CallbackDispatcher"
+
+#include "GnssCallbackDispatcher.h"
+
+#include <inttypes.h>
+
+#include <log/log.h>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace V1_0 {
+namespace implementation {
+
+namespace {
+
+const char* const kStreamNames[] = {"location", "svStatus", "measurement", "nmea",
+                                     "control"};
+
+}  // namespace
+
+GnssCallbackDispatcher& GnssCallbackDispatcher::getInstance() {
+    static GnssCallbackDispatcher instance;
+    return instance;
+}
+
+GnssCallbackDispatcher::~GnssCallbackDispatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mExiting = true;
+        mQueue.clear();
+    }
+    mCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void GnssCallbackDispatcher::post(Stream stream, Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        enqueueLocked(stream, std::move(task));
+    }
+    mCondition.notify_one();
+}
+
+void GnssCallbackDispatcher::postSvStatus(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        for (auto it = mQueue.rbegin(); it != mQueue.rend(); ++it) {
+            if (it->stream == Stream::SV_STATUS) {
+                it->task = std::move(task);
+                it->enqueueTimeNs = systemTime(SYSTEM_TIME_MONOTONIC);
+                mStats[static_cast<size_t>(Stream::SV_STATUS)].coalesced.fetch_add(
+                        1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        enqueueLocked(Stream::SV_STATUS, std::move(task));
+    }
+    mCondition.notify_one();
+}
+
+void GnssCallbackDispatcher::clear() {
+    std::lock_guard<std::mutex> lock(mLock);
+    for (const auto& queued : mQueue) {
+        mStats[static_cast<size_t>(queued.stream)].dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    mQueue.clear();
+}
+
+void GnssCallbackDispatcher::clear(Stream stream) {
+    std::lock_guard<std::mutex> lock(mLock);
+    for (auto it = mQueue.begin(); it != mQueue.end();) {
+        if (it->stream == stream) {
+            mStats[static_cast<size_t>(stream)].dropped.fetch_add(1, std::memory_order_relaxed);
+            it = mQueue.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void GnssCallbackDispatcher::enqueueLocked(Stream stream, Task task) {
+    if (mExiting) {
+        return;
+    }
+    if (!mThread.joinable()) {
+        mThread = std::thread(&GnssCallbackDispatcher::dispatchThreadLoop, this);
+    }
+    if (mQueue.size() >= kMaxQueuedCallbacks) {
+        // Make room by dropping the oldest droppable callback. If only location and CONTROL
+        // callbacks are pending the queue is allowed to grow past its bound rather than lose
+        // one of them.
+        for (auto it = mQueue.begin(); it != mQueue.end(); ++it) {
+            if (isDroppable(it->stream)) {
+                mStats[static_cast<size_t>(it->stream)].dropped.fetch_add(
+                        1, std::memory_order_relaxed);
+                mQueue.erase(it);
+                break;
+            }
+        }
+    }
+    mQueue.push_back({stream, systemTime(SYSTEM_TIME_MONOTONIC), std::move(task)});
+
+    size_t maxDepth = mMaxQueueDepth.load(std::memory_order_relaxed);
+    if (mQueue.size() > maxDepth) {
+        mMaxQueueDepth.store(mQueue.size(), std::memory_order_relaxed);
+    }
+}
+
+bool GnssCallbackDispatcher::isDroppable(Stream stream) {
+    return stream != Stream::LOCATION && stream != Stream::CONTROL;
+}
+
+void GnssCallbackDispatcher::dispatchThreadLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (!mExiting) {
+        if (mQueue.empty()) {
+            mCondition.wait(lock);
+            continue;
+        }
+        QueuedTask queued = std::move(mQueue.front());
+        mQueue.pop_front();
+
+        // Call into the framework without holding the lock so the HAL threads never wait on
+        // a binder transaction.
+        lock.unlock();
+        queued.task();
+        recordDelivery(queued.stream, systemTime(SYSTEM_TIME_MONOTONIC) - queued.enqueueTimeNs);
+        lock.lock();
+    }
+}
+
+void GnssCallbackDispatcher::recordDelivery(Stream stream, nsecs_t latencyNs) {
+    StreamStats& stats = mStats[static_cast<size_t>(stream)];
+    stats.delivered.fetch_add(1, std::memory_order_relaxed);
+    stats.totalLatencyNs.fetch_add(latencyNs, std::memory_order_relaxed);
+    nsecs_t max = stats.maxLatencyNs.load(std::memory_order_relaxed);
+    while (latencyNs > max &&
+           !stats.maxLatencyNs.compare_exchange_weak(max, latencyNs, std::memory_order_relaxed)) {
+    }
+}
+
+std::string GnssCallbackDispatcher::dumpStats() const {
+    std::string result = "Callback delivery:\n";
+    char line[160];
+    for (size_t i = 0; i < static_cast<size_t>(Stream::COUNT); i++) {
+        const StreamStats& stats = mStats[i];
+        const uint64_t delivered = stats.delivered.load(std::memory_order_relaxed);
+        const uint64_t avgUs =
+                delivered != 0
+                        ? stats.totalLatencyNs.load(std::memory_order_relaxed) / delivered / 1000
+                        : 0;
+        snprintf(line, sizeof(line),
+                 "  %s: delivered %" PRIu64 ", dropped %" PRIu64 ", coalesced %" PRIu64
+                 ", avg latency %" PRIu64 "us, max latency %" PRId64 "us\n",
+                 kStreamNames[i], delivered, stats.dropped.load(std::memory_order_relaxed),
+                 stats.coalesced.load(std::memory_order_relaxed), avgUs,
+                 static_cast<int64_t>(stats.maxLatencyNs.load(std::memory_order_relaxed) / 1000));
+        result += line;
+    }
+    snprintf(line, sizeof(line), "  max queue depth: %zu of %zu\n",
+             mMaxQueueDepth.load(std::memory_order_relaxed), kMaxQueuedCallbacks);
+    result += line;
+    return result;
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_gnss_V1_0_GnssCallbackDispatcher_H_
+#define android_hardware_gnss_V1_0_GnssCallbackDispatcher_H_
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <utils/Timers.h>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace V1_0 {
+namespace implementation {
+
+/*
+ * Delivers framework callbacks on a dedicated thread.
+ *
+ * The conventional GNSS HAL invokes its callbacks on its own threads and expects them to return
+ * quickly. Calling into the framework from there ties the HAL up for a whole binder transaction
+ * per event, which adds up at high measurement rates. Callbacks are instead converted on the HAL
+ * thread, queued here and delivered in order by a single dispatcher thread.
+ *
+ * Every callback to the framework except the wakelock acquisition goes through here, so that
+ * e.g. a wakelock release or a SESSION_END status is never delivered ahead of the fixes reported
+ * before it. The acquisition is made synchronously by the caller, as the device must not suspend
+ * while the callbacks that follow it are still queued.
+ *
+ * The queue is bounded; when it is full the oldest pending SV status, measurement or NMEA
+ * callback is dropped. Location and CONTROL callbacks (status, wakelock release, capabilities,
+ * system info and time requests) are never dropped, as the framework relies on seeing every one
+ * of them. A pending SV status callback is replaced by a newer one, as only the latest satellite
+ * list is of interest.
+ */
+class GnssCallbackDispatcher {
+  public:
+    enum class Stream : size_t {
+        LOCATION = 0,
+        SV_STATUS,
+        MEASUREMENT,
+        NMEA,
+        CONTROL,
+        COUNT
+    };
+
+    typedef std::function<void()> Task;
+
+    static GnssCallbackDispatcher& getInstance();
+
+    /*
+     * Queues a callback of the given stream. Starts the dispatcher thread if necessary.
+     */
+    void post(Stream stream, Task task);
+
+    /*
+     * Like post(), but replaces the SV status callback that is still pending, if any.
+     */
+    void postSvStatus(Task task);
+
+    /*
+     * Drops all pending callbacks, e.g. when the framework callback interface died.
+     */
+    void clear();
+
+    /*
+     * Drops the pending callbacks of a single stream, e.g. when that stream was closed.
+     */
+    void clear(Stream stream);
+
+    /*
+     * Returns the delivery statistics in a human readable form.
+     */
+    std::string dumpStats() const;
+
+  private:
+    static constexpr size_t kMaxQueuedCallbacks = 64;
+
+    struct QueuedTask {
+        Stream stream;
+        nsecs_t enqueueTimeNs;
+        Task task;
+    };
+
+    /*
+     * Per stream delivery counters. The latency is measured from the time a callback was
+     * queued until the framework call returned.
+     */
+    struct StreamStats {
+        std::atomic<uint64_t> delivered{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> coalesced{0};
+        std::atomic<uint64_t> totalLatencyNs{0};
+        std::atomic<nsecs_t> maxLatencyNs{0};
+    };
+
+    GnssCallbackDispatcher() = default;
+    ~GnssCallbackDispatcher();
+
+    GnssCallbackDispatcher(const GnssCallbackDispatcher&) = delete;
+    GnssCallbackDispatcher& operator=(const GnssCallbackDispatcher&) = delete;
+
+    static bool isDroppable(Stream stream);
+    void enqueueLocked(Stream stream, Task task);
+    void dispatchThreadLoop();
+    void recordDelivery(Stream stream, nsecs_t latencyNs);
+
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    std::deque<QueuedTask> mQueue;
+    std::thread mThread;
+    bool mExiting = false;
+    std::atomic<size_t> mMaxQueueDepth{0};
+    std::array<StreamStats, static_cast<size_t>(Stream::COUNT)> mStats;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_gnss_V1_0_GnssCallbackDispatcher_H_
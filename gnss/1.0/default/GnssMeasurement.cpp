@@ -17,6 +17,7 @@
 #define LOG_TAG "GnssHAL_GnssMeasurementInterface"
 
 #include "GnssMeasurement.h"
+#include "GnssCallbackDispatcher.h"
 
 namespace android {
 namespace hardware {
@@ -34,6 +35,17 @@ GpsMeasurementCallbacks GnssMeasurement::sGnssMeasurementCbs = {
 GnssMeasurement::GnssMeasurement(const GpsMeasurementInterface* gpsMeasurementIface)
     : mGnssMeasureIface(gpsMeasurementIface) {}
 
+void GnssMeasurement::postMeasurement(IGnssMeasurementCallback::GnssData&& gnssData) {
+    GnssCallbackDispatcher::getInstance().post(
+            GnssCallbackDispatcher::Stream::MEASUREMENT,
+            [cbIface = sGnssMeasureCbIface, gnssData = std::move(gnssData)]() {
+                auto ret = cbIface->GnssMeasurementCb(gnssData);
+                if (!ret.isOk()) {
+                    ALOGE("gnssMeasurementCb: Unable to invoke callback");
+                }
+            });
+}
+
 void GnssMeasurement::gnssMeasurementCb(LegacyGnssData* legacyGnssData) {
     if (sGnssMeasureCbIface == nullptr) {
         ALOGE("%s: GNSSMeasurement Callback Interface configured incorrectly", __func__);
@@ -96,10 +108,7 @@ void GnssMeasurement::gnssMeasurementCb(LegacyGnssData* legacyGnssData) {
         .hwClockDiscontinuityCount = clockVal.hw_clock_discontinuity_count
     };
 
-    auto ret = sGnssMeasureCbIface->GnssMeasurementCb(gnssData);
-    if (!ret.isOk()) {
-        ALOGE("%s: Unable to invoke callback", __func__);
-    }
+    postMeasurement(std::move(gnssData));
 }
 
 /*
@@ -225,10 +234,7 @@ void GnssMeasurement::gpsMeasurementCb(GpsData* gpsData) {
     gnssData.clock.driftUncertaintyNsps = clockVal.drift_uncertainty_nsps;
     gnssData.clock.gnssClockFlags = clockVal.flags;
 
-    auto ret = sGnssMeasureCbIface->GnssMeasurementCb(gnssData);
-    if (!ret.isOk()) {
-        ALOGE("%s: Unable to invoke callback", __func__);
-    }
+    postMeasurement(std::move(gnssData));
 }
 
 // Methods from ::android::hardware::gnss::V1_0::IGnssMeasurement follow.
@@ -250,6 +256,8 @@ Return<void> GnssMeasurement::close()  {
     } else {
         mGnssMeasureIface->close();
     }
+    // Measurements still queued for the framework were reported before the close, drop them.
+    GnssCallbackDispatcher::getInstance().clear(GnssCallbackDispatcher::Stream::MEASUREMENT);
     return Void();
 }
 
@@ -71,6 +71,11 @@ struct GnssMeasurement : public IGnssMeasurement {
     static GpsMeasurementCallbacks sGnssMeasurementCbs;
 
  private:
+    /*
+     * Hands converted measurements over to the callback dispatcher thread.
+     */
+    static void postMeasurement(IGnssMeasurementCallback::GnssData&& gnssData);
+
     const GpsMeasurementInterface* mGnssMeasureIface = nullptr;
     static sp<IGnssMeasurementCallback> sGnssMeasureCbIface;
 };
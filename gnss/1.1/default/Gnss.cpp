@@ -1,5 +1,7 @@
 #define LOG_TAG "Gnss"
 
+#include <android-base/parsedouble.h>
+#include <android-base/properties.h>
 #include <android/hardware/gnss/1.0/types.h>
 #include <log/log.h>
 
@@ -19,7 +21,20 @@ using GnssSvFlags = IGnssCallback::GnssSvFlags;
 const uint32_t MIN_INTERVAL_MILLIS = 100;
 sp<::android::hardware::gnss::V1_1::IGnssCallback> Gnss::sGnssCallback = nullptr;
 
-Gnss::Gnss() : mMinIntervalMs(1000), mGnssConfiguration{new GnssConfiguration()} {}
+Gnss::Gnss()
+    : mMinIntervalMs(1000),
+      mGnssConfiguration{new GnssConfiguration()},
+      mReplayRate(1.0f),
+      mReplayLoop(true) {
+    std::string trace = android::base::GetProperty("vendor.gnss.replay.trace", "");
+    if (!trace.empty()) {
+        double rate = 1.0;
+        android::base::ParseDouble(android::base::GetProperty("vendor.gnss.replay.rate", "1.0"),
+                                   &rate);
+        setReplayTrace(trace, rate, android::base::GetBoolProperty("vendor.gnss.replay.loop",
+                                                                   true));
+    }
+}
 
 Gnss::~Gnss() {
     stop();
@@ -38,6 +53,11 @@ Return<bool> Gnss::start() {
     }
 
     mIsActive = true;
+    if (mReplayer != nullptr) {
+        // The trace sets the reporting rate, mMinIntervalMs does not apply.
+        mReplayer->start(mReplayRate, mReplayLoop);
+        return true;
+    }
     mThread = std::thread([this]() {
         while (mIsActive == true) {
             auto svStatus = this->getMockSvStatus();
@@ -55,6 +75,9 @@ Return<bool> Gnss::start() {
 
 Return<bool> Gnss::stop() {
     mIsActive = false;
+    if (mReplayer != nullptr) {
+        mReplayer->stop();
+    }
     if (mThread.joinable()) {
         mThread.join();
     }
@@ -193,6 +216,29 @@ Return<bool> Gnss::injectBestLocation(const GnssLocation&) {
     return true;
 }
 
+bool Gnss::setReplayTrace(const std::string& path, float rate, bool loop) {
+    GnssTraceReplayer::Callbacks callbacks = {
+        .location = [this](const GnssLocation& location) { this->reportLocation(location); },
+        .nmea = [this](int64_t timestampMs,
+                       const hidl_string& nmea) { this->reportNmea(timestampMs, nmea); },
+        .svStatus = [this](const GnssSvStatus& svStatus) { this->reportSvStatus(svStatus); },
+        .measurement =
+            [](const IGnssMeasurementCallback::GnssData& data) {
+                GnssMeasurement::reportMeasurement(data);
+            },
+    };
+    std::unique_ptr<GnssTraceReplayer> replayer(new GnssTraceReplayer(callbacks));
+    if (!replayer->load(path)) {
+        return false;
+    }
+    stop();
+    mReplayer = std::move(replayer);
+    mReplayRate = rate;
+    mReplayLoop = loop;
+    ALOGI("Replaying %s at %.2fx%s", path.c_str(), rate, loop ? ", looping" : "");
+    return true;
+}
+
 Return<GnssLocation> Gnss::getMockLocation() const {
     GnssLocation location = {.gnssLocationFlags = 0xFF,
                              .latitudeDegrees = kMockLatitudeDegrees,
@@ -270,6 +316,16 @@ Return<void> Gnss::reportSvStatus(const GnssSvStatus& svStatus) const {
     return Void();
 }
 
+Return<void> Gnss::reportNmea(int64_t timestampMs, const hidl_string& nmea) const {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (sGnssCallback == nullptr) {
+        ALOGE("%s: sGnssCallback is null.", __func__);
+        return Void();
+    }
+    sGnssCallback->gnssNmeaCb(timestampMs, nmea);
+    return Void();
+}
+
 }  // namespace implementation
 }  // namespace V1_1
 }  // namespace gnss
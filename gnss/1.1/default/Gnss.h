@@ -5,9 +5,12 @@
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 #include <atomic>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
 #include "GnssConfiguration.h"
+#include "GnssTraceReplayer.h"
 
 namespace android {
 namespace hardware {
@@ -83,6 +86,14 @@ struct Gnss : public IGnss {
         const ::android::hardware::gnss::V1_0::GnssLocation& location) override;
 
     // Methods from ::android::hidl::base::V1_0::IBase follow.
+
+    /**
+     * Replays the given trace instead of reporting the mock location, |rate| times faster than
+     * it was recorded. Takes effect on the next start(). Returns false if the trace could not
+     * be loaded.
+     */
+    bool setReplayTrace(const std::string& path, float rate, bool loop);
+
    private:
     Return<GnssLocation> getMockLocation() const;
     Return<GnssSvStatus> getMockSvStatus() const;
@@ -90,6 +101,7 @@ struct Gnss : public IGnss {
                                  float elevationDegress, float azimuthDegress) const;
     Return<void> reportLocation(const GnssLocation&) const;
     Return<void> reportSvStatus(const GnssSvStatus&) const;
+    Return<void> reportNmea(int64_t timestampMs, const hidl_string& nmea) const;
 
     static sp<IGnssCallback> sGnssCallback;
     std::atomic<long> mMinIntervalMs;
@@ -97,6 +109,9 @@ struct Gnss : public IGnss {
     std::atomic<bool> mIsActive;
     std::thread mThread;
     mutable std::mutex mMutex;
+    std::unique_ptr<GnssTraceReplayer> mReplayer;
+    float mReplayRate;
+    bool mReplayLoop;
 };
 
 }  // namespace implementation
@@ -1,3 +1,7 @@
+#define LOG_TAG "GnssMeasurement"
+
+#include <log/log.h>
+
 #include "GnssMeasurement.h"
 
 namespace android {
@@ -6,6 +10,9 @@ namespace gnss {
 namespace V1_1 {
 namespace implementation {
 
+sp<IGnssMeasurementCallback> GnssMeasurement::sCallback = nullptr;
+std::mutex GnssMeasurement::sMutex;
+
 // Methods from ::android::hardware::gnss::V1_0::IGnssMeasurement follow.
 Return<::android::hardware::gnss::V1_0::IGnssMeasurement::GnssMeasurementStatus>
 GnssMeasurement::setCallback(const sp<::android::hardware::gnss::V1_0::IGnssMeasurementCallback>&) {
@@ -14,20 +21,33 @@ GnssMeasurement::setCallback(const sp<::android::hardware::gnss::V1_0::IGnssMeas
 }
 
 Return<void> GnssMeasurement::close() {
-    // TODO implement
+    std::unique_lock<std::mutex> lock(sMutex);
+    sCallback = nullptr;
     return Void();
 }
 
 // Methods from ::android::hardware::gnss::V1_1::IGnssMeasurement follow.
 Return<::android::hardware::gnss::V1_0::IGnssMeasurement::GnssMeasurementStatus>
 GnssMeasurement::setCallback_1_1(
-    const sp<::android::hardware::gnss::V1_1::IGnssMeasurementCallback>&, bool) {
-    // TODO implement
-    return ::android::hardware::gnss::V1_0::IGnssMeasurement::GnssMeasurementStatus{};
+    const sp<::android::hardware::gnss::V1_1::IGnssMeasurementCallback>& callback, bool) {
+    std::unique_lock<std::mutex> lock(sMutex);
+    sCallback = callback;
+    return ::android::hardware::gnss::V1_0::IGnssMeasurement::GnssMeasurementStatus::SUCCESS;
 }
 
 // Methods from ::android::hidl::base::V1_0::IBase follow.
 
+void GnssMeasurement::reportMeasurement(const IGnssMeasurementCallback::GnssData& data) {
+    std::unique_lock<std::mutex> lock(sMutex);
+    if (sCallback == nullptr) {
+        return;
+    }
+    auto ret = sCallback->gnssMeasurementCb(data);
+    if (!ret.isOk()) {
+        ALOGE("%s: Unable to invoke callback", __func__);
+    }
+}
+
 }  // namespace implementation
 }  // namespace V1_1
 }  // namespace gnss
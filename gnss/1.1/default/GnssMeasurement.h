@@ -4,6 +4,7 @@
 #include <android/hardware/gnss/1.1/IGnssMeasurement.h>
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
+#include <mutex>
 
 namespace android {
 namespace hardware {
@@ -31,6 +32,15 @@ struct GnssMeasurement : public IGnssMeasurement {
                     bool enableFullTracking) override;
 
     // Methods from ::android::hidl::base::V1_0::IBase follow.
+
+    /*
+     * Reports a measurement epoch to the registered callback, if any. Used by the trace replay.
+     */
+    static void reportMeasurement(const IGnssMeasurementCallback::GnssData& data);
+
+   private:
+    static sp<IGnssMeasurementCallback> sCallback;
+    static std::mutex sMutex;
 };
 
 }  // namespace implementation
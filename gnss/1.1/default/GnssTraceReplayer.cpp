@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "GnssTraceReplayer"
+
+#include "GnssTraceReplayer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <log/log.h>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace V1_1 {
+namespace implementation {
+
+using GnssClockFlags = V1_0::IGnssMeasurementCallback::GnssClockFlags;
+using GnssConstellationType = V1_0::GnssConstellationType;
+using GnssLocationFlags = V1_0::GnssLocationFlags;
+using GnssMeasurementFlags = V1_0::IGnssMeasurementCallback::GnssMeasurementFlags;
+using GnssSvFlags = V1_0::IGnssCallback::GnssSvFlags;
+
+namespace {
+
+// Pause between the last record of a looping trace and the first record of the next pass.
+const int64_t kLoopGapMs = 1000;
+// Records delivered later than this after their deadline are counted as late.
+const int64_t kLateThresholdUs = 1000;
+
+const size_t kFixFieldCount = 2;
+const size_t kClockFieldCount = 7;
+const size_t kRawFieldCount = 8;
+
+/*
+ * The parsers below fail on empty or malformed fields, which is how optional fields are
+ * told apart from present ones.
+ */
+bool parseDouble(const char* field, double* value) {
+    if (field == nullptr || *field == '\0') return false;
+    char* end;
+    errno = 0;
+    *value = strtod(field, &end);
+    return errno == 0 && *end == '\0';
+}
+
+bool parseInt64(const char* field, int64_t* value) {
+    if (field == nullptr || *field == '\0') return false;
+    char* end;
+    errno = 0;
+    *value = strtoll(field, &end, 10);
+    return errno == 0 && *end == '\0';
+}
+
+const char* fieldAt(const std::vector<const char*>& fields, size_t index) {
+    return index < fields.size() ? fields[index] : nullptr;
+}
+
+}  // namespace
+
+GnssTraceReplayer::GnssTraceReplayer(const Callbacks& callbacks) : mCallbacks(callbacks) {}
+
+GnssTraceReplayer::~GnssTraceReplayer() {
+    stop();
+    if (mData != nullptr) {
+        munmap(const_cast<char*>(mData), mSize);
+    }
+}
+
+bool GnssTraceReplayer::load(const std::string& path) {
+    stop();
+    if (mData != nullptr) {
+        munmap(const_cast<char*>(mData), mSize);
+        mData = nullptr;
+        mSize = 0;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ALOGE("%s: Unable to open %s: %s", __func__, path.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ALOGE("%s: Empty or unreadable trace %s", __func__, path.c_str());
+        close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        ALOGE("%s: Unable to map %s: %s", __func__, path.c_str(), strerror(errno));
+        return false;
+    }
+    // The trace is read front to back, once per pass.
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    mData = static_cast<const char*>(data);
+    mSize = st.st_size;
+
+    mPos = 0;
+    mLastTimeMs = std::numeric_limits<int64_t>::min();
+    Record first;
+    if (!readRecord(&first)) {
+        ALOGE("%s: No record found in %s", __func__, path.c_str());
+        munmap(data, mSize);
+        mData = nullptr;
+        mSize = 0;
+        return false;
+    }
+    mFirstTimeMs = first.timeMs;
+    ALOGI("Loaded GNSS trace %s (%zu bytes)", path.c_str(), mSize);
+    return true;
+}
+
+void GnssTraceReplayer::start(float rate, bool loop) {
+    stop();
+    if (!isLoaded()) {
+        ALOGE("%s: No trace loaded", __func__);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRate = rate > 0 ? rate : 1.0f;
+    mLoop = loop;
+    mTimeOffsetMs = 0;
+    mRecordCount = 0;
+    mLateRecordCount = 0;
+    mMalformedRecordCount = 0;
+    mMaxLatenessUs = 0;
+    mLoopCount = 0;
+    rewind();
+    mRunning = true;
+    mThread = std::thread(&GnssTraceReplayer::replayThreadLoop, this);
+}
+
+void GnssTraceReplayer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mRunning) {
+            return;
+        }
+        mRunning = false;
+    }
+    mCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    ALOGI("Replayed %" PRIu64 " records in %u loops at %.2fx: %" PRIu64 " late (max %" PRId64
+          "us), %" PRIu64 " malformed",
+          mRecordCount, mLoopCount, mRate, mLateRecordCount, mMaxLatenessUs,
+          mMalformedRecordCount);
+}
+
+void GnssTraceReplayer::rewind() {
+    mPos = 0;
+    mLastTimeMs = mFirstTimeMs;
+    mClock = {};
+}
+
+bool GnssTraceReplayer::waitUntil(Clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    return !mCondition.wait_until(lock, deadline, [this] { return !mRunning; });
+}
+
+void GnssTraceReplayer::replayThreadLoop() {
+    Clock::time_point base = Clock::now();
+    Record record;
+    while (true) {
+        if (!readRecord(&record)) {
+            if (!mLoop) {
+                ALOGI("End of GNSS trace");
+                break;
+            }
+            const int64_t passMs = mLastTimeMs - mFirstTimeMs + kLoopGapMs;
+            base += std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double, std::milli>(passMs / mRate));
+            mTimeOffsetMs += passMs;
+            mLoopCount++;
+            rewind();
+            continue;
+        }
+
+        const Clock::time_point deadline =
+                base + std::chrono::duration_cast<Clock::duration>(
+                               std::chrono::duration<double, std::milli>(
+                                       (record.timeMs - mFirstTimeMs) / mRate));
+        if (!waitUntil(deadline)) {
+            break;
+        }
+        const int64_t latenessUs =
+                std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - deadline)
+                        .count();
+        if (latenessUs > kLateThresholdUs) {
+            mLateRecordCount++;
+        }
+        mMaxLatenessUs = std::max(mMaxLatenessUs, latenessUs);
+        mRecordCount++;
+
+        if (record.type == RecordType::RAW) {
+            replayEpoch(record);
+        } else {
+            replayRecord(record);
+        }
+    }
+}
+
+bool GnssTraceReplayer::readRecord(Record* record) {
+    while (mPos < mSize) {
+        const char* line = mData + mPos;
+        const char* newline = static_cast<const char*>(memchr(line, '\n', mSize - mPos));
+        size_t length = newline != nullptr ? newline - line : mSize - mPos;
+        mRecordPos = mPos;
+        mPos += length + (newline != nullptr ? 1 : 0);
+
+        if (length > 0 && line[length - 1] == '\r') length--;
+        if (length == 0 || line[0] == '#') continue;
+
+        mLineBuffer.assign(line, length);
+        if (!parseRecord(record)) {
+            ALOGW("Skipping malformed trace record at offset %zu", mRecordPos);
+            mMalformedRecordCount++;
+            continue;
+        }
+        // Keep time monotonic so that deadlines never go backwards.
+        record->timeMs = std::max(record->timeMs, mLastTimeMs);
+        mLastTimeMs = record->timeMs;
+        return true;
+    }
+    return false;
+}
+
+bool GnssTraceReplayer::parseRecord(Record* record) {
+    char* type = &mLineBuffer[0];
+    char* time = strchr(type, ',');
+    if (time == nullptr) return false;
+    *time++ = '\0';
+    char* rest = strchr(time, ',');
+    if (rest != nullptr) *rest++ = '\0';
+    if (!parseInt64(time, &record->timeMs)) return false;
+
+    record->fields.clear();
+    if (strcmp(type, "NMEA") == 0) {
+        // The sentence has commas of its own and is kept whole.
+        if (rest == nullptr) return false;
+        record->type = RecordType::NMEA;
+        record->fields.push_back(rest);
+        return true;
+    }
+
+    size_t minFields;
+    if (strcmp(type, "Fix") == 0) {
+        record->type = RecordType::FIX;
+        minFields = kFixFieldCount;
+    } else if (strcmp(type, "Clock") == 0) {
+        record->type = RecordType::CLOCK;
+        minFields = kClockFieldCount;
+    } else if (strcmp(type, "Raw") == 0) {
+        record->type = RecordType::RAW;
+        minFields = kRawFieldCount;
+    } else {
+        return false;
+    }
+    while (rest != nullptr) {
+        record->fields.push_back(rest);
+        rest = strchr(rest, ',');
+        if (rest != nullptr) *rest++ = '\0';
+    }
+    return record->fields.size() >= minFields;
+}
+
+void GnssTraceReplayer::replayRecord(const Record& record) {
+    const auto& fields = record.fields;
+    switch (record.type) {
+        case RecordType::FIX: {
+            GnssLocation location = {};
+            if (!parseDouble(fields[0], &location.latitudeDegrees) ||
+                !parseDouble(fields[1], &location.longitudeDegrees)) {
+                mMalformedRecordCount++;
+                return;
+            }
+            uint16_t flags = static_cast<uint16_t>(GnssLocationFlags::HAS_LAT_LONG);
+            double value;
+            if (parseDouble(fieldAt(fields, 2), &location.altitudeMeters)) {
+                flags |= GnssLocationFlags::HAS_ALTITUDE;
+            }
+            if (parseDouble(fieldAt(fields, 3), &value)) {
+                location.speedMetersPerSec = value;
+                flags |= GnssLocationFlags::HAS_SPEED;
+            }
+            if (parseDouble(fieldAt(fields, 4), &value)) {
+                location.bearingDegrees = value;
+                flags |= GnssLocationFlags::HAS_BEARING;
+            }
+            if (parseDouble(fieldAt(fields, 5), &value)) {
+                location.horizontalAccuracyMeters = value;
+                flags |= GnssLocationFlags::HAS_HORIZONTAL_ACCURACY;
+            }
+            if (parseDouble(fieldAt(fields, 6), &value)) {
+                location.verticalAccuracyMeters = value;
+                flags |= GnssLocationFlags::HAS_VERTICAL_ACCURACY;
+            }
+            if (parseDouble(fieldAt(fields, 7), &value)) {
+                location.speedAccuracyMetersPerSecond = value;
+                flags |= GnssLocationFlags::HAS_SPEED_ACCURACY;
+            }
+            if (parseDouble(fieldAt(fields, 8), &value)) {
+                location.bearingAccuracyDegrees = value;
+                flags |= GnssLocationFlags::HAS_BEARING_ACCURACY;
+            }
+            location.gnssLocationFlags = flags;
+            location.timestamp = record.timeMs + mTimeOffsetMs;
+            if (mCallbacks.location) mCallbacks.location(location);
+            break;
+        }
+        case RecordType::NMEA:
+            if (mCallbacks.nmea) mCallbacks.nmea(record.timeMs + mTimeOffsetMs, fields[0]);
+            break;
+        case RecordType::CLOCK: {
+            V1_0::IGnssMeasurementCallback::GnssClock clock = {};
+            int64_t discontinuityCount = 0;
+            if (!parseInt64(fields[0], &clock.timeNs) ||
+                !parseInt64(fields[6], &discontinuityCount)) {
+                mMalformedRecordCount++;
+                return;
+            }
+            clock.hwClockDiscontinuityCount = discontinuityCount;
+            uint16_t flags = 0;
+            if (parseInt64(fields[1], &clock.fullBiasNs)) flags |= GnssClockFlags::HAS_FULL_BIAS;
+            if (parseDouble(fields[2], &clock.biasNs)) flags |= GnssClockFlags::HAS_BIAS;
+            if (parseDouble(fields[3], &clock.biasUncertaintyNs)) {
+                flags |= GnssClockFlags::HAS_BIAS_UNCERTAINTY;
+            }
+            if (parseDouble(fields[4], &clock.driftNsps)) flags |= GnssClockFlags::HAS_DRIFT;
+            if (parseDouble(fields[5], &clock.driftUncertaintyNsps)) {
+                flags |= GnssClockFlags::HAS_DRIFT_UNCERTAINTY;
+            }
+            clock.gnssClockFlags = flags;
+            mClock = clock;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool GnssTraceReplayer::addMeasurement(const Record& record,
+                                       std::vector<GnssMeasurement>* measurements) const {
+    const auto& fields = record.fields;
+    int64_t svid, constellation, state;
+    double cn0DbHz, prrMps, prrUncertaintyMps, carrierFrequencyHz;
+    GnssMeasurement measurement = {};
+    auto& m = measurement.v1_0;
+    if (!parseInt64(fields[0], &svid) || !parseInt64(fields[1], &constellation) ||
+        !parseDouble(fields[2], &cn0DbHz) || !parseInt64(fields[3], &state) ||
+        !parseInt64(fields[4], &m.receivedSvTimeInNs) ||
+        !parseInt64(fields[5], &m.receivedSvTimeUncertaintyInNs) ||
+        !parseDouble(fields[6], &prrMps) || !parseDouble(fields[7], &prrUncertaintyMps)) {
+        return false;
+    }
+    m.svid = svid;
+    m.constellation = static_cast<GnssConstellationType>(constellation);
+    m.cN0DbHz = cn0DbHz;
+    m.state = state;
+    m.pseudorangeRateMps = prrMps;
+    m.pseudorangeRateUncertaintyMps = prrUncertaintyMps;
+    if (parseDouble(fieldAt(fields, 8), &carrierFrequencyHz)) {
+        m.carrierFrequencyHz = carrierFrequencyHz;
+        m.flags |= GnssMeasurementFlags::HAS_CARRIER_FREQUENCY;
+    }
+    measurements->push_back(measurement);
+    return true;
+}
+
+void GnssTraceReplayer::replayEpoch(const Record& first) {
+    const int64_t epochTimeMs = first.timeMs;
+    std::vector<GnssMeasurement> measurements;
+    if (!addMeasurement(first, &measurements)) {
+        mMalformedRecordCount++;
+    }
+    Record record;
+    while (readRecord(&record)) {
+        if (record.type != RecordType::RAW || record.timeMs != epochTimeMs) {
+            // Not part of this epoch, read it again on the next iteration of the replay loop.
+            mPos = mRecordPos;
+            break;
+        }
+        if (!addMeasurement(record, &measurements)) {
+            mMalformedRecordCount++;
+        }
+    }
+    if (measurements.empty()) {
+        return;
+    }
+
+    GnssSvStatus svStatus = {};
+    svStatus.numSvs = std::min(measurements.size(),
+                               static_cast<size_t>(V1_0::GnssMax::SVS_COUNT));
+    for (uint32_t i = 0; i < svStatus.numSvs; i++) {
+        const auto& m = measurements[i].v1_0;
+        auto& info = svStatus.gnssSvList[i];
+        info.svid = m.svid;
+        info.constellation = m.constellation;
+        info.cN0Dbhz = m.cN0DbHz;
+        info.svFlag = static_cast<uint8_t>(GnssSvFlags::NONE);
+        if (m.flags & GnssMeasurementFlags::HAS_CARRIER_FREQUENCY) {
+            info.svFlag |= GnssSvFlags::HAS_CARRIER_FREQUENCY;
+            info.carrierFrequencyHz = m.carrierFrequencyHz;
+        }
+    }
+    if (mCallbacks.svStatus) mCallbacks.svStatus(svStatus);
+
+    if (mCallbacks.measurement) {
+        GnssData data;
+        data.measurements = measurements;
+        data.clock = mClock;
+        mCallbacks.measurement(data);
+    }
+}
+
+}  // namespace implementation
+}  // namespace V1_1
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_gnss_V1_1_GnssTraceReplayer_H_
+#define android_hardware_gnss_V1_1_GnssTraceReplayer_H_
+
+#include <android/hardware/gnss/1.1/IGnssCallback.h>
+#include <android/hardware/gnss/1.1/IGnssMeasurementCallback.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace V1_1 {
+namespace implementation {
+
+/*
+ * Replays a recorded trace of locations, NMEA sentences and raw measurements.
+ *
+ * The trace is a text file that is memory-mapped and parsed as it is replayed, one record per
+ * line. Empty lines and lines starting with '#' are ignored. The time of each record is in
+ * milliseconds; only the differences between records matter, except that locations and NMEA
+ * sentences report it as their UTC timestamp.
+ *
+ *   Fix,<timeMs>,<latDeg>,<lonDeg>[,<altM>,<speedMps>,<bearingDeg>,<hAccM>,<vAccM>,
+ *       <speedAccMps>,<bearingAccDeg>]
+ *   NMEA,<timeMs>,<sentence>
+ *   Clock,<timeMs>,<timeNs>,<fullBiasNs>,<biasNs>,<biasUncNs>,<driftNsps>,<driftUncNsps>,
+ *       <hwClockDiscontinuityCount>
+ *   Raw,<timeMs>,<svid>,<constellation>,<cn0DbHz>,<state>,<receivedSvTimeNs>,
+ *       <receivedSvTimeUncNs>,<pseudorangeRateMps>,<pseudorangeRateUncMps>[,<carrierFreqHz>]
+ *
+ * Consecutive Raw records with the same time form one measurement epoch, reported together
+ * with the last Clock record and an SV status derived from it. Empty optional fields are
+ * reported as unavailable.
+ *
+ * Each record is due at an absolute deadline computed from its time relative to the first
+ * record, divided by the replay rate. Sleeping until the deadline rather than for an interval
+ * keeps the replay from drifting when delivering a record takes a while, and a record that is
+ * already late is delivered right away.
+ */
+class GnssTraceReplayer {
+  public:
+    using GnssData = IGnssMeasurementCallback::GnssData;
+    using GnssMeasurement = IGnssMeasurementCallback::GnssMeasurement;
+    using GnssLocation = V1_0::GnssLocation;
+    using GnssSvStatus = V1_0::IGnssCallback::GnssSvStatus;
+
+    struct Callbacks {
+        std::function<void(const GnssLocation&)> location;
+        std::function<void(int64_t timestampMs, const hidl_string& nmea)> nmea;
+        std::function<void(const GnssSvStatus&)> svStatus;
+        std::function<void(const GnssData&)> measurement;
+    };
+
+    explicit GnssTraceReplayer(const Callbacks& callbacks);
+    ~GnssTraceReplayer();
+
+    /*
+     * Maps the trace file. Returns false if it cannot be read or contains no record.
+     */
+    bool load(const std::string& path);
+    bool isLoaded() const { return mData != nullptr; }
+
+    /*
+     * Starts replaying from the beginning of the trace, |rate| times faster than recorded.
+     * With |loop| the trace restarts once the last record is replayed, otherwise the replay
+     * thread exits.
+     */
+    void start(float rate, bool loop);
+    void stop();
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    enum class RecordType { NONE, FIX, NMEA, CLOCK, RAW };
+
+    struct Record {
+        RecordType type = RecordType::NONE;
+        int64_t timeMs = 0;
+        // Fields following the time, split in place in mLineBuffer.
+        std::vector<const char*> fields;
+    };
+
+    void replayThreadLoop();
+    void rewind();
+    bool readRecord(Record* record);
+    bool parseRecord(Record* record);
+    bool waitUntil(Clock::time_point deadline);
+    void replayRecord(const Record& record);
+    void replayEpoch(const Record& first);
+    bool addMeasurement(const Record& record, std::vector<GnssMeasurement>* measurements) const;
+
+    Callbacks mCallbacks;
+
+    // The mapped trace, the position of the next line to parse and the start of the last
+    // record read.
+    const char* mData = nullptr;
+    size_t mSize = 0;
+    size_t mPos = 0;
+    size_t mRecordPos = 0;
+    std::string mLineBuffer;
+
+    int64_t mFirstTimeMs = 0;
+    int64_t mLastTimeMs = 0;
+    // Added to reported timestamps so that they keep increasing when the trace loops.
+    int64_t mTimeOffsetMs = 0;
+    float mRate = 1.0f;
+    bool mLoop = true;
+    V1_0::IGnssMeasurementCallback::GnssClock mClock = {};
+
+    // Replay statistics, only touched by the replay thread while it runs.
+    uint64_t mRecordCount = 0;
+    uint64_t mLateRecordCount = 0;
+    uint64_t mMalformedRecordCount = 0;
+    int64_t mMaxLatenessUs = 0;
+    uint32_t mLoopCount = 0;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mRunning = false;
+    std::thread mThread;
+};
+
+}  // namespace implementation
+}  // namespace V1_1
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_gnss_V1_1_GnssTraceReplayer_H_
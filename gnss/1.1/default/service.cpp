@@ -15,6 +15,8 @@
  */
 #define LOG_TAG "android.hardware.gnss@1.1-service"
 
+#include <stdlib.h>
+
 #include <hidl/HidlSupport.h>
 #include <hidl/HidlTransportSupport.h>
 #include "Gnss.h"
@@ -26,8 +28,13 @@ using ::android::hardware::joinRpcThreadpool;
 using ::android::OK;
 using ::android::sp;
 
-int main(int /* argc */, char* /* argv */ []) {
-    sp<IGnss> gnss = new Gnss();
+int main(int argc, char* argv[]) {
+    sp<Gnss> gnss = new Gnss();
+    // Usage: android.hardware.gnss@1.1-service [<trace> [<rate>]]
+    if (argc > 1 && !gnss->setReplayTrace(argv[1], argc > 2 ? atof(argv[2]) : 1.0f, true)) {
+        ALOGE("Could not load gnss trace %s.", argv[1]);
+        return 1;
+    }
     configureRpcThreadpool(1, true /* will join */);
     if (gnss->registerAsService() != OK) {
         ALOGE("Could not register gnss 1.1 service.");
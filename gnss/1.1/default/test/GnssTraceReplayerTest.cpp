@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GnssTraceReplayer.h"
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace V1_1 {
+namespace implementation {
+
+using GnssClockFlags = V1_0::IGnssMeasurementCallback::GnssClockFlags;
+using GnssLocationFlags = V1_0::GnssLocationFlags;
+using GnssMeasurementFlags = V1_0::IGnssMeasurementCallback::GnssMeasurementFlags;
+
+namespace {
+
+// Replayed this many times faster than recorded, so that a second of trace takes 10ms.
+const float kRate = 100.0f;
+
+// One callback from the replayer.
+struct Event {
+    enum Type { LOCATION, NMEA, SV_STATUS, MEASUREMENT };
+
+    explicit Event(Type type) : type(type) {}
+
+    Type type;
+    int64_t timestampMs = 0;
+    GnssTraceReplayer::GnssLocation location = {};
+    std::string nmea;
+    GnssTraceReplayer::GnssSvStatus svStatus = {};
+    GnssTraceReplayer::GnssData data;
+};
+
+class GnssTraceReplayerTest : public ::testing::Test {
+  protected:
+    GnssTraceReplayerTest()
+        : mReplayer({
+                  [this](const GnssTraceReplayer::GnssLocation& location) {
+                      Event event(Event::LOCATION);
+                      event.timestampMs = location.timestamp;
+                      event.location = location;
+                      addEvent(event);
+                  },
+                  [this](int64_t timestampMs, const hidl_string& nmea) {
+                      Event event(Event::NMEA);
+                      event.timestampMs = timestampMs;
+                      event.nmea = nmea.c_str();
+                      addEvent(event);
+                  },
+                  [this](const GnssTraceReplayer::GnssSvStatus& svStatus) {
+                      Event event(Event::SV_STATUS);
+                      event.svStatus = svStatus;
+                      addEvent(event);
+                  },
+                  [this](const GnssTraceReplayer::GnssData& data) {
+                      Event event(Event::MEASUREMENT);
+                      event.data = data;
+                      addEvent(event);
+                  },
+          }) {}
+
+    void TearDown() override { mReplayer.stop(); }
+
+    bool load(const std::string& trace) {
+        if (!android::base::WriteStringToFile(trace, mTraceFile.path)) {
+            return false;
+        }
+        return mReplayer.load(mTraceFile.path);
+    }
+
+    void addEvent(const Event& event) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEvents.push_back(event);
+        mCondition.notify_all();
+    }
+
+    // Waits for at least |count| callbacks, and returns the first |count| of them.
+    std::vector<Event> waitForEvents(size_t count) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait_for(lock, std::chrono::seconds(5),
+                            [this, count] { return mEvents.size() >= count; });
+        return std::vector<Event>(mEvents.begin(),
+                                  mEvents.begin() + std::min(mEvents.size(), count));
+    }
+
+    // Replays the whole trace once and returns all callbacks.
+    std::vector<Event> replayOnce(size_t expectedCount) {
+        mReplayer.start(kRate, false);
+        waitForEvents(expectedCount);
+        // Let the replay reach the end of the trace, in case more callbacks come.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        mReplayer.stop();
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mEvents;
+    }
+
+    TemporaryFile mTraceFile;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<Event> mEvents;
+    GnssTraceReplayer mReplayer;
+};
+
+TEST_F(GnssTraceReplayerTest, ReplaysRecordsInOrder) {
+    ASSERT_TRUE(load(
+            "# recorded on a test drive\n"
+            "\n"
+            "Fix,1000,37.422,-122.084,5.5,1.5,90,3,4,0.5,10\n"
+            "NMEA,1000,$GPGGA,172814.0,3723.46587704,N,12202.26957864,W,2,6,1.2,18.893*5C\n"
+            "Clock,1100,5000,-1000000,0.5,,0.1,0.2,3\n"
+            "Raw,1200,5,1,40.5,16431,123456,10,-1.5,0.1,1575420000\n"
+            "Raw,1200,12,1,35,16431,234567,20,2.5,0.2\n"
+            "Raw,2200,7,3,30,1,345678,30,0.5,0.3\r\n"
+            "Fix,2500,37.5,-122.1\n"));
+
+    std::vector<Event> events = replayOnce(7);
+    ASSERT_EQ(7u, events.size());
+
+    EXPECT_EQ(Event::LOCATION, events[0].type);
+    const auto& location = events[0].location;
+    EXPECT_EQ(1000, location.timestamp);
+    EXPECT_DOUBLE_EQ(37.422, location.latitudeDegrees);
+    EXPECT_DOUBLE_EQ(-122.084, location.longitudeDegrees);
+    EXPECT_DOUBLE_EQ(5.5, location.altitudeMeters);
+    EXPECT_FLOAT_EQ(90.0f, location.bearingDegrees);
+    EXPECT_FLOAT_EQ(10.0f, location.bearingAccuracyDegrees);
+    EXPECT_EQ(GnssLocationFlags::HAS_LAT_LONG | GnssLocationFlags::HAS_ALTITUDE |
+                      GnssLocationFlags::HAS_SPEED | GnssLocationFlags::HAS_BEARING |
+                      GnssLocationFlags::HAS_HORIZONTAL_ACCURACY |
+                      GnssLocationFlags::HAS_VERTICAL_ACCURACY |
+                      GnssLocationFlags::HAS_SPEED_ACCURACY |
+                      GnssLocationFlags::HAS_BEARING_ACCURACY,
+              location.gnssLocationFlags);
+
+    EXPECT_EQ(Event::NMEA, events[1].type);
+    EXPECT_EQ(1000, events[1].timestampMs);
+    EXPECT_EQ("$GPGGA,172814.0,3723.46587704,N,12202.26957864,W,2,6,1.2,18.893*5C",
+              events[1].nmea);
+
+    // Both Raw records at 1200 form one epoch, with the clock read before them.
+    EXPECT_EQ(Event::SV_STATUS, events[2].type);
+    ASSERT_EQ(2u, events[2].svStatus.numSvs);
+    EXPECT_EQ(5, events[2].svStatus.gnssSvList[0].svid);
+    EXPECT_TRUE(events[2].svStatus.gnssSvList[0].svFlag &
+                V1_0::IGnssCallback::GnssSvFlags::HAS_CARRIER_FREQUENCY);
+    EXPECT_EQ(12, events[2].svStatus.gnssSvList[1].svid);
+    EXPECT_FALSE(events[2].svStatus.gnssSvList[1].svFlag &
+                 V1_0::IGnssCallback::GnssSvFlags::HAS_CARRIER_FREQUENCY);
+
+    EXPECT_EQ(Event::MEASUREMENT, events[3].type);
+    const auto& data = events[3].data;
+    ASSERT_EQ(2u, data.measurements.size());
+    EXPECT_EQ(5, data.measurements[0].v1_0.svid);
+    EXPECT_EQ(123456, data.measurements[0].v1_0.receivedSvTimeInNs);
+    EXPECT_FLOAT_EQ(1575420000.0f, data.measurements[0].v1_0.carrierFrequencyHz);
+    EXPECT_TRUE(data.measurements[0].v1_0.flags & GnssMeasurementFlags::HAS_CARRIER_FREQUENCY);
+    EXPECT_EQ(12, data.measurements[1].v1_0.svid);
+    EXPECT_DOUBLE_EQ(2.5, data.measurements[1].v1_0.pseudorangeRateMps);
+    EXPECT_EQ(5000, data.clock.timeNs);
+    EXPECT_EQ(-1000000, data.clock.fullBiasNs);
+    EXPECT_EQ(3u, data.clock.hwClockDiscontinuityCount);
+    // The empty bias uncertainty is reported as unavailable.
+    EXPECT_EQ(GnssClockFlags::HAS_FULL_BIAS | GnssClockFlags::HAS_BIAS |
+                      GnssClockFlags::HAS_DRIFT | GnssClockFlags::HAS_DRIFT_UNCERTAINTY,
+              data.clock.gnssClockFlags);
+
+    EXPECT_EQ(Event::SV_STATUS, events[4].type);
+    EXPECT_EQ(1u, events[4].svStatus.numSvs);
+    EXPECT_EQ(Event::MEASUREMENT, events[5].type);
+    ASSERT_EQ(1u, events[5].data.measurements.size());
+    EXPECT_EQ(7, events[5].data.measurements[0].v1_0.svid);
+
+    EXPECT_EQ(Event::LOCATION, events[6].type);
+    EXPECT_EQ(2500, events[6].location.timestamp);
+    EXPECT_EQ(static_cast<uint16_t>(GnssLocationFlags::HAS_LAT_LONG),
+              events[6].location.gnssLocationFlags);
+}
+
+TEST_F(GnssTraceReplayerTest, TimestampsKeepIncreasingAcrossLoops) {
+    ASSERT_TRUE(load(
+            "Fix,1000,37.422,-122.084\n"
+            "NMEA,1200,$GPGSA,A,3,,,,,,,,,,,,,,,*1E\n"
+            "Fix,1500,37.423,-122.085\n"));
+
+    mReplayer.start(kRate, true);
+    std::vector<Event> events = waitForEvents(9);
+    mReplayer.stop();
+    ASSERT_EQ(9u, events.size());
+
+    // Each pass lasts from the first to the last record, plus a one second gap.
+    const int64_t passMs = 500 + 1000;
+    for (int64_t pass = 0; pass < 3; pass++) {
+        SCOPED_TRACE(pass);
+        const Event* e = &events[pass * 3];
+        EXPECT_EQ(Event::LOCATION, e[0].type);
+        EXPECT_EQ(1000 + pass * passMs, e[0].timestampMs);
+        EXPECT_DOUBLE_EQ(37.422, e[0].location.latitudeDegrees);
+        EXPECT_EQ(Event::NMEA, e[1].type);
+        EXPECT_EQ(1200 + pass * passMs, e[1].timestampMs);
+        EXPECT_EQ(Event::LOCATION, e[2].type);
+        EXPECT_EQ(1500 + pass * passMs, e[2].timestampMs);
+    }
+}
+
+TEST_F(GnssTraceReplayerTest, SkipsMalformedRecords) {
+    ASSERT_TRUE(load(
+            "Fix,1000,37.422,-122.084\n"
+            "Bogus,1100,1,2\n"
+            "Fix\n"
+            "Fix,soon,37.422,-122.084\n"
+            "Fix,1200,37.422\n"
+            "Fix,1300,north,-122.084\n"
+            "NMEA,1400\n"
+            "Clock,1500,5000,,,,,\n"
+            "Clock,1500,now,,,,,,0\n"
+            "Raw,1600,5,1,40.5\n"
+            "Raw,1700,5,1,strong,16431,123456,10,-1.5,0.1\n"
+            "Raw,1700,6,1,38,16431,123456,10,-1.5,0.1\n"
+            "Fix,800,37.5,-122.1\n"));
+
+    std::vector<Event> events = replayOnce(4);
+    ASSERT_EQ(4u, events.size());
+
+    EXPECT_EQ(Event::LOCATION, events[0].type);
+    EXPECT_EQ(1000, events[0].timestampMs);
+
+    // The malformed Raw record is dropped from its epoch, and no clock was read.
+    EXPECT_EQ(Event::SV_STATUS, events[1].type);
+    ASSERT_EQ(1u, events[1].svStatus.numSvs);
+    EXPECT_EQ(6, events[1].svStatus.gnssSvList[0].svid);
+    EXPECT_EQ(Event::MEASUREMENT, events[2].type);
+    ASSERT_EQ(1u, events[2].data.measurements.size());
+    EXPECT_EQ(0, events[2].data.clock.timeNs);
+
+    // A record earlier than the previous one is replayed at the previous time.
+    EXPECT_EQ(Event::LOCATION, events[3].type);
+    EXPECT_EQ(1700, events[3].timestampMs);
+    EXPECT_DOUBLE_EQ(37.5, events[3].location.latitudeDegrees);
+}
+
+TEST_F(GnssTraceReplayerTest, LoadFailsWithoutRecords) {
+    EXPECT_FALSE(load("# no records\n\nBogus,1000\nFix,1000\n"));
+    EXPECT_FALSE(mReplayer.isLoaded());
+    EXPECT_FALSE(mReplayer.load(std::string(mTraceFile.path) + ".missing"));
+
+    ASSERT_TRUE(load("Fix,1000,37.422,-122.084"));
+    EXPECT_TRUE(mReplayer.isLoaded());
+    std::vector<Event> events = replayOnce(1);
+    ASSERT_EQ(1u, events.size());
+    EXPECT_EQ(1000, events[0].timestampMs);
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V1_1
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
@@ -20,12 +20,20 @@
 #warning "Gralloc1Hal.h included without LOG_TAG"
 #endif
 
+#include <inttypes.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <cstring>  // for strerror
+#include <list>
+#include <mutex>
+#include <string>
 
 #include <allocator-hal/2.0/AllocatorHal.h>
 #include <hardware/gralloc1.h>
 #include <log/log.h>
 #include <mapper-passthrough/2.0/GrallocBufferDescriptor.h>
+#include <utils/Trace.h>
 
 namespace android {
 namespace hardware {
@@ -47,6 +55,9 @@ class Gralloc1HalImpl : public Hal {
    public:
     ~Gralloc1HalImpl() {
         if (mDevice) {
+            for (const auto& cached : mDescriptorCache) {
+                mDispatch.destroyDescriptor(mDevice, cached.descriptor);
+            }
             gralloc1_close(mDevice);
         }
     }
@@ -78,18 +89,37 @@ class Gralloc1HalImpl : public Hal {
         buf.resize(len + 1);
         buf[len] = '\0';
 
-        return buf.data();
+        std::string debugInfo = buf.data();
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        char line[160];
+        snprintf(line, sizeof(line),
+                 "\nAllocator: %" PRIu64 " allocations, latency avg %" PRId64 "us max %" PRId64
+                 "us\n",
+                 mStats.allocations,
+                 mStats.allocations ? mStats.totalLatencyUs / int64_t(mStats.allocations) : 0,
+                 mStats.maxLatencyUs);
+        debugInfo += line;
+        snprintf(line, sizeof(line),
+                 "Descriptor cache: %zu cached, %" PRIu64 " hits, %" PRIu64 " misses\n",
+                 mDescriptorCache.size(), mStats.descriptorHits, mStats.descriptorMisses);
+        debugInfo += line;
+
+        return debugInfo;
     }
 
     Error allocateBuffers(const BufferDescriptor& descriptor, uint32_t count, uint32_t* outStride,
                           std::vector<const native_handle_t*>* outBuffers) override {
+        ATRACE_CALL();
+        const auto startTime = std::chrono::steady_clock::now();
+
         mapper::V2_0::IMapper::BufferDescriptorInfo descriptorInfo;
         if (!grallocDecodeBufferDescriptor(descriptor, &descriptorInfo)) {
             return Error::BAD_DESCRIPTOR;
         }
 
         gralloc1_buffer_descriptor_t desc;
-        Error error = createDescriptor(descriptorInfo, &desc);
+        Error error = acquireDescriptor(descriptorInfo, &desc);
         if (error != Error::NONE) {
             return error;
         }
@@ -100,6 +130,7 @@ class Gralloc1HalImpl : public Hal {
 
         // allocate the buffers
         for (uint32_t i = 0; i < count; i++) {
+            ATRACE_NAME("allocateOneBuffer");
             const native_handle_t* tmpBuffer;
             uint32_t tmpStride;
             error = allocateOneBuffer(desc, &tmpBuffer, &tmpStride);
@@ -118,7 +149,7 @@ class Gralloc1HalImpl : public Hal {
             }
         }
 
-        mDispatch.destroyDescriptor(mDevice, desc);
+        releaseDescriptor(descriptorInfo, desc);
 
         if (error != Error::NONE) {
             freeBuffers(buffers);
@@ -128,6 +159,14 @@ class Gralloc1HalImpl : public Hal {
         *outStride = stride;
         *outBuffers = std::move(buffers);
 
+        const int64_t latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                      std::chrono::steady_clock::now() - startTime)
+                                      .count();
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.allocations++;
+        mStats.totalLatencyUs += latencyUs;
+        mStats.maxLatencyUs = std::max(mStats.maxLatencyUs, latencyUs);
+
         return Error::NONE;
     }
 
@@ -310,6 +349,53 @@ class Gralloc1HalImpl : public Hal {
         return toError(error);
     }
 
+    static bool isSameDescriptorInfo(const mapper::V2_0::IMapper::BufferDescriptorInfo& a,
+                                     const mapper::V2_0::IMapper::BufferDescriptorInfo& b) {
+        return a.width == b.width && a.height == b.height && a.layerCount == b.layerCount &&
+               a.format == b.format && a.usage == b.usage;
+    }
+
+    // Take a gralloc1 descriptor matching info out of the cache, or create
+    // one.  A descriptor is used by one allocation at a time and handed back
+    // with releaseDescriptor.
+    Error acquireDescriptor(const mapper::V2_0::IMapper::BufferDescriptorInfo& info,
+                            gralloc1_buffer_descriptor_t* outDescriptor) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (auto iter = mDescriptorCache.begin(); iter != mDescriptorCache.end(); ++iter) {
+                if (isSameDescriptorInfo(iter->info, info)) {
+                    *outDescriptor = iter->descriptor;
+                    mDescriptorCache.erase(iter);
+                    mStats.descriptorHits++;
+                    return Error::NONE;
+                }
+            }
+            mStats.descriptorMisses++;
+        }
+
+        return createDescriptor(info, outDescriptor);
+    }
+
+    // Return a descriptor to the cache, evicting the least recently used one
+    // when the cache is full.
+    void releaseDescriptor(const mapper::V2_0::IMapper::BufferDescriptorInfo& info,
+                           gralloc1_buffer_descriptor_t descriptor) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const auto& cached : mDescriptorCache) {
+            // another allocation cached the same info meanwhile
+            if (isSameDescriptorInfo(cached.info, info)) {
+                mDispatch.destroyDescriptor(mDevice, descriptor);
+                return;
+            }
+        }
+
+        mDescriptorCache.push_front({info, descriptor});
+        if (mDescriptorCache.size() > kMaxCachedDescriptors) {
+            mDispatch.destroyDescriptor(mDevice, mDescriptorCache.back().descriptor);
+            mDescriptorCache.pop_back();
+        }
+    }
+
     Error allocateOneBuffer(gralloc1_buffer_descriptor_t descriptor,
                             const native_handle_t** outBuffer, uint32_t* outStride) {
         const native_handle_t* buffer = nullptr;
@@ -350,6 +436,25 @@ class Gralloc1HalImpl : public Hal {
         GRALLOC1_PFN_ALLOCATE allocate;
         GRALLOC1_PFN_RELEASE release;
     } mDispatch = {};
+
+    static constexpr size_t kMaxCachedDescriptors = 8;
+
+    struct CachedDescriptor {
+        mapper::V2_0::IMapper::BufferDescriptorInfo info;
+        gralloc1_buffer_descriptor_t descriptor;
+    };
+
+    std::mutex mMutex;
+    // most recently used first
+    std::list<CachedDescriptor> mDescriptorCache;
+
+    struct {
+        uint64_t allocations;
+        int64_t totalLatencyUs;
+        int64_t maxLatencyUs;
+        uint64_t descriptorHits;
+        uint64_t descriptorMisses;
+    } mStats = {};
 };
 
 }  // namespace detail
@@ -0,0 +1,395 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Gralloc1HalTest"
+
+#include <allocator-passthrough/2.0/Gralloc1Hal.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cutils/native_handle.h>
+#include <gtest/gtest.h>
+
+namespace android {
+namespace hardware {
+namespace graphics {
+namespace allocator {
+namespace V2_0 {
+namespace passthrough {
+namespace {
+
+using common::V1_0::BufferUsage;
+using common::V1_0::PixelFormat;
+using mapper::V2_0::BufferDescriptor;
+using mapper::V2_0::Error;
+using mapper::V2_0::IMapper;
+using mapper::V2_0::passthrough::grallocEncodeBufferDescriptor;
+
+// A gralloc1 device that keeps track of the descriptors it hands out.
+// Allocations can be held until a number of them are in flight at once.
+struct FakeGralloc1Device : gralloc1_device_t {
+    struct Descriptor {
+        uint32_t width = 0;
+        bool inUse = false;
+    };
+
+    FakeGralloc1Device() {
+        common.tag = HARDWARE_DEVICE_TAG;
+        common.close = close;
+        getCapabilities = getCapabilitiesHook;
+        getFunction = getFunctionHook;
+    }
+
+    static FakeGralloc1Device* from(gralloc1_device_t* device) {
+        return static_cast<FakeGralloc1Device*>(device);
+    }
+
+    static int close(hw_device_t* device) {
+        auto fake = from(reinterpret_cast<gralloc1_device_t*>(device));
+        std::lock_guard<std::mutex> lock(fake->mutex);
+        fake->liveDescriptorsAtClose = fake->descriptors.size();
+        fake->closed = true;
+        return 0;
+    }
+
+    static void getCapabilitiesHook(gralloc1_device_t*, uint32_t* outCount, int32_t*) {
+        *outCount = 0;
+    }
+
+    static gralloc1_function_pointer_t getFunctionHook(gralloc1_device_t*, int32_t descriptor) {
+        switch (descriptor) {
+            case GRALLOC1_FUNCTION_DUMP:
+                return reinterpret_cast<gralloc1_function_pointer_t>(dump);
+            case GRALLOC1_FUNCTION_CREATE_DESCRIPTOR:
+                return reinterpret_cast<gralloc1_function_pointer_t>(createDescriptor);
+            case GRALLOC1_FUNCTION_DESTROY_DESCRIPTOR:
+                return reinterpret_cast<gralloc1_function_pointer_t>(destroyDescriptor);
+            case GRALLOC1_FUNCTION_SET_DIMENSIONS:
+                return reinterpret_cast<gralloc1_function_pointer_t>(setDimensions);
+            case GRALLOC1_FUNCTION_SET_FORMAT:
+                return reinterpret_cast<gralloc1_function_pointer_t>(setFormat);
+            case GRALLOC1_FUNCTION_SET_CONSUMER_USAGE:
+            case GRALLOC1_FUNCTION_SET_PRODUCER_USAGE:
+                return reinterpret_cast<gralloc1_function_pointer_t>(setUsage);
+            case GRALLOC1_FUNCTION_GET_STRIDE:
+                return reinterpret_cast<gralloc1_function_pointer_t>(getStride);
+            case GRALLOC1_FUNCTION_ALLOCATE:
+                return reinterpret_cast<gralloc1_function_pointer_t>(allocate);
+            case GRALLOC1_FUNCTION_RELEASE:
+                return reinterpret_cast<gralloc1_function_pointer_t>(release);
+            default:
+                return nullptr;
+        }
+    }
+
+    static void dump(gralloc1_device_t*, uint32_t* outSize, char* outBuffer) {
+        if (outBuffer) {
+            outBuffer[0] = '\0';
+        }
+        *outSize = 0;
+    }
+
+    static int32_t createDescriptor(gralloc1_device_t* device,
+                                    gralloc1_buffer_descriptor_t* outDescriptor) {
+        auto fake = from(device);
+        std::lock_guard<std::mutex> lock(fake->mutex);
+        *outDescriptor = ++fake->lastDescriptor;
+        fake->descriptors[*outDescriptor] = {};
+        fake->createCount++;
+        return GRALLOC1_ERROR_NONE;
+    }
+
+    static int32_t destroyDescriptor(gralloc1_device_t* device,
+                                     gralloc1_buffer_descriptor_t descriptor) {
+        auto fake = from(device);
+        std::lock_guard<std::mutex> lock(fake->mutex);
+        auto iter = fake->descriptors.find(descriptor);
+        if (iter == fake->descriptors.end()) {
+            return GRALLOC1_ERROR_BAD_DESCRIPTOR;
+        }
+        if (iter->second.inUse) {
+            fake->misusedDescriptorCount++;
+        }
+        fake->descriptors.erase(iter);
+        return GRALLOC1_ERROR_NONE;
+    }
+
+    static int32_t setDimensions(gralloc1_device_t* device,
+                                 gralloc1_buffer_descriptor_t descriptor, uint32_t width,
+                                 uint32_t) {
+        auto fake = from(device);
+        std::lock_guard<std::mutex> lock(fake->mutex);
+        fake->descriptors.at(descriptor).width = width;
+        return GRALLOC1_ERROR_NONE;
+    }
+
+    static int32_t setFormat(gralloc1_device_t* device, gralloc1_buffer_descriptor_t,
+                             int32_t format) {
+        return format == static_cast<int32_t>(from(device)->badFormat)
+                   ? GRALLOC1_ERROR_BAD_VALUE
+                   : GRALLOC1_ERROR_NONE;
+    }
+
+    static int32_t setUsage(gralloc1_device_t*, gralloc1_buffer_descriptor_t, uint64_t) {
+        return GRALLOC1_ERROR_NONE;
+    }
+
+    static int32_t getStride(gralloc1_device_t*, buffer_handle_t, uint32_t* outStride) {
+        *outStride = 64;
+        return GRALLOC1_ERROR_NONE;
+    }
+
+    static int32_t allocate(gralloc1_device_t* device, uint32_t count,
+                            const gralloc1_buffer_descriptor_t* descriptors,
+                            buffer_handle_t* outBuffers) {
+        auto fake = from(device);
+        if (count != 1) {
+            return GRALLOC1_ERROR_UNSUPPORTED;
+        }
+
+        std::unique_lock<std::mutex> lock(fake->mutex);
+        auto iter = fake->descriptors.find(descriptors[0]);
+        if (iter == fake->descriptors.end()) {
+            return GRALLOC1_ERROR_BAD_DESCRIPTOR;
+        }
+        if (iter->second.inUse) {
+            fake->misusedDescriptorCount++;
+        }
+        iter->second.inUse = true;
+        fake->allocatedWidths.push_back(iter->second.width);
+
+        // wait for the other allocations to come in
+        fake->inFlight++;
+        fake->maxInFlight = std::max(fake->maxInFlight, fake->inFlight);
+        if (fake->inFlight >= fake->holdUntilInFlight) {
+            fake->holdReleased = true;
+            fake->condition.notify_all();
+        }
+        fake->condition.wait_for(lock, std::chrono::seconds(5),
+                                 [fake] { return fake->holdReleased; });
+        fake->inFlight--;
+
+        iter = fake->descriptors.find(descriptors[0]);
+        if (iter != fake->descriptors.end()) {
+            iter->second.inUse = false;
+        }
+        *outBuffers = native_handle_create(0, 0);
+        return GRALLOC1_ERROR_NONE;
+    }
+
+    // Hold allocations until count of them are in flight.
+    void holdAllocations(uint32_t count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        holdUntilInFlight = count;
+        holdReleased = false;
+    }
+
+    static int32_t release(gralloc1_device_t*, buffer_handle_t buffer) {
+        native_handle_delete(const_cast<native_handle_t*>(buffer));
+        return GRALLOC1_ERROR_NONE;
+    }
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    gralloc1_buffer_descriptor_t lastDescriptor = 0;
+    std::map<gralloc1_buffer_descriptor_t, Descriptor> descriptors;
+    std::vector<uint32_t> allocatedWidths;
+    uint32_t createCount = 0;
+    // descriptors used by two allocations, or destroyed during one
+    uint32_t misusedDescriptorCount = 0;
+    uint32_t inFlight = 0;
+    uint32_t maxInFlight = 0;
+    uint32_t holdUntilInFlight = 0;
+    bool holdReleased = true;
+    PixelFormat badFormat = PixelFormat::BLOB;
+    size_t liveDescriptorsAtClose = 0;
+    bool closed = false;
+};
+
+struct FakeGralloc1Module : hw_module_t {
+    explicit FakeGralloc1Module(FakeGralloc1Device* device) : hw_module_t(), device(device) {
+        tag = HARDWARE_MODULE_TAG;
+        module_api_version = GRALLOC_MODULE_API_VERSION_1_0;
+        id = GRALLOC_HARDWARE_MODULE_ID;
+        methods = &sMethods;
+    }
+
+    static int open(const hw_module_t* module, const char*, hw_device_t** outDevice) {
+        auto fake = static_cast<const FakeGralloc1Module*>(module);
+        *outDevice = &fake->device->common;
+        return 0;
+    }
+
+    FakeGralloc1Device* device;
+    static hw_module_methods_t sMethods;
+};
+
+hw_module_methods_t FakeGralloc1Module::sMethods = {FakeGralloc1Module::open};
+
+class Gralloc1HalTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        mHal = std::make_unique<Gralloc1Hal>();
+        ASSERT_TRUE(mHal->initWithModule(&mModule));
+    }
+
+    void TearDown() override {
+        mHal.reset();
+        EXPECT_TRUE(mDevice.closed);
+    }
+
+    static BufferDescriptor makeDescriptor(uint32_t width) {
+        IMapper::BufferDescriptorInfo info = {};
+        info.width = width;
+        info.height = 64;
+        info.layerCount = 1;
+        info.format = PixelFormat::RGBA_8888;
+        info.usage = static_cast<uint64_t>(BufferUsage::CPU_WRITE_OFTEN);
+        return grallocEncodeBufferDescriptor(info);
+    }
+
+    Error allocate(uint32_t width) {
+        uint32_t stride = 0;
+        std::vector<const native_handle_t*> buffers;
+        Error error = mHal->allocateBuffers(makeDescriptor(width), 1, &stride, &buffers);
+        mHal->freeBuffers(buffers);
+        return error;
+    }
+
+    uint32_t createCount() {
+        std::lock_guard<std::mutex> lock(mDevice.mutex);
+        return mDevice.createCount;
+    }
+
+    size_t liveDescriptorCount() {
+        std::lock_guard<std::mutex> lock(mDevice.mutex);
+        return mDevice.descriptors.size();
+    }
+
+    FakeGralloc1Device mDevice;
+    FakeGralloc1Module mModule{&mDevice};
+    std::unique_ptr<Gralloc1Hal> mHal;
+};
+
+TEST_F(Gralloc1HalTest, ReusesDescriptorOnHit) {
+    ASSERT_EQ(Error::NONE, allocate(32));
+    ASSERT_EQ(Error::NONE, allocate(32));
+    ASSERT_EQ(Error::NONE, allocate(32));
+
+    EXPECT_EQ(1u, createCount());
+    EXPECT_EQ(1u, liveDescriptorCount());
+    EXPECT_EQ((std::vector<uint32_t>{32, 32, 32}), mDevice.allocatedWidths);
+    EXPECT_NE(std::string::npos,
+              mHal->dumpDebugInfo().find("1 cached, 2 hits, 1 misses"));
+}
+
+TEST_F(Gralloc1HalTest, CreatesDescriptorOnMiss) {
+    ASSERT_EQ(Error::NONE, allocate(32));
+    ASSERT_EQ(Error::NONE, allocate(48));
+    ASSERT_EQ(Error::NONE, allocate(32));
+    ASSERT_EQ(Error::NONE, allocate(48));
+
+    // each allocation got a descriptor for its own info
+    EXPECT_EQ(2u, createCount());
+    EXPECT_EQ((std::vector<uint32_t>{32, 48, 32, 48}), mDevice.allocatedWidths);
+    EXPECT_NE(std::string::npos,
+              mHal->dumpDebugInfo().find("2 cached, 2 hits, 2 misses"));
+}
+
+TEST_F(Gralloc1HalTest, DoesNotCacheFailedDescriptor) {
+    mDevice.badFormat = PixelFormat::RGBA_8888;
+    EXPECT_EQ(Error::BAD_VALUE, allocate(32));
+    EXPECT_EQ(Error::BAD_VALUE, allocate(32));
+
+    EXPECT_EQ(2u, createCount());
+    EXPECT_EQ(0u, liveDescriptorCount());
+}
+
+TEST_F(Gralloc1HalTest, EvictsLeastRecentlyUsedDescriptor) {
+    // fill the cache, then touch the oldest entry so it is the most recent
+    for (uint32_t width = 1; width <= 8; width++) {
+        ASSERT_EQ(Error::NONE, allocate(width));
+    }
+    ASSERT_EQ(Error::NONE, allocate(1));
+    ASSERT_EQ(8u, createCount());
+    ASSERT_EQ(8u, liveDescriptorCount());
+
+    // a ninth info evicts width 2, not width 1
+    ASSERT_EQ(Error::NONE, allocate(9));
+    EXPECT_EQ(9u, createCount());
+    EXPECT_EQ(8u, liveDescriptorCount());
+
+    ASSERT_EQ(Error::NONE, allocate(1));
+    EXPECT_EQ(9u, createCount());
+    ASSERT_EQ(Error::NONE, allocate(2));
+    EXPECT_EQ(10u, createCount());
+    EXPECT_EQ(8u, liveDescriptorCount());
+}
+
+TEST_F(Gralloc1HalTest, ConcurrentAllocationsDoNotShareDescriptor) {
+    constexpr uint32_t kThreadCount = 4;
+
+    // one descriptor is cached before the allocations start
+    ASSERT_EQ(Error::NONE, allocate(32));
+    mDevice.holdAllocations(kThreadCount);
+
+    std::vector<std::thread> threads;
+    std::vector<Error> errors(kThreadCount, Error::UNSUPPORTED);
+    for (uint32_t i = 0; i < kThreadCount; i++) {
+        threads.emplace_back([this, &errors, i] { errors[i] = allocate(32); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (auto error : errors) {
+        EXPECT_EQ(Error::NONE, error);
+    }
+    EXPECT_EQ(kThreadCount, mDevice.maxInFlight);
+    EXPECT_EQ(0u, mDevice.misusedDescriptorCount);
+
+    // one thread took the cached descriptor, the others created their own,
+    // and only one of them went back to the cache
+    EXPECT_EQ(kThreadCount, createCount());
+    EXPECT_EQ(1u, liveDescriptorCount());
+    EXPECT_NE(std::string::npos,
+              mHal->dumpDebugInfo().find("1 cached, 1 hits, 4 misses"));
+}
+
+TEST_F(Gralloc1HalTest, DestroysCachedDescriptorsBeforeClose) {
+    for (uint32_t width = 1; width <= 4; width++) {
+        ASSERT_EQ(Error::NONE, allocate(width));
+    }
+    ASSERT_EQ(4u, liveDescriptorCount());
+
+    mHal.reset();
+    EXPECT_TRUE(mDevice.closed);
+    EXPECT_EQ(0u, mDevice.liveDescriptorsAtClose);
+}
+
+}  // namespace
+}  // namespace passthrough
+}  // namespace V2_0
+}  // namespace allocator
+}  // namespace graphics
+}  // namespace hardware
+}  // namespace android
@@ -263,6 +263,10 @@ class ComposerClientImpl : public Interface {
 
     Return<Error> setPowerMode(Display display, IComposerClient::PowerMode mode) override {
         Error err = mHal->setPowerMode(display, mode);
+        if (err == Error::NONE && mode == IComposerClient::PowerMode::OFF) {
+            // buffers freed before the display went off are unlikely to come back soon
+            mResources->trimIdleBuffers();
+        }
         return err;
     }
 
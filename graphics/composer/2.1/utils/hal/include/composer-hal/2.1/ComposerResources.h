@@ -20,11 +20,21 @@
 #warning "ComposerResources.h included without LOG_TAG"
 #endif
 
+#include <linux/kcmp.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <inttypes.h>
+
+#include <list>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
 
+#include <android/hardware/graphics/composer/2.1/types.h>
 #include <android/hardware/graphics/mapper/2.0/IMapper.h>
 #include <log/log.h>
 
@@ -36,20 +46,97 @@ namespace V2_1 {
 namespace hal {
 
 // wrapper for IMapper to import buffers and sideband streams
+//
+// Imported buffers are shared.  Importing a buffer that is already imported,
+// or was freed recently, returns the same handle instead of importing it
+// again through the mapper.  A buffer is identified by the open files its fds
+// refer to, as compared by kcmp(2), and by its ints.  Where kcmp is not
+// available every buffer is imported through the mapper.  Every importBuffer
+// must be balanced by a freeBuffer.  The most recently freed buffers stay
+// imported, which keeps their memory alive until they are evicted; see
+// setMaxIdleBuffers and trimIdleBuffers.
 class ComposerHandleImporter {
    public:
-    bool init() {
-        mMapper = mapper::V2_0::IMapper::getService();
+    struct BufferCacheStats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t importedCount;
+        size_t idleCount;
+    };
+
+    ComposerHandleImporter() = default;
+
+    ~ComposerHandleImporter() {
+        std::lock_guard<std::mutex> lock(mBufferCacheMutex);
+        ALOGD_IF(mBufferCacheHits || mBufferCacheMisses,
+                 "buffer import cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64
+                 " evictions",
+                 mBufferCacheHits, mBufferCacheMisses, mBufferCacheEvictions);
+        ALOGW_IF(mImportedBuffers.size() != mIdleBuffers.size(),
+                 "%zu imported buffers are still in use",
+                 mImportedBuffers.size() - mIdleBuffers.size());
+        trimIdleBuffersLocked(0);
+    }
+
+    ComposerHandleImporter(const ComposerHandleImporter&) = delete;
+    ComposerHandleImporter& operator=(const ComposerHandleImporter&) = delete;
+
+    bool init() { return init(mapper::V2_0::IMapper::getService()); }
+
+    bool init(const sp<mapper::V2_0::IMapper>& mapper) {
+        mMapper = mapper;
         ALOGE_IF(!mMapper, "failed to get mapper service");
+        mCanCompareFiles = probeCompareFiles();
+        ALOGW_IF(!mCanCompareFiles, "kcmp is unavailable, imported buffers are not shared");
+
         return mMapper != nullptr;
     }
 
+    // The idle buffers stay imported until more than maxIdleBuffers of them
+    // are pending, or until trimIdleBuffers is called.  0 frees buffers as
+    // soon as they are no longer used.
+    void setMaxIdleBuffers(size_t maxIdleBuffers) {
+        std::lock_guard<std::mutex> lock(mBufferCacheMutex);
+        mMaxIdleBuffers = maxIdleBuffers;
+        trimIdleBuffersLocked(mMaxIdleBuffers);
+    }
+
+    // Frees all idle buffers, e.g. when memory is needed elsewhere.
+    void trimIdleBuffers() {
+        std::lock_guard<std::mutex> lock(mBufferCacheMutex);
+        trimIdleBuffersLocked(0);
+    }
+
     Error importBuffer(const native_handle_t* rawHandle, const native_handle_t** outBufferHandle) {
         if (!rawHandle || (!rawHandle->numFds && !rawHandle->numInts)) {
             *outBufferHandle = nullptr;
             return Error::NONE;
         }
 
+        const bool cacheable = mCanCompareFiles && rawHandle->numFds > 0;
+        BufferKey key;
+        if (cacheable) {
+            key = getBufferKey(rawHandle);
+        }
+
+        // imports are serialized by the command engine, so the mapper is
+        // called with the lock held
+        std::lock_guard<std::mutex> lock(mBufferCacheMutex);
+        if (cacheable) {
+            auto keyIter = mBufferHandles.find(key);
+            if (keyIter != mBufferHandles.end()) {
+                ImportedBuffer& buffer = mImportedBuffers.at(keyIter->second);
+                if (buffer.refCount++ == 0) {
+                    mIdleBuffers.erase(buffer.idleIter);
+                }
+                mBufferCacheHits++;
+                *outBufferHandle = keyIter->second;
+                return Error::NONE;
+            }
+            mBufferCacheMisses++;
+        }
+
         mapper::V2_0::Error error;
         const native_handle_t* bufferHandle;
         mMapper->importBuffer(rawHandle, [&](const auto& tmpError, const auto& tmpBufferHandle) {
@@ -60,14 +147,46 @@ class ComposerHandleImporter {
             return Error::NO_RESOURCES;
         }
 
+        // The key refers to the fds of the imported handle, which stay open
+        // for as long as the buffer is in the cache, but keeps the ints of
+        // the raw handle as the mapper may have changed them.  Mappers that
+        // don't keep the fds of the raw handle in place can't share buffers.
+        if (cacheable && sameFiles(rawHandle, bufferHandle)) {
+            key.fds.assign(bufferHandle->data, bufferHandle->data + bufferHandle->numFds);
+            auto keyIter = mBufferHandles.emplace(std::move(key), bufferHandle).first;
+            mImportedBuffers.emplace(bufferHandle, ImportedBuffer{keyIter, 1, {}});
+        }
+
         *outBufferHandle = bufferHandle;
         return Error::NONE;
     }
 
     void freeBuffer(const native_handle_t* bufferHandle) {
-        if (bufferHandle) {
-            mMapper->freeBuffer(static_cast<void*>(const_cast<native_handle_t*>(bufferHandle)));
+        if (!bufferHandle) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mBufferCacheMutex);
+        auto bufferIter = mImportedBuffers.find(bufferHandle);
+        if (bufferIter == mImportedBuffers.end()) {
+            freeBufferLocked(bufferHandle);
+            return;
         }
+
+        ImportedBuffer& buffer = bufferIter->second;
+        if (--buffer.refCount > 0) {
+            return;
+        }
+
+        mIdleBuffers.push_front(bufferHandle);
+        buffer.idleIter = mIdleBuffers.begin();
+        trimIdleBuffersLocked(mMaxIdleBuffers);
+    }
+
+    BufferCacheStats getBufferCacheStats() {
+        std::lock_guard<std::mutex> lock(mBufferCacheMutex);
+        return BufferCacheStats{mBufferCacheHits, mBufferCacheMisses, mBufferCacheEvictions,
+                                mImportedBuffers.size(), mIdleBuffers.size()};
     }
 
     Error importStream(const native_handle_t* rawHandle, const native_handle_t** outStreamHandle) {
@@ -91,7 +210,133 @@ class ComposerHandleImporter {
     }
 
    private:
+    // A client that replaces a buffer in one of its cache slots often sends
+    // it again shortly after, e.g. when it reshuffles its slots or recreates a
+    // layer.  This covers the buffer queues of a couple of triple-buffered
+    // layers while bounding the memory kept alive for buffers that don't come
+    // back.
+    static constexpr size_t kDefaultMaxIdleBuffers = 8;
+
+    // the fds of a buffer, compared by the files they refer to, followed by
+    // its ints
+    struct BufferKey {
+        std::vector<int> fds;
+        std::vector<int> ints;
+    };
+
+    struct BufferKeyLess {
+        bool operator()(const BufferKey& a, const BufferKey& b) const {
+            if (a.ints != b.ints) {
+                return a.ints < b.ints;
+            }
+            if (a.fds.size() != b.fds.size()) {
+                return a.fds.size() < b.fds.size();
+            }
+            for (size_t i = 0; i < a.fds.size(); i++) {
+                int order = compareFiles(a.fds[i], b.fds[i]);
+                if (order != 0) {
+                    return order < 0;
+                }
+            }
+            return false;
+        }
+    };
+
+    using BufferHandles = std::map<BufferKey, const native_handle_t*, BufferKeyLess>;
+
+    struct ImportedBuffer {
+        BufferHandles::iterator keyIter;
+        uint32_t refCount;
+        // position in mIdleBuffers when refCount is 0
+        std::list<const native_handle_t*>::iterator idleIter;
+    };
+
+    // Orders fds by the open files they refer to.  Returns 0 when both refer
+    // to the same file, as dups and fds received over binder do.
+    static int compareFiles(int fd1, int fd2) {
+        const pid_t pid = getpid();
+        switch (syscall(SYS_kcmp, pid, pid, KCMP_FILE, fd1, fd2)) {
+            case 0:
+                return 0;
+            case 1:
+                return -1;
+            case 2:
+                return 1;
+            default:
+                // not reached once probeCompareFiles succeeded
+                return fd1 < fd2 ? -1 : (fd1 > fd2 ? 1 : 0);
+        }
+    }
+
+    static bool probeCompareFiles() {
+        int fd = eventfd(0, EFD_CLOEXEC);
+        int dupFd = fd >= 0 ? dup(fd) : -1;
+        int otherFd = eventfd(0, EFD_CLOEXEC);
+
+        bool canCompare = false;
+        if (fd >= 0 && dupFd >= 0 && otherFd >= 0) {
+            const pid_t pid = getpid();
+            const long same = syscall(SYS_kcmp, pid, pid, KCMP_FILE, fd, dupFd);
+            const long other = syscall(SYS_kcmp, pid, pid, KCMP_FILE, fd, otherFd);
+            canCompare = same == 0 && (other == 1 || other == 2);
+        }
+
+        for (int probeFd : {fd, dupFd, otherFd}) {
+            if (probeFd >= 0) {
+                close(probeFd);
+            }
+        }
+        return canCompare;
+    }
+
+    static BufferKey getBufferKey(const native_handle_t* handle) {
+        return BufferKey{std::vector<int>(handle->data, handle->data + handle->numFds),
+                         std::vector<int>(handle->data + handle->numFds,
+                                          handle->data + handle->numFds + handle->numInts)};
+    }
+
+    static bool sameFiles(const native_handle_t* rawHandle, const native_handle_t* bufferHandle) {
+        if (rawHandle->numFds != bufferHandle->numFds) {
+            return false;
+        }
+        for (int i = 0; i < rawHandle->numFds; i++) {
+            if (compareFiles(rawHandle->data[i], bufferHandle->data[i]) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void freeBufferLocked(const native_handle_t* bufferHandle) {
+        mMapper->freeBuffer(static_cast<void*>(const_cast<native_handle_t*>(bufferHandle)));
+    }
+
+    void trimIdleBuffersLocked(size_t maxIdleBuffers) {
+        while (mIdleBuffers.size() > maxIdleBuffers) {
+            const native_handle_t* bufferHandle = mIdleBuffers.back();
+            mIdleBuffers.pop_back();
+
+            auto bufferIter = mImportedBuffers.find(bufferHandle);
+            mBufferHandles.erase(bufferIter->second.keyIter);
+            mImportedBuffers.erase(bufferIter);
+
+            freeBufferLocked(bufferHandle);
+            mBufferCacheEvictions++;
+        }
+    }
+
     sp<mapper::V2_0::IMapper> mMapper;
+    bool mCanCompareFiles = false;
+
+    std::mutex mBufferCacheMutex;
+    size_t mMaxIdleBuffers = kDefaultMaxIdleBuffers;
+    BufferHandles mBufferHandles;
+    std::unordered_map<const native_handle_t*, ImportedBuffer> mImportedBuffers;
+    // buffers that are imported but no longer used, most recently freed first
+    std::list<const native_handle_t*> mIdleBuffers;
+    uint64_t mBufferCacheHits = 0;
+    uint64_t mBufferCacheMisses = 0;
+    uint64_t mBufferCacheEvictions = 0;
 };
 
 class ComposerHandleCache {
@@ -389,6 +634,14 @@ class ComposerResources {
                                                        outStreamHandle, outReplacedStream);
     }
 
+    ComposerHandleImporter::BufferCacheStats getBufferCacheStats() {
+        return mImporter.getBufferCacheStats();
+    }
+
+    void setMaxIdleBuffers(size_t maxIdleBuffers) { mImporter.setMaxIdleBuffers(maxIdleBuffers); }
+
+    void trimIdleBuffers() { mImporter.trimIdleBuffers(); }
+
    protected:
     virtual std::unique_ptr<ComposerDisplayResource> createDisplayResource(
         ComposerDisplayResource::DisplayType type, uint32_t outputBufferCacheSize) {
@@ -0,0 +1,317 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ComposerHandleImporterTest"
+
+#include <composer-hal/2.1/ComposerResources.h>
+
+#include <linux/kcmp.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include <cutils/native_handle.h>
+#include <gtest/gtest.h>
+
+namespace android {
+namespace hardware {
+namespace graphics {
+namespace composer {
+namespace V2_1 {
+namespace hal {
+namespace {
+
+using mapper::V2_0::IMapper;
+using MapperError = mapper::V2_0::Error;
+
+// A mapper that clones the handles it imports, like the passthrough mapper
+// does, and keeps track of the buffers that are still imported.
+class FakeMapper : public IMapper {
+   public:
+    // gralloc implementations may keep per-process state in the ints of the
+    // handles they import
+    static constexpr int kImportedIntMarker = 0x40000000;
+
+    Return<void> createDescriptor(const BufferDescriptorInfo&,
+                                  createDescriptor_cb hidl_cb) override {
+        hidl_cb(MapperError::UNSUPPORTED, {});
+        return Void();
+    }
+
+    Return<void> importBuffer(const hidl_handle& rawHandle, importBuffer_cb hidl_cb) override {
+        native_handle_t* bufferHandle = native_handle_clone(rawHandle.getNativeHandle());
+        if (!bufferHandle) {
+            hidl_cb(MapperError::NO_RESOURCES, nullptr);
+            return Void();
+        }
+        if (bufferHandle->numInts > 0) {
+            bufferHandle->data[bufferHandle->numFds] |= kImportedIntMarker;
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mImportedBuffers.insert(bufferHandle);
+        mImportCount++;
+        hidl_cb(MapperError::NONE, bufferHandle);
+        return Void();
+    }
+
+    Return<MapperError> freeBuffer(void* buffer) override {
+        auto bufferHandle = static_cast<native_handle_t*>(buffer);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mImportedBuffers.erase(bufferHandle) == 0) {
+            return MapperError::BAD_BUFFER;
+        }
+        native_handle_close(bufferHandle);
+        native_handle_delete(bufferHandle);
+        mFreeCount++;
+        return MapperError::NONE;
+    }
+
+    Return<void> lock(void*, uint64_t, const Rect&, const hidl_handle&,
+                      lock_cb hidl_cb) override {
+        hidl_cb(MapperError::UNSUPPORTED, nullptr);
+        return Void();
+    }
+
+    Return<void> lockYCbCr(void*, uint64_t, const Rect&, const hidl_handle&,
+                           lockYCbCr_cb hidl_cb) override {
+        hidl_cb(MapperError::UNSUPPORTED, {});
+        return Void();
+    }
+
+    Return<void> unlock(void*, unlock_cb hidl_cb) override {
+        hidl_cb(MapperError::UNSUPPORTED, nullptr);
+        return Void();
+    }
+
+    uint32_t importCount() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mImportCount;
+    }
+
+    uint32_t freeCount() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mFreeCount;
+    }
+
+    size_t importedCount() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mImportedBuffers.size();
+    }
+
+   private:
+    std::mutex mMutex;
+    std::set<native_handle_t*> mImportedBuffers;
+    uint32_t mImportCount = 0;
+    uint32_t mFreeCount = 0;
+};
+
+class ComposerHandleImporterTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        mMapper = new FakeMapper();
+        mImporter = std::make_unique<ComposerHandleImporter>();
+        ASSERT_TRUE(mImporter->init(mMapper));
+
+        // Buffers can only be shared where kcmp can tell files apart.
+        int fd = eventfd(0, EFD_CLOEXEC);
+        int otherFd = eventfd(0, EFD_CLOEXEC);
+        const pid_t pid = getpid();
+        const long order = syscall(SYS_kcmp, pid, pid, KCMP_FILE, fd, otherFd);
+        mCanShareBuffers = order == 1 || order == 2;
+        close(fd);
+        close(otherFd);
+    }
+
+    void TearDown() override {
+        for (auto rawHandle : mRawHandles) {
+            native_handle_close(rawHandle);
+            native_handle_delete(rawHandle);
+        }
+        for (int fd : mFiles) {
+            close(fd);
+        }
+
+        // all buffers must have been returned to the mapper
+        mImporter.reset();
+        EXPECT_EQ(0u, mMapper->importedCount());
+    }
+
+    // Returns a new file, standing in for the memory of a buffer.
+    int createFile() {
+        int fd = eventfd(0, EFD_CLOEXEC);
+        mFiles.push_back(fd);
+        return fd;
+    }
+
+    // Returns a handle to the buffer backed by file, as a client would send
+    // it.  Each handle gets fds of its own, as handles received over binder
+    // do.
+    const native_handle_t* createRawHandle(int file, int id) {
+        native_handle_t* rawHandle = native_handle_create(1, 1);
+        rawHandle->data[0] = dup(file);
+        rawHandle->data[1] = id;
+        mRawHandles.push_back(rawHandle);
+        return rawHandle;
+    }
+
+    const native_handle_t* importBuffer(const native_handle_t* rawHandle) {
+        const native_handle_t* bufferHandle = nullptr;
+        EXPECT_EQ(Error::NONE, mImporter->importBuffer(rawHandle, &bufferHandle));
+        EXPECT_NE(nullptr, bufferHandle);
+        return bufferHandle;
+    }
+
+    sp<FakeMapper> mMapper;
+    std::unique_ptr<ComposerHandleImporter> mImporter;
+    bool mCanShareBuffers = false;
+    std::vector<int> mFiles;
+    std::vector<native_handle_t*> mRawHandles;
+};
+
+TEST_F(ComposerHandleImporterTest, ReimportedBufferIsShared) {
+    if (!mCanShareBuffers) {
+        GTEST_LOG_(INFO) << "kcmp is unavailable, buffers are not shared";
+        return;
+    }
+
+    int file = createFile();
+    auto bufferHandle = importBuffer(createRawHandle(file, 1));
+    EXPECT_EQ(bufferHandle, importBuffer(createRawHandle(file, 1)));
+    EXPECT_EQ(1u, mMapper->importCount());
+
+    auto stats = mImporter->getBufferCacheStats();
+    EXPECT_EQ(1u, stats.hits);
+    EXPECT_EQ(1u, stats.misses);
+    EXPECT_EQ(1u, stats.importedCount);
+
+    mImporter->freeBuffer(bufferHandle);
+    mImporter->freeBuffer(bufferHandle);
+    EXPECT_EQ(0u, mMapper->freeCount());
+}
+
+TEST_F(ComposerHandleImporterTest, DifferentBuffersAreNotShared) {
+    int file = createFile();
+    auto bufferHandle = importBuffer(createRawHandle(file, 1));
+    // same ints, other file
+    auto otherFileHandle = importBuffer(createRawHandle(createFile(), 1));
+    // same file, other ints
+    auto otherIntsHandle = importBuffer(createRawHandle(file, 2));
+
+    EXPECT_NE(bufferHandle, otherFileHandle);
+    EXPECT_NE(bufferHandle, otherIntsHandle);
+    EXPECT_NE(otherFileHandle, otherIntsHandle);
+    EXPECT_EQ(3u, mMapper->importCount());
+    EXPECT_EQ(0u, mImporter->getBufferCacheStats().hits);
+
+    mImporter->freeBuffer(bufferHandle);
+    mImporter->freeBuffer(otherFileHandle);
+    mImporter->freeBuffer(otherIntsHandle);
+}
+
+TEST_F(ComposerHandleImporterTest, BufferIsIdleOnceAllReferencesAreFreed) {
+    if (!mCanShareBuffers) {
+        GTEST_LOG_(INFO) << "kcmp is unavailable, buffers are not shared";
+        return;
+    }
+
+    int file = createFile();
+    auto bufferHandle = importBuffer(createRawHandle(file, 1));
+    importBuffer(createRawHandle(file, 1));
+
+    mImporter->freeBuffer(bufferHandle);
+    EXPECT_EQ(0u, mImporter->getBufferCacheStats().idleCount);
+    mImporter->freeBuffer(bufferHandle);
+    EXPECT_EQ(1u, mImporter->getBufferCacheStats().idleCount);
+    EXPECT_EQ(0u, mMapper->freeCount());
+
+    // an idle buffer is handed out again
+    EXPECT_EQ(bufferHandle, importBuffer(createRawHandle(file, 1)));
+    auto stats = mImporter->getBufferCacheStats();
+    EXPECT_EQ(0u, stats.idleCount);
+    EXPECT_EQ(2u, stats.hits);
+    EXPECT_EQ(1u, mMapper->importCount());
+
+    mImporter->freeBuffer(bufferHandle);
+}
+
+TEST_F(ComposerHandleImporterTest, LeastRecentlyFreedBufferIsEvicted) {
+    if (!mCanShareBuffers) {
+        GTEST_LOG_(INFO) << "kcmp is unavailable, buffers are not shared";
+        return;
+    }
+
+    mImporter->setMaxIdleBuffers(2);
+    std::vector<int> files;
+    for (int i = 0; i < 3; i++) {
+        files.push_back(createFile());
+        mImporter->freeBuffer(importBuffer(createRawHandle(files.back(), i)));
+    }
+
+    auto stats = mImporter->getBufferCacheStats();
+    EXPECT_EQ(1u, stats.evictions);
+    EXPECT_EQ(2u, stats.idleCount);
+    EXPECT_EQ(1u, mMapper->freeCount());
+
+    // the first buffer was evicted, the last one is still imported
+    mImporter->freeBuffer(importBuffer(createRawHandle(files[2], 2)));
+    EXPECT_EQ(3u, mMapper->importCount());
+    mImporter->freeBuffer(importBuffer(createRawHandle(files[0], 0)));
+    EXPECT_EQ(4u, mMapper->importCount());
+}
+
+TEST_F(ComposerHandleImporterTest, IdleBuffersAreTrimmed) {
+    for (int i = 0; i < 3; i++) {
+        mImporter->freeBuffer(importBuffer(createRawHandle(createFile(), i)));
+    }
+
+    mImporter->trimIdleBuffers();
+    EXPECT_EQ(0u, mImporter->getBufferCacheStats().idleCount);
+    EXPECT_EQ(3u, mMapper->freeCount());
+
+    // without idle buffers, a buffer is freed as soon as it is no longer used
+    mImporter->setMaxIdleBuffers(0);
+    mImporter->freeBuffer(importBuffer(createRawHandle(createFile(), 3)));
+    EXPECT_EQ(4u, mMapper->freeCount());
+}
+
+TEST_F(ComposerHandleImporterTest, BufferWithoutFdsIsNotShared) {
+    native_handle_t* rawHandle = native_handle_create(0, 1);
+    rawHandle->data[0] = 1;
+    mRawHandles.push_back(rawHandle);
+
+    auto bufferHandle = importBuffer(rawHandle);
+    auto otherBufferHandle = importBuffer(rawHandle);
+    EXPECT_NE(bufferHandle, otherBufferHandle);
+
+    mImporter->freeBuffer(bufferHandle);
+    mImporter->freeBuffer(otherBufferHandle);
+    EXPECT_EQ(2u, mMapper->freeCount());
+    EXPECT_EQ(0u, mImporter->getBufferCacheStats().idleCount);
+}
+
+}  // namespace
+}  // namespace hal
+}  // namespace V2_1
+}  // namespace composer
+}  // namespace graphics
+}  // namespace hardware
+}  // namespace android
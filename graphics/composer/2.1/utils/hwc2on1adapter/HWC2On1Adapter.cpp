@@ -33,8 +33,6 @@
 #include <log/log.h>
 #include <utils/Trace.h>
 
-using namespace std::chrono_literals;
-
 static uint8_t getMinorVersion(struct hwc_composer_device_1* device)
 {
     auto version = device->common.version & HARDWARE_API_VERSION_2_MAJ_MIN_MASK;
@@ -98,15 +96,19 @@ HWC2On1Adapter::HWC2On1Adapter(hwc_composer_device_1_t* hwc1Device)
     mHwc1SupportsBackgroundColor(false),
     mHwc1Callbacks(std::make_unique<Callbacks>(*this)),
     mCapabilities(),
+    mLayersMutex(),
+    mLayersLockStats(),
     mLayers(),
-    mHwc1VirtualDisplay(),
     mStateMutex(),
     mCallbacks(),
     mHasPendingInvalidate(false),
     mPendingVsyncs(),
     mPendingHotplugs(),
+    mDisplaysMutex(),
+    mDisplaysLockStats(),
     mDisplays(),
-    mHwc1DisplayMap()
+    mHwc1DisplayMap(),
+    mHwc1VirtualDisplay()
 {
     common.close = closeHook;
     getCapabilities = getCapabilitiesHook;
@@ -315,7 +317,14 @@ hwc2_function_pointer_t HWC2On1Adapter::doGetFunction(
 
 Error HWC2On1Adapter::createVirtualDisplay(uint32_t width,
         uint32_t height, hwc2_display_t* outDisplay) {
-    std::unique_lock<std::recursive_timed_mutex> lock(mStateMutex);
+    // The display is set up before taking mDisplaysMutex, since populating
+    // its configs locks the display
+    auto display = std::make_shared<HWC2On1Adapter::Display>(*this,
+            HWC2::DisplayType::Virtual);
+    display->populateConfigs(width, height);
+    display->setHwc1Id(HWC_DISPLAY_VIRTUAL);
+
+    TrackedLock<std::mutex> lock(mDisplaysMutex, mDisplaysLockStats);
 
     if (mHwc1VirtualDisplay) {
         // We have already allocated our only HWC1 virtual display
@@ -323,12 +332,9 @@ Error HWC2On1Adapter::createVirtualDisplay(uint32_t width,
         return Error::NoResources;
     }
 
-    mHwc1VirtualDisplay = std::make_shared<HWC2On1Adapter::Display>(*this,
-            HWC2::DisplayType::Virtual);
-    mHwc1VirtualDisplay->populateConfigs(width, height);
+    mHwc1VirtualDisplay = display;
     const auto displayId = mHwc1VirtualDisplay->getId();
     mHwc1DisplayMap[HWC_DISPLAY_VIRTUAL] = displayId;
-    mHwc1VirtualDisplay->setHwc1Id(HWC_DISPLAY_VIRTUAL);
     mDisplays.emplace(displayId, mHwc1VirtualDisplay);
     *outDisplay = displayId;
 
@@ -336,7 +342,7 @@ Error HWC2On1Adapter::createVirtualDisplay(uint32_t width,
 }
 
 Error HWC2On1Adapter::destroyVirtualDisplay(hwc2_display_t displayId) {
-    std::unique_lock<std::recursive_timed_mutex> lock(mStateMutex);
+    TrackedLock<std::mutex> lock(mDisplaysMutex, mDisplaysLockStats);
 
     if (!mHwc1VirtualDisplay || (mHwc1VirtualDisplay->getId() != displayId)) {
         return Error::BadDisplay;
@@ -363,12 +369,6 @@ void HWC2On1Adapter::dump(uint32_t* outSize, char* outBuffer) {
     output << "Adapting to a HWC 1." << static_cast<int>(mHwc1MinorVersion) <<
             " device\n";
 
-    // Attempt to acquire the lock for 1 second, but proceed without the lock
-    // after that, so we can still get some information if we're deadlocked
-    std::unique_lock<std::recursive_timed_mutex> lock(mStateMutex,
-            std::defer_lock);
-    lock.try_lock_for(1s);
-
     if (mCapabilities.empty()) {
         output << "Capabilities: None\n";
     } else {
@@ -378,16 +378,27 @@ void HWC2On1Adapter::dump(uint32_t* outSize, char* outBuffer) {
         }
     }
 
+    // Dump the displays without holding mDisplaysMutex, since each of them
+    // takes its own lock
+    std::vector<std::shared_ptr<Display>> displays;
+    {
+        TrackedLock<std::mutex> lock(mDisplaysMutex, mDisplaysLockStats);
+        for (const auto& element : mDisplays) {
+            displays.emplace_back(element.second);
+        }
+    }
+
     output << "Displays:\n";
-    for (const auto& element : mDisplays) {
-        const auto& display = element.second;
+    for (const auto& display : displays) {
         output << display->dump();
     }
     output << '\n';
 
-    // Release the lock before calling into HWC1, and since we no longer require
-    // mutual exclusion to access mCapabilities or mDisplays
-    lock.unlock();
+    output << "Locks:\n";
+    output << "  HWC1 prepare/set: " << mHwc1LockStats.dump();
+    output << "  Display map: " << mDisplaysLockStats.dump();
+    output << "  Layer index: " << mLayersLockStats.dump();
+    output << '\n';
 
     if (mHwc1Device->dump) {
         output << "HWC1 dump:\n";
@@ -424,7 +435,7 @@ Error HWC2On1Adapter::registerCallback(Callback descriptor,
     ALOGV("registerCallback(%s, %p, %p)", to_string(descriptor).c_str(),
             callbackData, pointer);
 
-    std::unique_lock<std::recursive_timed_mutex> lock(mStateMutex);
+    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
     if (pointer != nullptr) {
         mCallbacks[descriptor] = {callbackData, pointer};
@@ -442,37 +453,37 @@ Error HWC2On1Adapter::registerCallback(Callback descriptor,
     if (descriptor == Callback::Refresh) {
         hasPendingInvalidate = mHasPendingInvalidate;
         if (hasPendingInvalidate) {
-            for (auto& displayPair : mDisplays) {
-                displayIds.emplace_back(displayPair.first);
-            }
+            displayIds = getDisplayIds();
         }
         mHasPendingInvalidate = false;
     } else if (descriptor == Callback::Vsync) {
         for (auto pending : mPendingVsyncs) {
             auto hwc1DisplayId = pending.first;
-            if (mHwc1DisplayMap.count(hwc1DisplayId) == 0) {
+            hwc2_display_t displayId = 0;
+            if (!getDisplayIdForHwc1Id(hwc1DisplayId, &displayId)) {
                 ALOGE("hwc1Vsync: Couldn't find display for HWC1 id %d",
                         hwc1DisplayId);
                 continue;
             }
-            auto displayId = mHwc1DisplayMap[hwc1DisplayId];
             auto timestamp = pending.second;
             pendingVsyncs.emplace_back(displayId, timestamp);
         }
         mPendingVsyncs.clear();
     } else if (descriptor == Callback::Hotplug) {
         // Hotplug the primary display
-        pendingHotplugs.emplace_back(mHwc1DisplayMap[HWC_DISPLAY_PRIMARY],
+        hwc2_display_t primaryDisplayId = 0;
+        getDisplayIdForHwc1Id(HWC_DISPLAY_PRIMARY, &primaryDisplayId);
+        pendingHotplugs.emplace_back(primaryDisplayId,
                 static_cast<int32_t>(Connection::Connected));
 
         for (auto pending : mPendingHotplugs) {
             auto hwc1DisplayId = pending.first;
-            if (mHwc1DisplayMap.count(hwc1DisplayId) == 0) {
+            hwc2_display_t displayId = 0;
+            if (!getDisplayIdForHwc1Id(hwc1DisplayId, &displayId)) {
                 ALOGE("hwc1Hotplug: Couldn't find display for HWC1 id %d",
                         hwc1DisplayId);
                 continue;
             }
-            auto displayId = mHwc1DisplayMap[hwc1DisplayId];
             auto connected = pending.second;
             pendingHotplugs.emplace_back(displayId, connected);
         }
@@ -502,6 +513,45 @@ Error HWC2On1Adapter::registerCallback(Callback descriptor,
     return Error::None;
 }
 
+// Lock statistics
+
+static void updateMax(std::atomic<int64_t>& max, int64_t value) {
+    auto current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value,
+            std::memory_order_relaxed)) {
+    }
+}
+
+void HWC2On1Adapter::LockStats::recordWait(int64_t waitNs, bool contended) {
+    mAcquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (contended) {
+        mContended.fetch_add(1, std::memory_order_relaxed);
+    }
+    mTotalWaitNs.fetch_add(waitNs, std::memory_order_relaxed);
+    updateMax(mMaxWaitNs, waitNs);
+}
+
+void HWC2On1Adapter::LockStats::recordHold(int64_t holdNs) {
+    mTotalHoldNs.fetch_add(holdNs, std::memory_order_relaxed);
+    updateMax(mMaxHoldNs, holdNs);
+}
+
+std::string HWC2On1Adapter::LockStats::dump() const {
+    auto acquisitions = mAcquisitions.load(std::memory_order_relaxed);
+    auto divisor = static_cast<int64_t>(std::max<uint64_t>(acquisitions, 1));
+
+    std::stringstream output;
+    output << acquisitions << " locks, " <<
+            mContended.load(std::memory_order_relaxed) << " contended, wait " <<
+            mTotalWaitNs.load(std::memory_order_relaxed) / divisor / 1000 <<
+            "/" << mMaxWaitNs.load(std::memory_order_relaxed) / 1000 <<
+            " us, hold " <<
+            mTotalHoldNs.load(std::memory_order_relaxed) / divisor / 1000 <<
+            "/" << mMaxHoldNs.load(std::memory_order_relaxed) / 1000 <<
+            " us (avg/max)\n";
+    return output.str();
+}
+
 // Display functions
 
 std::atomic<hwc2_display_t> HWC2On1Adapter::Display::sNextId(1);
@@ -510,7 +560,10 @@ HWC2On1Adapter::Display::Display(HWC2On1Adapter& device, HWC2::DisplayType type)
   : mId(sNextId++),
     mDevice(device),
     mStateMutex(),
+    mStateLockStats(),
     mHwc1RequestedContents(nullptr),
+    mHwc1RequestedContentsCapacity(0),
+    mNumContentsAllocations(0),
     mRetireFence(),
     mChanges(),
     mHwc1Id(-1),
@@ -532,7 +585,7 @@ HWC2On1Adapter::Display::Display(HWC2On1Adapter& device, HWC2::DisplayType type)
     {}
 
 Error HWC2On1Adapter::Display::acceptChanges() {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     if (!mChanges) {
         ALOGV("[%" PRIu64 "] acceptChanges failed, not validated", mId);
@@ -544,13 +597,13 @@ Error HWC2On1Adapter::Display::acceptChanges() {
     for (auto& change : mChanges->getTypeChanges()) {
         auto layerId = change.first;
         auto type = change.second;
-        if (mDevice.mLayers.count(layerId) == 0) {
+        auto layer = mDevice.findLayer(layerId);
+        if (!layer) {
             // This should never happen but somehow does.
             ALOGW("Cannot accept change for unknown layer (%" PRIu64 ")",
                   layerId);
             continue;
         }
-        auto layer = mDevice.mLayers[layerId];
         layer->setCompositionType(type);
     }
 
@@ -560,10 +613,10 @@ Error HWC2On1Adapter::Display::acceptChanges() {
 }
 
 Error HWC2On1Adapter::Display::createLayer(hwc2_layer_t* outLayerId) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     auto layer = *mLayers.emplace(std::make_shared<Layer>(*this));
-    mDevice.mLayers.emplace(std::make_pair(layer->getId(), layer));
+    mDevice.addLayer(layer);
     *outLayerId = layer->getId();
     ALOGV("[%" PRIu64 "] created layer %" PRIu64, mId, *outLayerId);
     markGeometryChanged();
@@ -571,16 +624,14 @@ Error HWC2On1Adapter::Display::createLayer(hwc2_layer_t* outLayerId) {
 }
 
 Error HWC2On1Adapter::Display::destroyLayer(hwc2_layer_t layerId) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
-    const auto mapLayer = mDevice.mLayers.find(layerId);
-    if (mapLayer == mDevice.mLayers.end()) {
+    const auto layer = mDevice.removeLayer(layerId);
+    if (!layer) {
         ALOGV("[%" PRIu64 "] destroyLayer(%" PRIu64 ") failed: no such layer",
                 mId, layerId);
         return Error::BadLayer;
     }
-    const auto layer = mapLayer->second;
-    mDevice.mLayers.erase(mapLayer);
     const auto zRange = mLayers.equal_range(layer);
     for (auto current = zRange.first; current != zRange.second; ++current) {
         if (**current == *layer) {
@@ -594,7 +645,7 @@ Error HWC2On1Adapter::Display::destroyLayer(hwc2_layer_t layerId) {
 }
 
 Error HWC2On1Adapter::Display::getActiveConfig(hwc2_config_t* outConfig) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     if (!mActiveConfig) {
         ALOGV("[%" PRIu64 "] getActiveConfig --> %s", mId,
@@ -609,7 +660,7 @@ Error HWC2On1Adapter::Display::getActiveConfig(hwc2_config_t* outConfig) {
 
 Error HWC2On1Adapter::Display::getAttribute(hwc2_config_t configId,
         Attribute attribute, int32_t* outValue) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     if (configId > mConfigs.size() || !mConfigs[configId]->isOnDisplay(*this)) {
         ALOGV("[%" PRIu64 "] getAttribute failed: bad config (%u)", mId,
@@ -624,7 +675,7 @@ Error HWC2On1Adapter::Display::getAttribute(hwc2_config_t configId,
 
 Error HWC2On1Adapter::Display::getChangedCompositionTypes(
         uint32_t* outNumElements, hwc2_layer_t* outLayers, int32_t* outTypes) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     if (!mChanges) {
         ALOGE("[%" PRIu64 "] getChangedCompositionTypes failed: not validated",
@@ -657,7 +708,7 @@ Error HWC2On1Adapter::Display::getChangedCompositionTypes(
 
 Error HWC2On1Adapter::Display::getColorModes(uint32_t* outNumModes,
         int32_t* outModes) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     if (!outModes) {
         *outNumModes = mColorModes.size();
@@ -672,7 +723,7 @@ Error HWC2On1Adapter::Display::getColorModes(uint32_t* outNumModes,
 
 Error HWC2On1Adapter::Display::getConfigs(uint32_t* outNumConfigs,
         hwc2_config_t* outConfigs) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     if (!outConfigs) {
         *outNumConfigs = mConfigs.size();
@@ -691,7 +742,7 @@ Error HWC2On1Adapter::Display::getConfigs(uint32_t* outNumConfigs,
 }
 
 Error HWC2On1Adapter::Display::getDozeSupport(int32_t* outSupport) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     if (mDevice.mHwc1MinorVersion < 4 || mHwc1Id != 0) {
         *outSupport = 0;
@@ -710,7 +761,7 @@ Error HWC2On1Adapter::Display::getHdrCapabilities(uint32_t* outNumTypes,
 }
 
 Error HWC2On1Adapter::Display::getName(uint32_t* outSize, char* outName) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     if (!outName) {
         *outSize = mName.size();
@@ -723,7 +774,7 @@ Error HWC2On1Adapter::Display::getName(uint32_t* outSize, char* outName) {
 
 Error HWC2On1Adapter::Display::getReleaseFences(uint32_t* outNumElements,
         hwc2_layer_t* outLayers, int32_t* outFences) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     uint32_t numWritten = 0;
     bool outputsNonNull = (outLayers != nullptr) && (outFences != nullptr);
@@ -749,7 +800,7 @@ Error HWC2On1Adapter::Display::getReleaseFences(uint32_t* outNumElements,
 Error HWC2On1Adapter::Display::getRequests(int32_t* outDisplayRequests,
         uint32_t* outNumElements, hwc2_layer_t* outLayers,
         int32_t* outLayerRequests) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     if (!mChanges) {
         return Error::NotValidated;
@@ -778,14 +829,14 @@ Error HWC2On1Adapter::Display::getRequests(int32_t* outDisplayRequests,
 }
 
 Error HWC2On1Adapter::Display::getType(int32_t* outType) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     *outType = static_cast<int32_t>(mType);
     return Error::None;
 }
 
 Error HWC2On1Adapter::Display::present(int32_t* outRetireFence) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     if (mChanges) {
         Error error = mDevice.setAllDisplays();
@@ -804,7 +855,7 @@ Error HWC2On1Adapter::Display::present(int32_t* outRetireFence) {
 }
 
 Error HWC2On1Adapter::Display::setActiveConfig(hwc2_config_t configId) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     auto config = getConfig(configId);
     if (!config) {
@@ -836,7 +887,7 @@ Error HWC2On1Adapter::Display::setActiveConfig(hwc2_config_t configId) {
 
 Error HWC2On1Adapter::Display::setClientTarget(buffer_handle_t target,
         int32_t acquireFence, int32_t /*dataspace*/, hwc_region_t /*damage*/) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     ALOGV("[%" PRIu64 "] setClientTarget(%p, %d)", mId, target, acquireFence);
     mClientTarget.setBuffer(target);
@@ -846,7 +897,7 @@ Error HWC2On1Adapter::Display::setClientTarget(buffer_handle_t target,
 }
 
 Error HWC2On1Adapter::Display::setColorMode(android_color_mode_t mode) {
-    std::unique_lock<std::recursive_mutex> lock (mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     ALOGV("[%" PRIu64 "] setColorMode(%d)", mId, mode);
 
@@ -879,7 +930,7 @@ Error HWC2On1Adapter::Display::setColorMode(android_color_mode_t mode) {
 }
 
 Error HWC2On1Adapter::Display::setColorTransform(android_color_transform_t hint) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     ALOGV("%" PRIu64 "] setColorTransform(%d)", mId,
             static_cast<int32_t>(hint));
@@ -889,7 +940,7 @@ Error HWC2On1Adapter::Display::setColorTransform(android_color_transform_t hint)
 
 Error HWC2On1Adapter::Display::setOutputBuffer(buffer_handle_t buffer,
         int32_t releaseFence) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     ALOGV("[%" PRIu64 "] setOutputBuffer(%p, %d)", mId, buffer, releaseFence);
     mOutputBuffer.setBuffer(buffer);
@@ -923,7 +974,7 @@ Error HWC2On1Adapter::Display::setPowerMode(PowerMode mode) {
         return Error::None;
     }
 
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     int error = 0;
     if (mDevice.mHwc1MinorVersion < 4) {
@@ -957,7 +1008,7 @@ Error HWC2On1Adapter::Display::setVsyncEnabled(Vsync enable) {
         return Error::None;
     }
 
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     int error = mDevice.mHwc1Device->eventControl(mDevice.mHwc1Device,
             mHwc1Id, HWC_EVENT_VSYNC, enable == Vsync::Enable);
@@ -970,7 +1021,7 @@ Error HWC2On1Adapter::Display::setVsyncEnabled(Vsync enable) {
 
 Error HWC2On1Adapter::Display::validate(uint32_t* outNumTypes,
         uint32_t* outNumRequests) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     if (!mChanges) {
         if (!mDevice.prepareAllDisplays()) {
@@ -992,15 +1043,14 @@ Error HWC2On1Adapter::Display::validate(uint32_t* outNumTypes,
 }
 
 Error HWC2On1Adapter::Display::updateLayerZ(hwc2_layer_t layerId, uint32_t z) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
-    const auto mapLayer = mDevice.mLayers.find(layerId);
-    if (mapLayer == mDevice.mLayers.end()) {
+    const auto layer = mDevice.findLayer(layerId);
+    if (!layer) {
         ALOGE("[%" PRIu64 "] updateLayerZ failed to find layer", mId);
         return Error::BadLayer;
     }
 
-    const auto layer = mapLayer->second;
     const auto zRange = mLayers.equal_range(layer);
     bool layerOnDisplay = false;
     for (auto current = zRange.first; current != zRange.second; ++current) {
@@ -1109,7 +1159,7 @@ static_assert(attributesMatch<HWC_DISPLAY_COLOR_TRANSFORM>(),
         "Tables out of sync");
 
 void HWC2On1Adapter::Display::populateConfigs() {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     ALOGV("[%" PRIu64 "] populateConfigs", mId);
 
@@ -1187,7 +1237,7 @@ void HWC2On1Adapter::Display::populateConfigs() {
 }
 
 void HWC2On1Adapter::Display::populateConfigs(uint32_t width, uint32_t height) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     mConfigs.emplace_back(std::make_shared<Config>(*this));
     auto& config = mConfigs[0];
@@ -1200,7 +1250,7 @@ void HWC2On1Adapter::Display::populateConfigs(uint32_t width, uint32_t height) {
 }
 
 bool HWC2On1Adapter::Display::prepare() {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     // Only prepare display contents for displays HWC1 knows about
     if (mHwc1Id == -1) {
@@ -1231,6 +1281,8 @@ bool HWC2On1Adapter::Display::prepare() {
         auto& hwc1Layer = mHwc1RequestedContents->hwLayers[layer->getHwc1Id()];
         hwc1Layer.releaseFenceFd = -1;
         hwc1Layer.acquireFenceFd = -1;
+        // HWC1 writes hints during prepare, so they don't survive a frame
+        hwc1Layer.hints = 0;
         ALOGV("Applying states for layer %" PRIu64 " ", layer->getId());
         layer->applyState(hwc1Layer);
     }
@@ -1243,7 +1295,7 @@ bool HWC2On1Adapter::Display::prepare() {
 }
 
 void HWC2On1Adapter::Display::generateChanges() {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     mChanges.reset(new Changes);
 
@@ -1265,12 +1317,12 @@ void HWC2On1Adapter::Display::generateChanges() {
 }
 
 bool HWC2On1Adapter::Display::hasChanges() const {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
     return mChanges != nullptr;
 }
 
 Error HWC2On1Adapter::Display::set(hwc_display_contents_1& hwcContents) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     if (!mChanges || (mChanges->getNumTypes() > 0)) {
         ALOGE("[%" PRIu64 "] set failed: not validated", mId);
@@ -1306,13 +1358,13 @@ Error HWC2On1Adapter::Display::set(hwc_display_contents_1& hwcContents) {
 }
 
 void HWC2On1Adapter::Display::addRetireFence(int fenceFd) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
     mRetireFence.add(fenceFd);
 }
 
 void HWC2On1Adapter::Display::addReleaseFences(
         const hwc_display_contents_1_t& hwcContents) {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     size_t numLayers = hwcContents.numHwLayers;
     for (size_t hwc1Id = 0; hwc1Id < numLayers; ++hwc1Id) {
@@ -1339,7 +1391,7 @@ void HWC2On1Adapter::Display::addReleaseFences(
 }
 
 bool HWC2On1Adapter::Display::hasColorTransform() const {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
     return mHasColorTransform;
 }
 
@@ -1511,7 +1563,7 @@ static std::string to_string(const hwc_display_contents_1_t& hwcContents,
 }
 
 std::string HWC2On1Adapter::Display::dump() const {
-    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    TrackedLock<std::recursive_mutex> lock(mStateMutex, mStateLockStats);
 
     std::stringstream output;
 
@@ -1550,7 +1602,12 @@ std::string HWC2On1Adapter::Display::dump() const {
         output << "    Output buffer: " << mOutputBuffer.getBuffer() << '\n';
     }
 
+    output << "    State lock: " << mStateLockStats.dump();
+
     if (mHwc1RequestedContents) {
+        output << "    HWC1 contents: " << mHwc1RequestedContentsCapacity <<
+                " bytes, allocated " << mNumContentsAllocations << " time" <<
+                (mNumContentsAllocations == 1 ? "" : "s") << '\n';
         output << "    Last requested HWC1 state\n";
         output << to_string(*mHwc1RequestedContents, mDevice.mHwc1MinorVersion);
     }
@@ -1807,8 +1864,24 @@ void HWC2On1Adapter::Display::allocateRequestedContents() {
     size_t size = sizeof(hwc_display_contents_1_t) +
             sizeof(hwc_layer_1_t) * numLayers +
             sizeof(hwc_rect_t) * numRects;
-    auto contents = static_cast<hwc_display_contents_1_t*>(std::calloc(size, 1));
-    mHwc1RequestedContents.reset(contents);
+
+    // Reuse the previous frame's allocation when it is large enough. Layers
+    // keep their HWC1 slot while the layer stack is unchanged, so their
+    // geometry doesn't need to be written again. Grow with some headroom so
+    // that adding a layer or two doesn't reallocate every time.
+    if (!mHwc1RequestedContents || size > mHwc1RequestedContentsCapacity) {
+        size_t capacity = size + size / 2;
+        auto contents = static_cast<hwc_display_contents_1_t*>(
+                std::calloc(capacity, 1));
+        mHwc1RequestedContents.reset(contents);
+        mHwc1RequestedContentsCapacity = capacity;
+        ++mNumContentsAllocations;
+        for (auto& layer : mLayers) {
+            layer->markStateDirty();
+        }
+    }
+
+    auto contents = mHwc1RequestedContents.get();
     mNextAvailableRect = reinterpret_cast<hwc_rect_t*>(&contents->hwLayers[numLayers]);
     mNumAvailableRects = numRects;
 }
@@ -1872,6 +1945,8 @@ void HWC2On1Adapter::Display::prepareFramebufferTarget() {
 
     auto& hwc1Target = mHwc1RequestedContents->hwLayers[mLayers.size()];
     hwc1Target.compositionType = HWC_FRAMEBUFFER_TARGET;
+    // The client target is only provided in set
+    hwc1Target.handle = nullptr;
     hwc1Target.releaseFenceFd = -1;
     hwc1Target.hints = 0;
     hwc1Target.flags = 0;
@@ -1919,7 +1994,8 @@ HWC2On1Adapter::Layer::Layer(Display& display)
     mZ(0),
     mReleaseFence(),
     mHwc1Id(0),
-    mHasUnsupportedPlaneAlpha(false) {}
+    mHasUnsupportedPlaneAlpha(false),
+    mStateDirty(true) {}
 
 bool HWC2On1Adapter::SortLayersByZ::operator()(
         const std::shared_ptr<Layer>& lhs, const std::shared_ptr<Layer>& rhs) {
@@ -1963,18 +2039,21 @@ Error HWC2On1Adapter::Layer::setSurfaceDamage(hwc_region_t damage) {
 
 Error HWC2On1Adapter::Layer::setBlendMode(BlendMode mode) {
     mBlendMode = mode;
+    mStateDirty = true;
     mDisplay.markGeometryChanged();
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setColor(hwc_color_t color) {
     mColor = color;
+    mStateDirty = true;
     mDisplay.markGeometryChanged();
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setCompositionType(Composition type) {
     mCompositionType = type;
+    mStateDirty = true;
     mDisplay.markGeometryChanged();
     return Error::None;
 }
@@ -1985,30 +2064,35 @@ Error HWC2On1Adapter::Layer::setDataspace(android_dataspace_t) {
 
 Error HWC2On1Adapter::Layer::setDisplayFrame(hwc_rect_t frame) {
     mDisplayFrame = frame;
+    mStateDirty = true;
     mDisplay.markGeometryChanged();
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setPlaneAlpha(float alpha) {
     mPlaneAlpha = alpha;
+    mStateDirty = true;
     mDisplay.markGeometryChanged();
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setSidebandStream(const native_handle_t* stream) {
     mSidebandStream = stream;
+    mStateDirty = true;
     mDisplay.markGeometryChanged();
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setSourceCrop(hwc_frect_t crop) {
     mSourceCrop = crop;
+    mStateDirty = true;
     mDisplay.markGeometryChanged();
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setTransform(Transform transform) {
     mTransform = transform;
+    mStateDirty = true;
     mDisplay.markGeometryChanged();
     return Error::None;
 }
@@ -2026,6 +2110,7 @@ Error HWC2On1Adapter::Layer::setVisibleRegion(hwc_region_t visible) {
                     compareRects)) {
         mVisibleRegion.resize(visible.numRects);
         std::copy_n(visible.rects, visible.numRects, mVisibleRegion.begin());
+        mStateDirty = true;
         mDisplay.markGeometryChanged();
     }
     return Error::None;
@@ -2046,13 +2131,27 @@ const sp<MiniFence>& HWC2On1Adapter::Layer::getReleaseFence() const {
 }
 
 void HWC2On1Adapter::Layer::applyState(hwc_layer_1_t& hwc1Layer) {
-    applyCommonState(hwc1Layer);
+    if (mStateDirty) {
+        applyCommonState(hwc1Layer);
+    }
+    applyVisibleRegion(hwc1Layer);
+    // HWC1 overwrites the composition type during prepare and the color
+    // transform is per display, so this is always applied.
     applyCompositionType(hwc1Layer);
     switch (mCompositionType) {
-        case Composition::SolidColor : applySolidColorState(hwc1Layer); break;
-        case Composition::Sideband : applySidebandState(hwc1Layer); break;
+        case Composition::SolidColor :
+            if (mStateDirty) {
+                applySolidColorState(hwc1Layer);
+            }
+            break;
+        case Composition::Sideband :
+            if (mStateDirty) {
+                applySidebandState(hwc1Layer);
+            }
+            break;
         default: applyBufferState(hwc1Layer); break;
     }
+    mStateDirty = false;
 }
 
 static std::string regionStrings(const std::vector<hwc_rect_t>& visibleRegion,
@@ -2151,10 +2250,18 @@ void HWC2On1Adapter::Layer::applyCommonState(hwc_layer_1_t& hwc1Layer) {
     }
 
     hwc1Layer.transform = static_cast<uint32_t>(mTransform);
+}
 
+void HWC2On1Adapter::Layer::applyVisibleRegion(hwc_layer_1_t& hwc1Layer) {
+    // Rects are handed out in layer order on every frame, so they land at the
+    // same place as long as no layer before this one changed its region.
     auto& hwc1VisibleRegion = hwc1Layer.visibleRegionScreen;
+    hwc_rect_t* rects = mDisplay.GetRects(mVisibleRegion.size());
+    if (!mStateDirty && hwc1VisibleRegion.rects == rects &&
+            hwc1VisibleRegion.numRects == mVisibleRegion.size()) {
+        return;
+    }
     hwc1VisibleRegion.numRects = mVisibleRegion.size();
-    hwc_rect_t* rects = mDisplay.GetRects(hwc1VisibleRegion.numRects);
     hwc1VisibleRegion.rects = rects;
     for (size_t i = 0; i < mVisibleRegion.size(); i++) {
         rects[i] = mVisibleRegion[i];
@@ -2273,7 +2380,7 @@ void HWC2On1Adapter::populateCapabilities() {
 }
 
 HWC2On1Adapter::Display* HWC2On1Adapter::getDisplay(hwc2_display_t id) {
-    std::unique_lock<std::recursive_timed_mutex> lock(mStateMutex);
+    TrackedLock<std::mutex> lock(mDisplaysMutex, mDisplaysLockStats);
 
     auto display = mDisplays.find(id);
     if (display == mDisplays.end()) {
@@ -2290,12 +2397,11 @@ std::tuple<HWC2On1Adapter::Layer*, Error> HWC2On1Adapter::getLayer(
         return std::make_tuple(static_cast<Layer*>(nullptr), Error::BadDisplay);
     }
 
-    auto layerEntry = mLayers.find(layerId);
-    if (layerEntry == mLayers.end()) {
+    auto layer = findLayer(layerId);
+    if (!layer) {
         return std::make_tuple(static_cast<Layer*>(nullptr), Error::BadLayer);
     }
 
-    auto layer = layerEntry->second;
     if (layer->getDisplay().getId() != displayId) {
         return std::make_tuple(static_cast<Layer*>(nullptr), Error::BadLayer);
     }
@@ -2303,60 +2409,125 @@ std::tuple<HWC2On1Adapter::Layer*, Error> HWC2On1Adapter::getLayer(
 }
 
 void HWC2On1Adapter::populatePrimary() {
-    std::unique_lock<std::recursive_timed_mutex> lock(mStateMutex);
-
     auto display = std::make_shared<Display>(*this, HWC2::DisplayType::Physical);
-    mHwc1DisplayMap[HWC_DISPLAY_PRIMARY] = display->getId();
     display->setHwc1Id(HWC_DISPLAY_PRIMARY);
     display->populateConfigs();
+
+    TrackedLock<std::mutex> lock(mDisplaysMutex, mDisplaysLockStats);
+    mHwc1DisplayMap[HWC_DISPLAY_PRIMARY] = display->getId();
     mDisplays.emplace(display->getId(), std::move(display));
 }
 
+std::vector<hwc2_display_t> HWC2On1Adapter::getDisplayIds() {
+    TrackedLock<std::mutex> lock(mDisplaysMutex, mDisplaysLockStats);
+
+    std::vector<hwc2_display_t> displayIds;
+    displayIds.reserve(mDisplays.size());
+    for (const auto& displayPair : mDisplays) {
+        displayIds.emplace_back(displayPair.first);
+    }
+    return displayIds;
+}
+
+bool HWC2On1Adapter::getDisplayIdForHwc1Id(int hwc1DisplayId,
+        hwc2_display_t* outId) {
+    TrackedLock<std::mutex> lock(mDisplaysMutex, mDisplaysLockStats);
+
+    auto entry = mHwc1DisplayMap.find(hwc1DisplayId);
+    if (entry == mHwc1DisplayMap.end()) {
+        return false;
+    }
+    *outId = entry->second;
+    return true;
+}
+
+std::shared_ptr<HWC2On1Adapter::Display>
+        HWC2On1Adapter::getDisplayForHwc1IdLocked(int hwc1DisplayId) {
+    auto entry = mHwc1DisplayMap.find(hwc1DisplayId);
+    if (entry == mHwc1DisplayMap.end()) {
+        return nullptr;
+    }
+    auto display = mDisplays.find(entry->second);
+    if (display == mDisplays.end()) {
+        return nullptr;
+    }
+    return display->second;
+}
+
+void HWC2On1Adapter::addLayer(const std::shared_ptr<Layer>& layer) {
+    TrackedLock<std::mutex> lock(mLayersMutex, mLayersLockStats);
+    mLayers.emplace(layer->getId(), layer);
+}
+
+std::shared_ptr<HWC2On1Adapter::Layer> HWC2On1Adapter::findLayer(
+        hwc2_layer_t layerId) {
+    TrackedLock<std::mutex> lock(mLayersMutex, mLayersLockStats);
+
+    auto layer = mLayers.find(layerId);
+    if (layer == mLayers.end()) {
+        return nullptr;
+    }
+    return layer->second;
+}
+
+std::shared_ptr<HWC2On1Adapter::Layer> HWC2On1Adapter::removeLayer(
+        hwc2_layer_t layerId) {
+    TrackedLock<std::mutex> lock(mLayersMutex, mLayersLockStats);
+
+    auto layer = mLayers.find(layerId);
+    if (layer == mLayers.end()) {
+        return nullptr;
+    }
+    auto removed = std::move(layer->second);
+    mLayers.erase(layer);
+    return removed;
+}
+
 bool HWC2On1Adapter::prepareAllDisplays() {
     ATRACE_CALL();
 
-    std::unique_lock<std::recursive_timed_mutex> lock(mStateMutex);
+    TrackedLock<std::mutex> lock(mHwc1Mutex, mHwc1LockStats);
 
-    for (const auto& displayPair : mDisplays) {
-        auto& display = displayPair.second;
+    // Take references to the displays, so that they can be prepared without
+    // holding mDisplaysMutex for the duration of the HWC1 frame
+    std::vector<std::shared_ptr<Display>> displays;
+    mHwc1ContentsDisplays.clear();
+    {
+        TrackedLock<std::mutex> displaysLock(mDisplaysMutex,
+                mDisplaysLockStats);
+        for (const auto& displayPair : mDisplays) {
+            displays.emplace_back(displayPair.second);
+        }
+
+        // Always push the primary display. Even if an external display isn't
+        // present, we still need to send at least two displays down to HWC1.
+        // Push the hardware virtual display slot if supported.
+        mHwc1ContentsDisplays.push_back(
+                getDisplayForHwc1IdLocked(HWC_DISPLAY_PRIMARY));
+        mHwc1ContentsDisplays.push_back(
+                getDisplayForHwc1IdLocked(HWC_DISPLAY_EXTERNAL));
+        if (mHwc1MinorVersion >= 3) {
+            mHwc1ContentsDisplays.push_back(
+                    getDisplayForHwc1IdLocked(HWC_DISPLAY_VIRTUAL));
+        }
+    }
+
+    for (const auto& display : displays) {
         if (!display->prepare()) {
             return false;
         }
     }
 
-    if (mHwc1DisplayMap.count(HWC_DISPLAY_PRIMARY) == 0) {
+    if (!mHwc1ContentsDisplays[HWC_DISPLAY_PRIMARY]) {
         ALOGE("prepareAllDisplays: Unable to find primary HWC1 display");
         return false;
     }
 
     // Build an array of hwc_display_contents_1 to call prepare() on HWC1.
     mHwc1Contents.clear();
-
-    // Always push the primary display
-    auto primaryDisplayId = mHwc1DisplayMap[HWC_DISPLAY_PRIMARY];
-    auto& primaryDisplay = mDisplays[primaryDisplayId];
-    mHwc1Contents.push_back(primaryDisplay->getDisplayContents());
-
-    // Push the external display, if present
-    if (mHwc1DisplayMap.count(HWC_DISPLAY_EXTERNAL) != 0) {
-        auto externalDisplayId = mHwc1DisplayMap[HWC_DISPLAY_EXTERNAL];
-        auto& externalDisplay = mDisplays[externalDisplayId];
-        mHwc1Contents.push_back(externalDisplay->getDisplayContents());
-    } else {
-        // Even if an external display isn't present, we still need to send
-        // at least two displays down to HWC1
-        mHwc1Contents.push_back(nullptr);
-    }
-
-    // Push the hardware virtual display, if supported and present
-    if (mHwc1MinorVersion >= 3) {
-        if (mHwc1DisplayMap.count(HWC_DISPLAY_VIRTUAL) != 0) {
-            auto virtualDisplayId = mHwc1DisplayMap[HWC_DISPLAY_VIRTUAL];
-            auto& virtualDisplay = mDisplays[virtualDisplayId];
-            mHwc1Contents.push_back(virtualDisplay->getDisplayContents());
-        } else {
-            mHwc1Contents.push_back(nullptr);
-        }
+    for (const auto& display : mHwc1ContentsDisplays) {
+        mHwc1Contents.push_back(display ? display->getDisplayContents() :
+                nullptr);
     }
 
     for (auto& displayContents : mHwc1Contents) {
@@ -2395,9 +2566,7 @@ bool HWC2On1Adapter::prepareAllDisplays() {
             continue;
         }
 
-        auto displayId = mHwc1DisplayMap[hwc1Id];
-        auto& display = mDisplays[displayId];
-        display->generateChanges();
+        mHwc1ContentsDisplays[hwc1Id]->generateChanges();
     }
 
     return true;
@@ -2483,7 +2652,7 @@ void dumpHWC1Message(hwc_composer_device_1* device, size_t numDisplays,
 Error HWC2On1Adapter::setAllDisplays() {
     ATRACE_CALL();
 
-    std::unique_lock<std::recursive_timed_mutex> lock(mStateMutex);
+    TrackedLock<std::mutex> lock(mHwc1Mutex, mHwc1LockStats);
 
     // Make sure we're ready to validate
     for (size_t hwc1Id = 0; hwc1Id < mHwc1Contents.size(); ++hwc1Id) {
@@ -2491,8 +2660,7 @@ Error HWC2On1Adapter::setAllDisplays() {
             continue;
         }
 
-        auto displayId = mHwc1DisplayMap[hwc1Id];
-        auto& display = mDisplays[displayId];
+        auto& display = mHwc1ContentsDisplays[hwc1Id];
         Error error = display->set(*mHwc1Contents[hwc1Id]);
         if (error != Error::None) {
             ALOGE("setAllDisplays: Failed to set display %zd: %s", hwc1Id,
@@ -2515,8 +2683,7 @@ Error HWC2On1Adapter::setAllDisplays() {
             continue;
         }
 
-        auto displayId = mHwc1DisplayMap[hwc1Id];
-        auto& display = mDisplays[displayId];
+        auto& display = mHwc1ContentsDisplays[hwc1Id];
         auto retireFenceFd = mHwc1Contents[hwc1Id]->retireFenceFd;
         ALOGV("setAllDisplays: Adding retire fence %d to display %zd",
                 retireFenceFd, hwc1Id);
@@ -2530,7 +2697,7 @@ Error HWC2On1Adapter::setAllDisplays() {
 void HWC2On1Adapter::hwc1Invalidate() {
     ALOGV("Received hwc1Invalidate");
 
-    std::unique_lock<std::recursive_timed_mutex> lock(mStateMutex);
+    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
     // If the HWC2-side callback hasn't been registered yet, buffer this until
     // it is registered.
@@ -2540,10 +2707,7 @@ void HWC2On1Adapter::hwc1Invalidate() {
     }
 
     const auto& callbackInfo = mCallbacks[Callback::Refresh];
-    std::vector<hwc2_display_t> displays;
-    for (const auto& displayPair : mDisplays) {
-        displays.emplace_back(displayPair.first);
-    }
+    auto displays = getDisplayIds();
 
     // Call back without the state lock held.
     lock.unlock();
@@ -2557,7 +2721,7 @@ void HWC2On1Adapter::hwc1Invalidate() {
 void HWC2On1Adapter::hwc1Vsync(int hwc1DisplayId, int64_t timestamp) {
     ALOGV("Received hwc1Vsync(%d, %" PRId64 ")", hwc1DisplayId, timestamp);
 
-    std::unique_lock<std::recursive_timed_mutex> lock(mStateMutex);
+    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
     // If the HWC2-side callback hasn't been registered yet, buffer this until
     // it is registered.
@@ -2566,13 +2730,13 @@ void HWC2On1Adapter::hwc1Vsync(int hwc1DisplayId, int64_t timestamp) {
         return;
     }
 
-    if (mHwc1DisplayMap.count(hwc1DisplayId) == 0) {
+    hwc2_display_t displayId = 0;
+    if (!getDisplayIdForHwc1Id(hwc1DisplayId, &displayId)) {
         ALOGE("hwc1Vsync: Couldn't find display for HWC1 id %d", hwc1DisplayId);
         return;
     }
 
     const auto& callbackInfo = mCallbacks[Callback::Vsync];
-    auto displayId = mHwc1DisplayMap[hwc1DisplayId];
 
     // Call back without the state lock held.
     lock.unlock();
@@ -2589,7 +2753,7 @@ void HWC2On1Adapter::hwc1Hotplug(int hwc1DisplayId, int connected) {
         return;
     }
 
-    std::unique_lock<std::recursive_timed_mutex> lock(mStateMutex);
+    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
     // If the HWC2-side callback hasn't been registered yet, buffer this until
     // it is registered
@@ -2599,18 +2763,23 @@ void HWC2On1Adapter::hwc1Hotplug(int hwc1DisplayId, int connected) {
     }
 
     hwc2_display_t displayId = UINT64_MAX;
-    if (mHwc1DisplayMap.count(hwc1DisplayId) == 0) {
+    bool isConnected = getDisplayIdForHwc1Id(hwc1DisplayId, &displayId);
+    if (!isConnected) {
         if (connected == 0) {
             ALOGW("hwc1Hotplug: Received disconnect for unconnected display");
             return;
         }
 
-        // Create a new display on connect
+        // Create a new display on connect. Its configs are populated before
+        // taking mDisplaysMutex, since that locks the display.
         auto display = std::make_shared<HWC2On1Adapter::Display>(*this,
                 HWC2::DisplayType::Physical);
         display->setHwc1Id(HWC_DISPLAY_EXTERNAL);
         display->populateConfigs();
         displayId = display->getId();
+
+        TrackedLock<std::mutex> displaysLock(mDisplaysMutex,
+                mDisplaysLockStats);
         mHwc1DisplayMap[HWC_DISPLAY_EXTERNAL] = displayId;
         mDisplays.emplace(displayId, std::move(display));
     } else {
@@ -2620,8 +2789,10 @@ void HWC2On1Adapter::hwc1Hotplug(int hwc1DisplayId, int connected) {
             return;
         }
 
-        // Disconnect an existing display
-        displayId = mHwc1DisplayMap[hwc1DisplayId];
+        // Disconnect an existing display. A frame in progress keeps its own
+        // reference to it.
+        TrackedLock<std::mutex> displaysLock(mDisplaysMutex,
+                mDisplaysLockStats);
         mHwc1DisplayMap.erase(HWC_DISPLAY_EXTERNAL);
         mDisplays.erase(displayId);
     }
@@ -26,10 +26,13 @@
 #include "MiniFence.h"
 
 #include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <map>
 #include <mutex>
 #include <queue>
 #include <set>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -186,6 +189,96 @@ private:
             sp<MiniFence> mFence;
     };
 
+    template <typename Mutex> class TrackedLock;
+
+    // Wait and hold time statistics of one of the adapter's mutexes, updated
+    // by TrackedLock and reported by dump().
+    class LockStats {
+        public:
+            LockStats()
+              : mAcquisitions(0),
+                mContended(0),
+                mTotalWaitNs(0),
+                mMaxWaitNs(0),
+                mTotalHoldNs(0),
+                mMaxHoldNs(0),
+                mDepth(0),
+                mHoldStart() {}
+
+            std::string dump() const;
+
+        private:
+            template <typename Mutex> friend class TrackedLock;
+
+            void recordWait(int64_t waitNs, bool contended);
+            void recordHold(int64_t holdNs);
+
+            std::atomic<uint64_t> mAcquisitions;
+            std::atomic<uint64_t> mContended;
+            std::atomic<int64_t> mTotalWaitNs;
+            std::atomic<int64_t> mMaxWaitNs;
+            std::atomic<int64_t> mTotalHoldNs;
+            std::atomic<int64_t> mMaxHoldNs;
+
+            // Nesting depth of a recursive mutex and the time its outermost
+            // lock was taken. Only accessed with the mutex held.
+            uint32_t mDepth;
+            std::chrono::steady_clock::time_point mHoldStart;
+    };
+
+    // Locks a mutex for its lifetime like std::unique_lock, and records in
+    // a LockStats how long the lock was waited for and held. Only the
+    // outermost lock of a recursive mutex is accounted for.
+    template <typename Mutex>
+    class TrackedLock {
+        public:
+            TrackedLock(Mutex& mutex, LockStats& stats)
+              : mMutex(mutex), mStats(stats), mOwnsLock(false) {
+                lock();
+            }
+
+            ~TrackedLock() {
+                if (mOwnsLock) {
+                    unlock();
+                }
+            }
+
+            TrackedLock(const TrackedLock&) = delete;
+            TrackedLock& operator=(const TrackedLock&) = delete;
+
+            void lock() {
+                auto start = std::chrono::steady_clock::now();
+                bool contended = !mMutex.try_lock();
+                if (contended) {
+                    mMutex.lock();
+                }
+                mOwnsLock = true;
+                if (mStats.mDepth++ == 0) {
+                    mStats.mHoldStart = std::chrono::steady_clock::now();
+                    mStats.recordWait(std::chrono::duration_cast<
+                            std::chrono::nanoseconds>(
+                                    mStats.mHoldStart - start).count(),
+                            contended);
+                }
+            }
+
+            void unlock() {
+                if (--mStats.mDepth == 0) {
+                    mStats.recordHold(std::chrono::duration_cast<
+                            std::chrono::nanoseconds>(
+                                    std::chrono::steady_clock::now() -
+                                    mStats.mHoldStart).count());
+                }
+                mOwnsLock = false;
+                mMutex.unlock();
+            }
+
+        private:
+            Mutex& mMutex;
+            LockStats& mStats;
+            bool mOwnsLock;
+    };
+
     class Display {
         public:
             Display(HWC2On1Adapter& device, HWC2::DisplayType type);
@@ -406,16 +499,35 @@ private:
             // (or present) when we call HWC2On1Adapter::prepareAllDisplays
             // (or setAllDisplays), which calls back into Display functions
             // which require locking.
+            //
+            // Each Display has its own mutex so that calls for one display
+            // don't wait for another one, except for the HWC1 prepare and set
+            // calls which cover all displays at once.
             mutable std::recursive_mutex mStateMutex;
+            mutable LockStats mStateLockStats;
 
             // Allocate RAM able to store all layers and rects used for
             // communication with HWC1. Place allocated RAM in variable
-            // mHwc1RequestedContents.
+            // mHwc1RequestedContents. The allocation is kept from frame to
+            // frame and only replaced when it is too small for the layers and
+            // rects of the current frame.
             void allocateRequestedContents();
 
+            struct ContentsDeleter {
+                void operator()(hwc_display_contents_1* contents) const {
+                    std::free(contents);
+                }
+            };
+
             // Array of structs exchanged between client and hwc1 device.
             // Sent to device upon calling prepare().
-            std::unique_ptr<hwc_display_contents_1> mHwc1RequestedContents;
+            std::unique_ptr<hwc_display_contents_1, ContentsDeleter>
+                    mHwc1RequestedContents;
+
+            // Size in bytes of mHwc1RequestedContents, and how many times it
+            // had to be (re)allocated.
+            size_t mHwc1RequestedContentsCapacity;
+            size_t mNumContentsAllocations;
     private:
             DeferredFence mRetireFence;
 
@@ -557,10 +669,22 @@ private:
             void addReleaseFence(int fenceFd);
             const sp<MiniFence>& getReleaseFence() const;
 
-            void setHwc1Id(size_t id) { mHwc1Id = id; }
+            void setHwc1Id(size_t id) {
+                if (id != mHwc1Id) {
+                    mHwc1Id = id;
+                    mStateDirty = true;
+                }
+            }
             size_t getHwc1Id() const { return mHwc1Id; }
 
-            // Write state to HWC1 communication struct.
+            // Forces the next applyState() to rewrite all fields, e.g. because
+            // the HWC1 communication struct was reallocated.
+            void markStateDirty() { mStateDirty = true; }
+
+            // Write state to HWC1 communication struct. Fields that only
+            // change with the layer geometry are written again only if the
+            // layer was modified, moved to another HWC1 slot or marked dirty
+            // since the last call.
             void applyState(struct hwc_layer_1& hwc1Layer);
 
             std::string dump() const;
@@ -577,6 +701,7 @@ private:
             }
         private:
             void applyCommonState(struct hwc_layer_1& hwc1Layer);
+            void applyVisibleRegion(struct hwc_layer_1& hwc1Layer);
             void applySolidColorState(struct hwc_layer_1& hwc1Layer);
             void applySidebandState(struct hwc_layer_1& hwc1Layer);
             void applyBufferState(struct hwc_layer_1& hwc1Layer);
@@ -605,6 +730,10 @@ private:
 
             size_t mHwc1Id;
             bool mHasUnsupportedPlaneAlpha;
+
+            // True if any state other than the buffer changed since the last
+            // applyState().
+            bool mStateDirty;
     };
 
     // Utility tempate calling a Layer object method based on ID parameters:
@@ -675,10 +804,28 @@ private:
             hwc2_layer_t layerId);
     void populatePrimary();
 
+    // Access to the display maps, which require mDisplaysMutex.
+    std::vector<hwc2_display_t> getDisplayIds();
+    bool getDisplayIdForHwc1Id(int hwc1DisplayId, hwc2_display_t* outId);
+    std::shared_ptr<Display> getDisplayForHwc1IdLocked(int hwc1DisplayId);
+
+    // Access to the layer index, which requires mLayersMutex.
+    void addLayer(const std::shared_ptr<Layer>& layer);
+    std::shared_ptr<Layer> findLayer(hwc2_layer_t layerId);
+    std::shared_ptr<Layer> removeLayer(hwc2_layer_t layerId);
+
     bool prepareAllDisplays();
-    std::vector<struct hwc_display_contents_1*> mHwc1Contents;
     HWC2::Error setAllDisplays();
 
+    // Serializes the HWC1 prepare and set calls, which cover all displays,
+    // and protects the arrays passed to them. mHwc1ContentsDisplays holds the
+    // Display each entry of mHwc1Contents belongs to, so that a display that
+    // is disconnected mid-frame stays valid until the frame is set.
+    std::mutex mHwc1Mutex;
+    LockStats mHwc1LockStats;
+    std::vector<struct hwc_display_contents_1*> mHwc1Contents;
+    std::vector<std::shared_ptr<Display>> mHwc1ContentsDisplays;
+
     // Callbacks
     void hwc1Invalidate();
     void hwc1Vsync(int hwc1DisplayId, int64_t timestamp);
@@ -697,19 +844,18 @@ private:
 
     std::unordered_set<HWC2::Capability> mCapabilities;
 
-    // These are only accessed from the main SurfaceFlinger thread (not from
-    // callbacks or dump
-
-    std::map<hwc2_layer_t, std::shared_ptr<Layer>> mLayers;
-
-    // A HWC1 supports only one virtual display.
-    std::shared_ptr<Display> mHwc1VirtualDisplay;
+    // Index of the layers of all displays, looked up on every layer call.
+    // Guarded by its own mutex so that layer calls for different displays
+    // only contend for the duration of a hash lookup.
+    std::mutex mLayersMutex;
+    LockStats mLayersLockStats;
+    std::unordered_map<hwc2_layer_t, std::shared_ptr<Layer>> mLayers;
 
-    // These are potentially accessed from multiple threads, and are protected
-    // by this mutex. This needs to be recursive, since the HWC1 implementation
-    // can call back into the invalidate callback on the same thread that is
-    // calling prepare.
-    std::recursive_timed_mutex mStateMutex;
+    // The callbacks and pending events are potentially accessed from multiple
+    // threads, and are protected by this mutex. This needs to be recursive,
+    // since the HWC1 implementation can call back into the invalidate callback
+    // on the same thread that is calling prepare.
+    std::recursive_mutex mStateMutex;
 
     struct CallbackInfo {
         hwc2_callback_data_t data;
@@ -725,12 +871,21 @@ private:
     std::vector<std::pair<int, int64_t>> mPendingVsyncs;
     std::vector<std::pair<int, int>> mPendingHotplugs;
 
+    // The display maps are guarded by their own mutex, which is never held
+    // while calling into a Display or HWC1, so that looking up a display
+    // doesn't wait for another display's frame.
+    std::mutex mDisplaysMutex;
+    LockStats mDisplaysLockStats;
+
     // Mapping between HWC1 display id and Display objects.
     std::map<hwc2_display_t, std::shared_ptr<Display>> mDisplays;
 
     // Map HWC1 display type (HWC_DISPLAY_PRIMARY, HWC_DISPLAY_EXTERNAL,
     // HWC_DISPLAY_VIRTUAL) to Display IDs generated by HWC2on1Adapter objects.
     std::unordered_map<int, hwc2_display_t> mHwc1DisplayMap;
+
+    // A HWC1 supports only one virtual display.
+    std::shared_ptr<Display> mHwc1VirtualDisplay;
 };
 
 } // namespace android
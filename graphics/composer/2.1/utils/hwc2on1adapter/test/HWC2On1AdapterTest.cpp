@@ -0,0 +1,589 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hwc2on1adapter/HWC2On1Adapter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <hardware/hwcomposer.h>
+
+using HWC2::BlendMode;
+using HWC2::Composition;
+using HWC2::Error;
+using HWC2::FunctionDescriptor;
+using HWC2::Transform;
+
+namespace android {
+namespace {
+
+constexpr int32_t kWidth = 1080;
+constexpr int32_t kHeight = 1920;
+
+// A HWC1 1.5 device with a single primary display. It records what it is
+// asked to prepare, then composes every layer that isn't skipped as an overlay
+// and sets hints, like a real device would.
+class FakeHwc1Device : public hwc_composer_device_1_t {
+public:
+    FakeHwc1Device() {
+        hwc_composer_device_1_t* device = this;
+        memset(device, 0, sizeof(*device));
+        common.tag = HARDWARE_DEVICE_TAG;
+        common.version = HWC_DEVICE_API_VERSION_1_5;
+        common.close = closeHook;
+        prepare = prepareHook;
+        set = setHook;
+        eventControl = eventControlHook;
+        setPowerMode = setPowerModeHook;
+        query = queryHook;
+        registerProcs = registerProcsHook;
+        getDisplayConfigs = getDisplayConfigsHook;
+        getDisplayAttributes = getDisplayAttributesHook;
+        getActiveConfig = getActiveConfigHook;
+        setActiveConfig = setActiveConfigHook;
+    }
+
+    // Deep copy of the primary display contents as received by prepare().
+    struct PreparedLayer {
+        hwc_layer_1_t layer;
+        std::vector<hwc_rect_t> visibleRegion;
+        bool rectsInContents;
+    };
+    std::vector<PreparedLayer> preparedLayers;
+
+private:
+    static FakeHwc1Device* getDevice(hwc_composer_device_1* device) {
+        return static_cast<FakeHwc1Device*>(device);
+    }
+
+    static int closeHook(hw_device_t*) { return 0; }
+
+    static int prepareHook(hwc_composer_device_1* device, size_t numDisplays,
+                           hwc_display_contents_1_t** displays) {
+        auto fake = getDevice(device);
+        if (numDisplays == 0 || displays[HWC_DISPLAY_PRIMARY] == nullptr) {
+            return -1;
+        }
+
+        auto contents = displays[HWC_DISPLAY_PRIMARY];
+        auto rectsStart = reinterpret_cast<const char*>(&contents->hwLayers[contents->numHwLayers]);
+        fake->preparedLayers.clear();
+        for (size_t i = 0; i < contents->numHwLayers; i++) {
+            auto& layer = contents->hwLayers[i];
+            const auto& region = layer.visibleRegionScreen;
+            PreparedLayer prepared;
+            prepared.layer = layer;
+            prepared.visibleRegion.assign(region.rects, region.rects + region.numRects);
+            prepared.rectsInContents = region.numRects == 0 ||
+                    reinterpret_cast<const char*>(region.rects) >= rectsStart;
+            fake->preparedLayers.push_back(prepared);
+
+            if (layer.compositionType == HWC_FRAMEBUFFER && !(layer.flags & HWC_SKIP_LAYER)) {
+                layer.compositionType = HWC_OVERLAY;
+            }
+            if (layer.compositionType != HWC_FRAMEBUFFER_TARGET) {
+                layer.hints = HWC_HINT_TRIPLE_BUFFER;
+            }
+        }
+        return 0;
+    }
+
+    static int setHook(hwc_composer_device_1*, size_t numDisplays,
+                       hwc_display_contents_1_t** displays) {
+        for (size_t d = 0; d < numDisplays; d++) {
+            if (displays[d] == nullptr) {
+                continue;
+            }
+            displays[d]->retireFenceFd = -1;
+            for (size_t i = 0; i < displays[d]->numHwLayers; i++) {
+                displays[d]->hwLayers[i].releaseFenceFd = -1;
+            }
+        }
+        return 0;
+    }
+
+    static int eventControlHook(hwc_composer_device_1*, int, int, int) { return 0; }
+    static int setPowerModeHook(hwc_composer_device_1*, int, int) { return 0; }
+
+    static int queryHook(hwc_composer_device_1*, int what, int* value) {
+        switch (what) {
+            case HWC_BACKGROUND_LAYER_SUPPORTED: *value = 1; return 0;
+            case HWC_DISPLAY_TYPES_SUPPORTED: *value = 1 << HWC_DISPLAY_PRIMARY; return 0;
+            default: return -1;
+        }
+    }
+
+    static void registerProcsHook(hwc_composer_device_1*, hwc_procs_t const*) {}
+
+    static int getDisplayConfigsHook(hwc_composer_device_1*, int disp, uint32_t* configs,
+                                     size_t* numConfigs) {
+        if (disp != HWC_DISPLAY_PRIMARY || *numConfigs < 1) {
+            return -1;
+        }
+        configs[0] = 0;
+        *numConfigs = 1;
+        return 0;
+    }
+
+    static int getDisplayAttributesHook(hwc_composer_device_1*, int, uint32_t,
+                                        const uint32_t* attributes, int32_t* values) {
+        for (size_t i = 0; attributes[i] != HWC_DISPLAY_NO_ATTRIBUTE; i++) {
+            switch (attributes[i]) {
+                case HWC_DISPLAY_VSYNC_PERIOD: values[i] = 16666666; break;
+                case HWC_DISPLAY_WIDTH: values[i] = kWidth; break;
+                case HWC_DISPLAY_HEIGHT: values[i] = kHeight; break;
+                case HWC_DISPLAY_DPI_X: values[i] = 320000; break;
+                case HWC_DISPLAY_DPI_Y: values[i] = 320000; break;
+                default: values[i] = 0; break;
+            }
+        }
+        return 0;
+    }
+
+    static int getActiveConfigHook(hwc_composer_device_1*, int) { return 0; }
+    static int setActiveConfigHook(hwc_composer_device_1*, int, int) { return 0; }
+};
+
+// What SurfaceFlinger last told the adapter about a layer.
+struct LayerState {
+    hwc2_layer_t id;
+    uint32_t z;
+    Composition composition;
+    BlendMode blendMode;
+    hwc_color_t color;
+    hwc_rect_t displayFrame;
+    float planeAlpha;
+    hwc_frect_t sourceCrop;
+    Transform transform;
+    std::vector<hwc_rect_t> visibleRegion;
+    buffer_handle_t buffer;
+};
+
+// Drives the adapter through the HWC2 function table, frame by frame, and
+// checks after every validate that the HWC1 contents match the layers,
+// whatever was kept from the previous frames.
+class HWC2On1AdapterTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mAdapter = std::make_unique<HWC2On1Adapter>(&mHwc1Device);
+        mDevice = mAdapter.get();
+
+        auto registerCallback = getFunction<HWC2_PFN_REGISTER_CALLBACK>(
+                FunctionDescriptor::RegisterCallback);
+        ASSERT_EQ(0, registerCallback(mDevice, static_cast<int32_t>(HWC2::Callback::Hotplug), this,
+                                      reinterpret_cast<hwc2_function_pointer_t>(hotplugHook)));
+        ASSERT_TRUE(mHasDisplay);
+    }
+
+    template <typename PFN>
+    PFN getFunction(FunctionDescriptor descriptor) {
+        auto function = reinterpret_cast<PFN>(
+                mDevice->getFunction(mDevice, static_cast<int32_t>(descriptor)));
+        EXPECT_NE(nullptr, function);
+        return function;
+    }
+
+    static void hotplugHook(hwc2_callback_data_t data, hwc2_display_t display, int32_t) {
+        auto test = static_cast<HWC2On1AdapterTest*>(data);
+        test->mDisplay = display;
+        test->mHasDisplay = true;
+    }
+
+    // Adds a layer at z with distinct geometry, and returns its index in mLayers.
+    size_t createLayer(uint32_t z, Composition composition) {
+        LayerState layer{};
+        EXPECT_EQ(0, getFunction<HWC2_PFN_CREATE_LAYER>(FunctionDescriptor::CreateLayer)(
+                             mDevice, mDisplay, &layer.id));
+        layer.z = z;
+        mLayers.push_back(layer);
+        size_t index = mLayers.size() - 1;
+        setZ(index, z);
+        setComposition(index, composition);
+        setGeometry(index, static_cast<int32_t>(layer.id));
+        setColor(index, static_cast<uint8_t>(layer.id));
+        setVisibleRegion(index, 1 + layer.id % 3);
+        return index;
+    }
+
+    void destroyLayer(size_t index) {
+        EXPECT_EQ(0, getFunction<HWC2_PFN_DESTROY_LAYER>(FunctionDescriptor::DestroyLayer)(
+                             mDevice, mDisplay, mLayers[index].id));
+        mLayers.erase(mLayers.begin() + index);
+    }
+
+    void setZ(size_t index, uint32_t z) {
+        auto& layer = mLayers[index];
+        EXPECT_EQ(0, getFunction<HWC2_PFN_SET_LAYER_Z_ORDER>(FunctionDescriptor::SetLayerZOrder)(
+                             mDevice, mDisplay, layer.id, z));
+        layer.z = z;
+    }
+
+    void setComposition(size_t index, Composition composition) {
+        auto& layer = mLayers[index];
+        EXPECT_EQ(0, getFunction<HWC2_PFN_SET_LAYER_COMPOSITION_TYPE>(
+                             FunctionDescriptor::SetLayerCompositionType)(
+                             mDevice, mDisplay, layer.id, static_cast<int32_t>(composition)));
+        layer.composition = composition;
+    }
+
+    // Sets the blend mode, frame, plane alpha, crop and transform to values
+    // derived from seed.
+    void setGeometry(size_t index, int32_t seed) {
+        auto& layer = mLayers[index];
+        layer.blendMode = static_cast<BlendMode>(1 + seed % 3);
+        layer.displayFrame = {seed % 100, seed % 200, kWidth - seed % 50, kHeight - seed % 70};
+        layer.planeAlpha = static_cast<float>(128 + seed % 128) / 255.0f;
+        layer.sourceCrop = {0.5f * (seed % 10), 0.25f * (seed % 20), 640.0f + seed % 30,
+                            480.0f + seed % 40};
+        layer.transform = (seed % 2) ? Transform::Rotate90 : Transform::None;
+
+        EXPECT_EQ(0, getFunction<HWC2_PFN_SET_LAYER_BLEND_MODE>(
+                             FunctionDescriptor::SetLayerBlendMode)(
+                             mDevice, mDisplay, layer.id, static_cast<int32_t>(layer.blendMode)));
+        EXPECT_EQ(0, getFunction<HWC2_PFN_SET_LAYER_DISPLAY_FRAME>(
+                             FunctionDescriptor::SetLayerDisplayFrame)(mDevice, mDisplay, layer.id,
+                                                                       layer.displayFrame));
+        EXPECT_EQ(0, getFunction<HWC2_PFN_SET_LAYER_PLANE_ALPHA>(
+                             FunctionDescriptor::SetLayerPlaneAlpha)(mDevice, mDisplay, layer.id,
+                                                                     layer.planeAlpha));
+        EXPECT_EQ(0, getFunction<HWC2_PFN_SET_LAYER_SOURCE_CROP>(
+                             FunctionDescriptor::SetLayerSourceCrop)(mDevice, mDisplay, layer.id,
+                                                                     layer.sourceCrop));
+        EXPECT_EQ(0, getFunction<HWC2_PFN_SET_LAYER_TRANSFORM>(
+                             FunctionDescriptor::SetLayerTransform)(
+                             mDevice, mDisplay, layer.id, static_cast<int32_t>(layer.transform)));
+    }
+
+    void setColor(size_t index, uint8_t seed) {
+        auto& layer = mLayers[index];
+        layer.color = {seed, static_cast<uint8_t>(seed + 1), static_cast<uint8_t>(seed + 2), 255};
+        EXPECT_EQ(0, getFunction<HWC2_PFN_SET_LAYER_COLOR>(FunctionDescriptor::SetLayerColor)(
+                             mDevice, mDisplay, layer.id, layer.color));
+    }
+
+    void setVisibleRegion(size_t index, size_t numRects) {
+        auto& layer = mLayers[index];
+        layer.visibleRegion.clear();
+        for (size_t i = 0; i < numRects; i++) {
+            int32_t offset = static_cast<int32_t>(layer.id * 10 + i + mFrame % 7);
+            layer.visibleRegion.push_back({offset, offset, offset + 100, offset + 100});
+        }
+        hwc_region_t region{layer.visibleRegion.size(), layer.visibleRegion.data()};
+        EXPECT_EQ(0, getFunction<HWC2_PFN_SET_LAYER_VISIBLE_REGION>(
+                             FunctionDescriptor::SetLayerVisibleRegion)(mDevice, mDisplay,
+                                                                        layer.id, region));
+    }
+
+    // Runs one validate/present cycle, posting a new buffer on every layer
+    // that has one, and checks what HWC1 was asked to prepare.
+    void presentFrame() {
+        mFrame++;
+        for (auto& layer : mLayers) {
+            if (layer.composition == Composition::SolidColor) {
+                continue;
+            }
+            layer.buffer = reinterpret_cast<buffer_handle_t>(
+                    static_cast<uintptr_t>(0x10000 + mFrame * 0x100 + layer.id));
+            EXPECT_EQ(0, getFunction<HWC2_PFN_SET_LAYER_BUFFER>(FunctionDescriptor::SetLayerBuffer)(
+                                 mDevice, mDisplay, layer.id, layer.buffer, -1));
+        }
+
+        uint32_t numTypes = 0;
+        uint32_t numRequests = 0;
+        auto error = static_cast<Error>(
+                getFunction<HWC2_PFN_VALIDATE_DISPLAY>(FunctionDescriptor::ValidateDisplay)(
+                        mDevice, mDisplay, &numTypes, &numRequests));
+        ASSERT_TRUE(error == Error::None || error == Error::HasChanges);
+
+        expectPreparedContents();
+
+        if (error == Error::HasChanges) {
+            acceptChanges(numTypes);
+        }
+
+        int32_t retireFence = -1;
+        ASSERT_EQ(0, getFunction<HWC2_PFN_PRESENT_DISPLAY>(FunctionDescriptor::PresentDisplay)(
+                             mDevice, mDisplay, &retireFence));
+        if (retireFence >= 0) {
+            close(retireFence);
+        }
+    }
+
+    void acceptChanges(uint32_t numTypes) {
+        std::vector<hwc2_layer_t> layers(numTypes);
+        std::vector<int32_t> types(numTypes);
+        ASSERT_EQ(0, getFunction<HWC2_PFN_GET_CHANGED_COMPOSITION_TYPES>(
+                             FunctionDescriptor::GetChangedCompositionTypes)(
+                             mDevice, mDisplay, &numTypes, layers.data(), types.data()));
+        for (uint32_t i = 0; i < numTypes; i++) {
+            for (auto& layer : mLayers) {
+                if (layer.id == layers[i]) {
+                    layer.composition = static_cast<Composition>(types[i]);
+                }
+            }
+        }
+        ASSERT_EQ(0, getFunction<HWC2_PFN_ACCEPT_DISPLAY_CHANGES>(
+                             FunctionDescriptor::AcceptDisplayChanges)(mDevice, mDisplay));
+    }
+
+    void expectPreparedContents() {
+        std::vector<const LayerState*> sorted;
+        for (const auto& layer : mLayers) {
+            sorted.push_back(&layer);
+        }
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const LayerState* lhs, const LayerState* rhs) {
+                             return lhs->z < rhs->z;
+                         });
+
+        const auto& prepared = mHwc1Device.preparedLayers;
+        ASSERT_EQ(sorted.size() + 1, prepared.size()) << "frame " << mFrame;
+        for (size_t slot = 0; slot < sorted.size(); slot++) {
+            SCOPED_TRACE("frame " + std::to_string(mFrame) + ", slot " + std::to_string(slot));
+            expectLayer(*sorted[slot], prepared[slot]);
+        }
+
+        const auto& target = prepared.back();
+        EXPECT_EQ(HWC_FRAMEBUFFER_TARGET, target.layer.compositionType);
+        EXPECT_EQ(nullptr, target.layer.handle);
+        EXPECT_EQ(0u, target.layer.hints);
+        EXPECT_EQ(kWidth, target.layer.displayFrame.right);
+        EXPECT_EQ(kHeight, target.layer.displayFrame.bottom);
+        ASSERT_EQ(1u, target.visibleRegion.size());
+        EXPECT_EQ(kWidth, target.visibleRegion[0].right);
+        EXPECT_TRUE(target.rectsInContents);
+    }
+
+    void expectLayer(const LayerState& expected, const FakeHwc1Device::PreparedLayer& prepared) {
+        const auto& layer = prepared.layer;
+        EXPECT_EQ(HWC_FRAMEBUFFER, layer.compositionType);
+        EXPECT_EQ(expected.composition == Composition::Device ? 0u : uint32_t(HWC_SKIP_LAYER),
+                  layer.flags);
+        EXPECT_EQ(0u, layer.hints);
+        EXPECT_EQ(-1, layer.releaseFenceFd);
+
+        if (expected.composition == Composition::SolidColor) {
+            EXPECT_EQ(0, memcmp(&expected.color, &layer.backgroundColor, sizeof(hwc_color_t)));
+        } else {
+            EXPECT_EQ(expected.buffer, layer.handle);
+            EXPECT_EQ(-1, layer.acquireFenceFd);
+        }
+
+        int32_t blending = expected.blendMode == BlendMode::Coverage ? HWC_BLENDING_COVERAGE
+                : expected.blendMode == BlendMode::Premultiplied      ? HWC_BLENDING_PREMULT
+                                                                      : HWC_BLENDING_NONE;
+        EXPECT_EQ(blending, layer.blending);
+        EXPECT_EQ(static_cast<uint32_t>(expected.transform), layer.transform);
+        EXPECT_EQ(0, memcmp(&expected.displayFrame, &layer.displayFrame, sizeof(hwc_rect_t)));
+        EXPECT_EQ(0, memcmp(&expected.sourceCrop, &layer.sourceCropf, sizeof(hwc_frect_t)));
+        EXPECT_EQ(static_cast<uint8_t>(255.0f * expected.planeAlpha + 0.5f), layer.planeAlpha);
+
+        ASSERT_EQ(expected.visibleRegion.size(), prepared.visibleRegion.size());
+        EXPECT_TRUE(prepared.rectsInContents);
+        for (size_t i = 0; i < expected.visibleRegion.size(); i++) {
+            EXPECT_EQ(0, memcmp(&expected.visibleRegion[i], &prepared.visibleRegion[i],
+                                sizeof(hwc_rect_t)));
+        }
+    }
+
+    size_t getNumContentsAllocations() {
+        auto dump = getFunction<HWC2_PFN_DUMP>(FunctionDescriptor::Dump);
+        uint32_t size = 0;
+        dump(mDevice, &size, nullptr);
+        std::string output(size, '\0');
+        dump(mDevice, &size, &output[0]);
+
+        const std::string key = "allocated ";
+        auto position = output.find(key);
+        if (position == std::string::npos) {
+            return 0;
+        }
+        return std::stoul(output.substr(position + key.size()));
+    }
+
+    FakeHwc1Device mHwc1Device;
+    std::unique_ptr<HWC2On1Adapter> mAdapter;
+    hwc2_device_t* mDevice = nullptr;
+    hwc2_display_t mDisplay = 0;
+    bool mHasDisplay = false;
+
+    std::vector<LayerState> mLayers;
+    uint32_t mFrame = 0;
+};
+
+TEST_F(HWC2On1AdapterTest, KeepsContentsAcrossUnchangedFrames) {
+    for (uint32_t z = 0; z < 4; z++) {
+        createLayer(z, Composition::Device);
+    }
+    for (int i = 0; i < 5; i++) {
+        presentFrame();
+    }
+    EXPECT_EQ(1u, getNumContentsAllocations());
+}
+
+TEST_F(HWC2On1AdapterTest, ShrinksLayerCountInPlace) {
+    for (uint32_t z = 0; z < 8; z++) {
+        createLayer(z, Composition::Device);
+    }
+    presentFrame();
+
+    // Drop layers from the bottom, the middle and the top of the stack.
+    destroyLayer(0);
+    presentFrame();
+    destroyLayer(3);
+    presentFrame();
+    destroyLayer(mLayers.size() - 1);
+    presentFrame();
+    while (!mLayers.empty()) {
+        destroyLayer(0);
+        presentFrame();
+    }
+    EXPECT_EQ(1u, getNumContentsAllocations());
+}
+
+TEST_F(HWC2On1AdapterTest, GrowsLayerCount) {
+    presentFrame();
+    for (uint32_t z = 0; z < 24; z++) {
+        // Insert below the existing layers every other time, which moves all
+        // of them to another slot.
+        createLayer(z % 2 ? 100 + z : 100 - z, Composition::Device);
+        presentFrame();
+    }
+    EXPECT_GT(getNumContentsAllocations(), 1u);
+    // The headroom avoids reallocating on every new layer
+    EXPECT_LT(getNumContentsAllocations(), 12u);
+}
+
+TEST_F(HWC2On1AdapterTest, RewritesLayersMovedToAnotherSlot) {
+    for (uint32_t z = 0; z < 5; z++) {
+        createLayer(z * 10, Composition::Device);
+    }
+    presentFrame();
+
+    // Swap the bottom and top layers
+    setZ(0, 45);
+    setZ(4, 0);
+    presentFrame();
+
+    // Move a layer in the middle to the top
+    setZ(2, 50);
+    presentFrame();
+
+    // Only the visible region of a lower layer grows, which moves the rects
+    // of all layers above it.
+    setVisibleRegion(1, 5);
+    presentFrame();
+    EXPECT_EQ(1u, getNumContentsAllocations());
+}
+
+TEST_F(HWC2On1AdapterTest, SwitchesBetweenSolidColorAndDevice) {
+    for (uint32_t z = 0; z < 3; z++) {
+        createLayer(z, Composition::Device);
+    }
+    presentFrame();
+
+    // The background color shares its storage with the buffer handle.
+    setComposition(1, Composition::SolidColor);
+    presentFrame();
+    presentFrame();
+
+    setComposition(1, Composition::Device);
+    presentFrame();
+
+    setComposition(1, Composition::SolidColor);
+    setColor(1, 42);
+    presentFrame();
+    setColor(1, 43);
+    presentFrame();
+
+    setComposition(1, Composition::Client);
+    presentFrame();
+    setComposition(1, Composition::Device);
+    presentFrame();
+}
+
+TEST_F(HWC2On1AdapterTest, RandomFrameLoop) {
+    std::mt19937 random(1234);
+    auto pick = [&random](size_t count) {
+        return std::uniform_int_distribution<size_t>(0, count - 1)(random);
+    };
+    const Composition compositions[] = {Composition::Device, Composition::Client,
+                                        Composition::SolidColor};
+
+    // Layers with the same z are ordered by insertion, so keep them distinct.
+    auto unusedZ = [&]() {
+        uint32_t z;
+        do {
+            z = static_cast<uint32_t>(pick(64));
+        } while (std::any_of(mLayers.begin(), mLayers.end(),
+                             [z](const LayerState& layer) { return layer.z == z; }));
+        return z;
+    };
+
+    for (int i = 0; i < 4; i++) {
+        createLayer(unusedZ(), Composition::Device);
+    }
+
+    for (int frame = 0; frame < 500; frame++) {
+        // Most frames only post new buffers
+        switch (pick(8)) {
+            case 0:
+                if (mLayers.size() < 16) {
+                    createLayer(unusedZ(), compositions[pick(3)]);
+                }
+                break;
+            case 1:
+                if (!mLayers.empty()) {
+                    destroyLayer(pick(mLayers.size()));
+                }
+                break;
+            case 2:
+                if (!mLayers.empty()) {
+                    setZ(pick(mLayers.size()), unusedZ());
+                }
+                break;
+            case 3:
+                if (!mLayers.empty()) {
+                    setComposition(pick(mLayers.size()), compositions[pick(3)]);
+                }
+                break;
+            case 4:
+                if (!mLayers.empty()) {
+                    setGeometry(pick(mLayers.size()), frame);
+                }
+                break;
+            case 5:
+                if (!mLayers.empty()) {
+                    setVisibleRegion(pick(mLayers.size()), pick(4));
+                }
+                break;
+            default:
+                break;
+        }
+        presentFrame();
+        if (HasFailure()) {
+            return;
+        }
+    }
+}
+
+} // anonymous namespace
+} // namespace android
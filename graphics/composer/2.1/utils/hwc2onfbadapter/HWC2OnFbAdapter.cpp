@@ -24,10 +24,12 @@
 #include <type_traits>
 
 #include <inttypes.h>
+#include <stdio.h>
 #include <time.h>
 #include <sys/prctl.h>
 #include <unistd.h> // for close
 
+#include <cutils/properties.h>
 #include <hardware/fb.h>
 #include <log/log.h>
 #include <sync/sync.h>
@@ -663,6 +665,12 @@ HWC2OnFbAdapter::HWC2OnFbAdapter(framebuffer_device_t* fbDevice)
     // for FB devices
     mCapabilities.insert(Capability::PresentFenceIsNotReliable);
 
+    // Many fb drivers return from post() as soon as the buffer is queued.
+    // Feeding those return times to the vsync model would lock vsync to
+    // SurfaceFlinger's own post timing, which is driven by vsync in turn, so
+    // it is only done when the device says post() waits for the flip.
+    mLockVsyncToPost = property_get_bool("ro.vendor.hwc2onfb.lock_vsync_to_post", false);
+
     mVsyncThread.start(0, mFbInfo.vsync_period_ns);
 }
 
@@ -692,6 +700,7 @@ const HWC2OnFbAdapter::Info& HWC2OnFbAdapter::getInfo() const {
 }
 
 void HWC2OnFbAdapter::updateDebugString() {
+    mDebugString.clear();
     if (mFbDevice->common.version >= 1 && mFbDevice->dump) {
         char buffer[4096];
         mFbDevice->dump(mFbDevice, buffer, sizeof(buffer));
@@ -699,6 +708,7 @@ void HWC2OnFbAdapter::updateDebugString() {
 
         mDebugString = buffer;
     }
+    mDebugString += mVsyncThread.dump();
 }
 
 const std::string& HWC2OnFbAdapter::getDebugString() const {
@@ -773,6 +783,11 @@ void HWC2OnFbAdapter::clearDirtyLayers() {
  * SurfaceFlinger assumes the front buffer is available for rendering again
  * immediately after the back buffer is posted.  The locking semantics
  * hopefully are strong enough that the rendering will be blocked.
+ *
+ * On fb devices that only return from post once the buffer is flipped, the
+ * time post returns is the closest we get to a present timestamp.  When
+ * mLockVsyncToPost says so, it is fed to the vsync thread to keep the vsync
+ * callbacks in phase with the panel.
  */
 void HWC2OnFbAdapter::setBuffer(buffer_handle_t buffer) {
     if (mFbDevice->compositionComplete) {
@@ -785,6 +800,9 @@ bool HWC2OnFbAdapter::postBuffer() {
     int error = 0;
     if (mBuffer) {
         error = mFbDevice->post(mFbDevice, mBuffer);
+        if (error == 0 && mLockVsyncToPost) {
+            mVsyncThread.addPresentSample(VsyncThread::now());
+        }
     }
 
     return error == 0;
@@ -841,8 +859,7 @@ bool HWC2OnFbAdapter::VsyncThread::sleepUntil(int64_t t) {
 }
 
 void HWC2OnFbAdapter::VsyncThread::start(int64_t firstVsync, int64_t period) {
-    mNextVsync = firstVsync;
-    mPeriod = period;
+    mModel.reset(firstVsync, period);
     mStarted = true;
     mThread = std::thread(&VsyncThread::vsyncLoop, this);
 }
@@ -878,7 +895,7 @@ void HWC2OnFbAdapter::VsyncThread::vsyncLoop() {
         return;
     }
 
-    while (true) {
+    while (mStarted) {
         if (!mCallbackEnabled) {
             mCondition.wait(lock, [this] { return mCallbackEnabled || !mStarted; });
             if (!mStarted) {
@@ -886,26 +903,45 @@ void HWC2OnFbAdapter::VsyncThread::vsyncLoop() {
             }
         }
 
+        int64_t vsync = mModel.nextVsync(now(), mLastVsync);
+
         lock.unlock();
 
-        // adjust mNextVsync if necessary
-        int64_t t = now();
-        if (mNextVsync < t) {
-            int64_t n = (t - mNextVsync + mPeriod - 1) / mPeriod;
-            mNextVsync += mPeriod * n;
-        }
-        bool fire = sleepUntil(mNextVsync);
+        bool fire = sleepUntil(vsync);
+        int64_t lateness = now() - vsync;
 
         lock.lock();
 
         if (fire) {
-            ALOGV("VsyncThread(%" PRId64 ")", mNextVsync);
+            ALOGV("VsyncThread(%" PRId64 ")", vsync);
             if (mCallback) {
-                mCallback(mCallbackData, getDisplayId(), mNextVsync);
+                mCallback(mCallbackData, getDisplayId(), vsync);
             }
-            mNextVsync += mPeriod;
+            mLastVsync = vsync;
+
+            mCallbackCount++;
+            mSumCallbackLatenessNs += lateness;
+            mMaxCallbackLatenessNs = std::max(mMaxCallbackLatenessNs, lateness);
         }
     }
 }
 
+void HWC2OnFbAdapter::VsyncThread::addPresentSample(int64_t timestamp) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mModel.addPresentSample(timestamp);
+}
+
+std::string HWC2OnFbAdapter::VsyncThread::dump() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    int64_t avgLatenessUs =
+            mCallbackCount ? mSumCallbackLatenessNs / int64_t(mCallbackCount) / 1000 : 0;
+
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer),
+             "  callbacks %" PRIu64 ", lateness avg %" PRId64 " us, max %" PRId64 " us\n",
+             mCallbackCount, avgLatenessUs, mMaxCallbackLatenessNs / 1000);
+    return "Vsync model:\n" + mModel.dump() + buffer;
+}
+
 } // namespace android
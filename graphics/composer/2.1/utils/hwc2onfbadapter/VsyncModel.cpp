@@ -0,0 +1,127 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HWC2OnFbAdapter"
+
+//#define LOG_NDEBUG 0
+
+#include "hwc2onfbadapter/VsyncModel.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <log/log.h>
+
+namespace android {
+
+namespace {
+
+// Each present sample corrects this fraction of the phase error, and of the
+// period error accumulated since the previous sample.
+constexpr int64_t kPhaseGainDivisor = 4;
+constexpr int64_t kPeriodGainDivisor = 32;
+
+// The estimated period stays within 1/20th of the nominal period.
+constexpr int64_t kMaxPeriodDeviationDivisor = 20;
+
+// Samples further than a quarter period from the predicted vsync are outliers.
+// This many consecutive outliers agreeing with each other relock the model.
+constexpr uint32_t kRelockOutlierCount = 4;
+
+} // anonymous namespace
+
+void VsyncModel::reset(int64_t firstVsync, int64_t period) {
+    *this = VsyncModel();
+    mPhase = firstVsync;
+    mNominalPeriod = period;
+    mPeriod = period;
+}
+
+int64_t VsyncModel::nextVsync(int64_t t, int64_t lastVsync) const {
+    // Don't fire twice for the same refresh when the phase moved back a bit
+    int64_t earliest = std::max(t, lastVsync + mPeriod / 2);
+    int64_t offset = earliest - mPhase;
+    int64_t periods = offset > 0 ? (offset + mPeriod - 1) / mPeriod : -(-offset / mPeriod);
+    return mPhase + periods * mPeriod;
+}
+
+bool VsyncModel::addPresentSample(int64_t timestamp) {
+    mLastPresentTime = timestamp;
+
+    // Find the closest predicted vsync
+    int64_t offset = timestamp - mPhase;
+    int64_t periods = (offset >= 0 ? offset + mPeriod / 2 : offset - mPeriod / 2) / mPeriod;
+    int64_t vsync = mPhase + periods * mPeriod;
+    int64_t error = timestamp - vsync;
+    int64_t absError = std::abs(error);
+
+    if (absError > mPeriod / 4) {
+        mOutlierCount++;
+        bool agrees = mConsecutiveOutliers > 0 &&
+                std::abs(error - mLastOutlierError) < mPeriod / 8;
+        mConsecutiveOutliers = agrees ? mConsecutiveOutliers + 1 : 1;
+        mLastOutlierError = error;
+        if (mConsecutiveOutliers < kRelockOutlierCount) {
+            return false;
+        }
+
+        // The panel consistently refreshes somewhere else, e.g. after it was
+        // blanked, so start over from this sample
+        ALOGV("VsyncModel relocking to %" PRId64, timestamp);
+        mRelockCount++;
+        mConsecutiveOutliers = 0;
+        mPhase = timestamp;
+        mPeriod = mNominalPeriod;
+        mLastPresentVsync = timestamp;
+        return true;
+    }
+    mConsecutiveOutliers = 0;
+
+    mSampleCount++;
+    mSumAbsErrorNs += absError;
+    mMaxAbsErrorNs = std::max(mMaxAbsErrorNs, absError);
+
+    // Rebase the phase on this vsync, so that later period corrections are
+    // not multiplied by the number of periods since the first vsync
+    mPhase = vsync + error / kPhaseGainDivisor;
+    if (periods != 0) {
+        int64_t maxDeviation = mNominalPeriod / kMaxPeriodDeviationDivisor;
+        mPeriod += error / periods / kPeriodGainDivisor;
+        mPeriod = std::min(std::max(mPeriod, mNominalPeriod - maxDeviation),
+                           mNominalPeriod + maxDeviation);
+    }
+    mLastPresentVsync = vsync;
+    return true;
+}
+
+std::string VsyncModel::dump() const {
+    int64_t avgErrorUs = mSampleCount ? mSumAbsErrorNs / int64_t(mSampleCount) / 1000 : 0;
+
+    char buffer[384];
+    snprintf(buffer, sizeof(buffer),
+             "  period %" PRId64 " ns (nominal %" PRId64 " ns), phase %" PRId64 "\n"
+             "  present samples %" PRIu64 ", outliers %" PRIu64 ", relocks %" PRIu64 "\n"
+             "  present jitter avg %" PRId64 " us, max %" PRId64 " us\n"
+             "  last present %" PRId64 " at vsync %" PRId64 "\n",
+             mPeriod, mNominalPeriod, mPhase, mSampleCount, mOutlierCount, mRelockCount,
+             avgErrorUs, mMaxAbsErrorNs / 1000, mLastPresentTime, mLastPresentVsync);
+    return buffer;
+}
+
+} // namespace android
@@ -29,6 +29,8 @@
 #undef HWC2_INCLUDE_STRINGIFICATION
 #undef HWC2_USE_CPP11
 
+#include "hwc2onfbadapter/VsyncModel.h"
+
 struct framebuffer_device_t;
 
 namespace android {
@@ -97,6 +99,12 @@ private:
 
     std::unordered_set<HWC2::Capability> mCapabilities;
 
+    // Whether the times post() returns are fed to the vsync model as present
+    // samples. Only correct for fb devices whose post() blocks until the
+    // buffer is flipped, see setBuffer().
+    bool mLockVsyncToPost{false};
+
+    // Generates vsync callbacks from a VsyncModel of the display refresh.
     class VsyncThread {
     public:
         static int64_t now();
@@ -107,13 +115,24 @@ private:
         void setCallback(HWC2_PFN_VSYNC callback, hwc2_callback_data_t data);
         void enableCallback(bool enable);
 
+        // Corrects the model with the time a buffer was presented.
+        void addPresentSample(int64_t timestamp);
+
+        std::string dump();
+
     private:
         void vsyncLoop();
         bool waitUntilNextVsync();
 
         std::thread mThread;
-        int64_t mNextVsync{0};
-        int64_t mPeriod{0};
+
+        VsyncModel mModel;
+        int64_t mLastVsync{0};
+
+        // How late the vsync callbacks were fired.
+        uint64_t mCallbackCount{0};
+        int64_t mSumCallbackLatenessNs{0};
+        int64_t mMaxCallbackLatenessNs{0};
 
         std::mutex mMutex;
         std::condition_variable mCondition;
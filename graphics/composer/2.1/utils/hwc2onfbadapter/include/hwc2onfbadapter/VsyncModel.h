@@ -0,0 +1,76 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SF_HWC2_ON_FB_VSYNC_MODEL_H
+#define ANDROID_SF_HWC2_ON_FB_VSYNC_MODEL_H
+
+#include <stdint.h>
+
+#include <string>
+
+namespace android {
+
+// A model of the display refresh, used to schedule vsync callbacks.
+//
+// The model starts from the period reported by the fb device. It can then be
+// corrected, like a software PLL, with the times at which posted buffers were
+// presented: the phase is pulled towards each sample and the period is slowly
+// adjusted to the drift between them. Samples far away from a predicted vsync
+// are ignored, unless they keep agreeing with each other, in which case the
+// model locks to them again.
+//
+// Not thread-safe.
+class VsyncModel {
+public:
+    void reset(int64_t firstVsync, int64_t period);
+
+    // Returns the first predicted vsync at or after t. A vsync within half a
+    // period of lastVsync is skipped, so the same refresh is never reported
+    // twice when the phase moved back a bit.
+    int64_t nextVsync(int64_t t, int64_t lastVsync) const;
+
+    // Corrects the model with the time a buffer was presented. Returns false
+    // if the sample was ignored as an outlier.
+    bool addPresentSample(int64_t timestamp);
+
+    int64_t getPeriod() const { return mPeriod; }
+    int64_t getPhase() const { return mPhase; }
+    uint64_t getRelockCount() const { return mRelockCount; }
+
+    std::string dump() const;
+
+private:
+    // Period reported by the fb device, the current estimate, and a predicted
+    // vsync that all others are whole periods away from.
+    int64_t mNominalPeriod{0};
+    int64_t mPeriod{0};
+    int64_t mPhase{0};
+
+    // Present samples and how far they were from the predicted vsync.
+    uint64_t mSampleCount{0};
+    uint64_t mOutlierCount{0};
+    uint64_t mRelockCount{0};
+    uint32_t mConsecutiveOutliers{0};
+    int64_t mLastOutlierError{0};
+    int64_t mSumAbsErrorNs{0};
+    int64_t mMaxAbsErrorNs{0};
+    int64_t mLastPresentTime{0};
+    int64_t mLastPresentVsync{0};
+};
+
+} // namespace android
+
+#endif // ANDROID_SF_HWC2_ON_FB_VSYNC_MODEL_H
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hwc2onfbadapter/VsyncModel.h"
+
+#include <cstdlib>
+
+#include <gtest/gtest.h>
+
+namespace android {
+namespace {
+
+constexpr int64_t kPeriod = 16'666'666;
+
+class VsyncModelTest : public ::testing::Test {
+protected:
+    void SetUp() override { mModel.reset(0, kPeriod); }
+
+    // Feeds one sample per refresh of a panel with the given phase and period,
+    // starting at refresh first.
+    void addPanelSamples(int64_t phase, int64_t period, int64_t first, int64_t count) {
+        for (int64_t i = first; i < first + count; i++) {
+            mModel.addPresentSample(phase + i * period);
+        }
+    }
+
+    VsyncModel mModel;
+};
+
+TEST_F(VsyncModelTest, FreeRunsAtNominalPeriod) {
+    EXPECT_EQ(0, mModel.nextVsync(0, -kPeriod));
+    EXPECT_EQ(kPeriod, mModel.nextVsync(1, -kPeriod));
+    EXPECT_EQ(10 * kPeriod, mModel.nextVsync(10 * kPeriod - 1, 9 * kPeriod));
+    EXPECT_EQ(10 * kPeriod, mModel.nextVsync(10 * kPeriod, 9 * kPeriod));
+}
+
+TEST_F(VsyncModelTest, NeverReportsTheSameRefreshTwice) {
+    // The last callback fired at 10 periods; a later sample pulls the phase
+    // back by a few milliseconds.
+    int64_t lastVsync = 10 * kPeriod;
+    ASSERT_TRUE(mModel.addPresentSample(10 * kPeriod - 3'000'000));
+    int64_t next = mModel.nextVsync(lastVsync + 1, lastVsync);
+    EXPECT_GT(next, lastVsync + kPeriod / 2);
+    EXPECT_LT(next, lastVsync + kPeriod + kPeriod / 2);
+}
+
+TEST_F(VsyncModelTest, LocksToPanelPhaseAndPeriod) {
+    const int64_t panelPhase = 3'000'000;
+    const int64_t panelPeriod = kPeriod + kPeriod / 100;  // 1% slower
+    addPanelSamples(panelPhase, panelPeriod, 1, 600);
+
+    EXPECT_LT(std::abs(mModel.getPeriod() - panelPeriod), 20'000);
+    // The predicted vsync matches the next panel refresh.
+    int64_t panelVsync = panelPhase + 600 * panelPeriod;
+    int64_t predicted = mModel.nextVsync(panelVsync - kPeriod / 4, 0);
+    EXPECT_LT(std::abs(predicted - panelVsync), 200'000);
+    EXPECT_EQ(0u, mModel.getRelockCount());
+}
+
+TEST_F(VsyncModelTest, IgnoresSingleOutliers) {
+    addPanelSamples(0, kPeriod, 1, 10);
+    int64_t period = mModel.getPeriod();
+    int64_t phase = mModel.getPhase();
+
+    EXPECT_FALSE(mModel.addPresentSample(11 * kPeriod + kPeriod / 2));
+    EXPECT_EQ(period, mModel.getPeriod());
+    EXPECT_EQ(phase, mModel.getPhase());
+
+    // Outliers that disagree with each other never relock.
+    for (int64_t i = 12; i < 30; i++) {
+        mModel.addPresentSample(i * kPeriod + (i % 2 ? kPeriod / 3 : -kPeriod / 3));
+    }
+    EXPECT_EQ(0u, mModel.getRelockCount());
+    EXPECT_EQ(phase, mModel.getPhase());
+}
+
+TEST_F(VsyncModelTest, RelocksAfterConsistentOutliers) {
+    addPanelSamples(0, kPeriod, 1, 10);
+
+    // The panel now refreshes half a period later, e.g. after an unblank.
+    const int64_t shifted = kPeriod / 2;
+    EXPECT_FALSE(mModel.addPresentSample(shifted + 11 * kPeriod));
+    EXPECT_FALSE(mModel.addPresentSample(shifted + 12 * kPeriod));
+    EXPECT_FALSE(mModel.addPresentSample(shifted + 13 * kPeriod));
+    EXPECT_TRUE(mModel.addPresentSample(shifted + 14 * kPeriod));
+
+    EXPECT_EQ(1u, mModel.getRelockCount());
+    EXPECT_EQ(shifted + 14 * kPeriod, mModel.getPhase());
+    EXPECT_EQ(kPeriod, mModel.getPeriod());
+    EXPECT_EQ(shifted + 15 * kPeriod, mModel.nextVsync(shifted + 14 * kPeriod + 1, 0));
+}
+
+TEST_F(VsyncModelTest, PeriodStaysNearNominal) {
+    // Every sample arrives late, which keeps dragging the estimate up until it
+    // hits the cap.
+    for (int i = 0; i < 2000; i++) {
+        mModel.addPresentSample(mModel.nextVsync(mModel.getPhase() + 1, 0) + kPeriod / 10);
+        ASSERT_LE(mModel.getPeriod(), kPeriod + kPeriod / 20);
+        ASSERT_GE(mModel.getPeriod(), kPeriod - kPeriod / 20);
+    }
+    EXPECT_EQ(kPeriod + kPeriod / 20, mModel.getPeriod());
+}
+
+TEST_F(VsyncModelTest, ResetForgetsCorrections) {
+    addPanelSamples(1'000'000, kPeriod + 100'000, 1, 100);
+    mModel.reset(0, kPeriod);
+    EXPECT_EQ(kPeriod, mModel.getPeriod());
+    EXPECT_EQ(0, mModel.getPhase());
+    EXPECT_EQ(0u, mModel.getRelockCount());
+}
+
+} // anonymous namespace
+} // namespace android
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "GrallocImportedBufferPoolBenchmark"
+
+#include <mapper-passthrough/2.0/GrallocLoader.h>
+
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <cutils/native_handle.h>
+
+namespace {
+
+using android::hardware::graphics::mapper::V2_0::passthrough::GrallocImportedBufferPool;
+
+// The pool as it was before it was sharded: one mutex for all buffers.
+class SingleLockBufferPool {
+   public:
+    static SingleLockBufferPool& getInstance() {
+        static SingleLockBufferPool* singleton = new SingleLockBufferPool;
+        return *singleton;
+    }
+
+    void* add(native_handle_t* bufferHandle) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mBufferHandles.insert(bufferHandle).second ? bufferHandle : nullptr;
+    }
+
+    native_handle_t* remove(void* buffer) {
+        auto bufferHandle = static_cast<native_handle_t*>(buffer);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mBufferHandles.erase(bufferHandle) == 1 ? bufferHandle : nullptr;
+    }
+
+    const native_handle_t* get(void* buffer) {
+        auto bufferHandle = static_cast<const native_handle_t*>(buffer);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mBufferHandles.count(bufferHandle) == 1 ? bufferHandle : nullptr;
+    }
+
+   private:
+    std::mutex mMutex;
+    std::unordered_set<const native_handle_t*> mBufferHandles;
+};
+
+// A few buffers per thread, like the buffers of a window's BufferQueue.
+constexpr size_t kBuffersPerThread = 3;
+
+// Imports buffers into the pool for the lifetime of one benchmark thread.
+template <typename Pool>
+class ImportedBuffers {
+   public:
+    explicit ImportedBuffers(size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            mBuffers.push_back(importBuffer());
+        }
+    }
+
+    ~ImportedBuffers() {
+        for (auto buffer : mBuffers) {
+            freeBuffer(buffer);
+        }
+    }
+
+    static void* importBuffer() {
+        return Pool::getInstance().add(native_handle_create(0, 0));
+    }
+
+    static void freeBuffer(void* buffer) {
+        native_handle_delete(Pool::getInstance().remove(buffer));
+    }
+
+    void* operator[](size_t index) const { return mBuffers[index % mBuffers.size()]; }
+
+   private:
+    std::vector<void*> mBuffers;
+};
+
+// Each thread locks and unlocks its own buffers, as apps and RenderThreads
+// do through GraphicBufferMapper.  Both lock and unlock look the buffer up in
+// the pool.
+template <typename Pool>
+void BM_lockUnlock(benchmark::State& state) {
+    ImportedBuffers<Pool> buffers(kBuffersPerThread);
+    auto& pool = Pool::getInstance();
+
+    size_t frame = 0;
+    for (auto _ : state) {
+        void* buffer = buffers[frame++];
+        benchmark::DoNotOptimize(pool.get(buffer));
+        benchmark::DoNotOptimize(pool.get(buffer));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_lockUnlock, GrallocImportedBufferPool)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_lockUnlock, SingleLockBufferPool)->ThreadRange(1, 16)->UseRealTime();
+
+// Same, but each thread also imports and frees a buffer every few frames, so
+// that the pool's sets are modified while other threads look buffers up.
+template <typename Pool>
+void BM_lockUnlockWithImports(benchmark::State& state) {
+    ImportedBuffers<Pool> buffers(kBuffersPerThread);
+    auto& pool = Pool::getInstance();
+
+    size_t frame = 0;
+    for (auto _ : state) {
+        void* buffer = buffers[frame++];
+        benchmark::DoNotOptimize(pool.get(buffer));
+        benchmark::DoNotOptimize(pool.get(buffer));
+
+        if (frame % 8 == 0) {
+            ImportedBuffers<Pool>::freeBuffer(ImportedBuffers<Pool>::importBuffer());
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_lockUnlockWithImports, GrallocImportedBufferPool)
+        ->ThreadRange(1, 16)
+        ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_lockUnlockWithImports, SingleLockBufferPool)
+        ->ThreadRange(1, 16)
+        ->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -20,6 +20,8 @@
 #warning "GrallocLoader.h included without LOG_TAG"
 #endif
 
+#include <array>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <unordered_set>
@@ -57,27 +59,51 @@ class GrallocImportedBufferPool {
     }
 
     void* add(native_handle_t* bufferHandle) {
-        std::lock_guard<std::mutex> lock(mMutex);
-        return mBufferHandles.insert(bufferHandle).second ? bufferHandle : nullptr;
+        Shard& shard = getShard(bufferHandle);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.bufferHandles.insert(bufferHandle).second ? bufferHandle : nullptr;
     }
 
     native_handle_t* remove(void* buffer) {
         auto bufferHandle = static_cast<native_handle_t*>(buffer);
+        Shard& shard = getShard(bufferHandle);
 
-        std::lock_guard<std::mutex> lock(mMutex);
-        return mBufferHandles.erase(bufferHandle) == 1 ? bufferHandle : nullptr;
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.bufferHandles.erase(bufferHandle) == 1 ? bufferHandle : nullptr;
     }
 
     const native_handle_t* get(void* buffer) {
         auto bufferHandle = static_cast<const native_handle_t*>(buffer);
+        Shard& shard = getShard(bufferHandle);
 
-        std::lock_guard<std::mutex> lock(mMutex);
-        return mBufferHandles.count(bufferHandle) == 1 ? bufferHandle : nullptr;
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.bufferHandles.count(bufferHandle) == 1 ? bufferHandle : nullptr;
     }
 
    private:
-    std::mutex mMutex;
-    std::unordered_set<const native_handle_t*> mBufferHandles;
+    // get() is called for every lock and unlock, possibly from many threads
+    // at once.  Buffers are spread over independently locked shards so that
+    // threads working on different buffers rarely contend.
+    static constexpr size_t kShardCount = 16;
+
+    // each shard is on its own cache line to avoid false sharing
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_set<const native_handle_t*> bufferHandles;
+    };
+
+    Shard& getShard(const native_handle_t* bufferHandle) {
+        // handles are heap allocated; mix the address so that the low bits,
+        // which are mostly zero, do not decide the shard
+        uint64_t key = reinterpret_cast<uintptr_t>(bufferHandle);
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return mShards[key % kShardCount];
+    }
+
+    std::array<Shard, kShardCount> mShards;
 };
 
 // Inherit from V2_*::hal::Mapper and override imported buffer management functions
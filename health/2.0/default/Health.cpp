@@ -17,10 +17,17 @@
 #include <android-base/logging.h>
 
 #include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/properties.h>
+#include <android-base/strings.h>
 #include <health2/Health.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <hal_conversion.h>
 #include <hidl/HidlTransportSupport.h>
+#include <utils/SystemClock.h>
 
 extern void healthd_battery_update_internal(bool);
 
@@ -32,11 +39,69 @@ namespace implementation {
 
 sp<Health> Health::instance_;
 
+// Default bound on the age of cached property values, see property_cache_.
+static constexpr int64_t kDefaultPropertyCacheMaxAgeMs = 500;
+
 Health::Health(struct healthd_config* c) {
     // TODO(b/69268160): remove when libhealthd is removed.
     healthd_board_init(c);
     battery_monitor_ = std::make_unique<BatteryMonitor>();
     battery_monitor_->init(c);
+
+    property_cache_max_age_ms_ = android::base::GetIntProperty(
+        "ro.vendor.health.property_cache_ms", kDefaultPropertyCacheMaxAgeMs, int64_t(0));
+
+    // BatteryMonitor::init has filled in the sysfs paths.
+    openPropertyFile(BATTERY_PROP_CHARGE_COUNTER, c->batteryChargeCounterPath);
+    openPropertyFile(BATTERY_PROP_CURRENT_NOW, c->batteryCurrentNowPath);
+    openPropertyFile(BATTERY_PROP_CURRENT_AVG, c->batteryCurrentAvgPath);
+    openPropertyFile(BATTERY_PROP_CAPACITY, c->batteryCapacityPath);
+}
+
+void Health::openPropertyFile(int id, const String8& path) {
+    if (path.isEmpty()) return;
+    android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(path.string(), O_RDONLY | O_CLOEXEC)));
+    if (fd == -1) {
+        PLOG(WARNING) << "Cannot open " << path.string();
+        return;
+    }
+    property_fds_[id] = std::move(fd);
+}
+
+status_t Health::readProperty(int id, struct BatteryProperty* val) {
+    auto it = property_fds_.find(id);
+    if (it == property_fds_.end()) {
+        return battery_monitor_->getProperty(id, val);
+    }
+
+    // Same parsing as BatteryMonitor::getIntField, without reopening the file each time.
+    char buf[32];
+    ssize_t n = TEMP_FAILURE_RETRY(pread(it->second, buf, sizeof(buf) - 1, 0));
+    int value = 0;
+    if (n > 0) {
+        buf[n] = '\0';
+        android::base::ParseInt(android::base::Trim(buf), &value);
+    }
+    val->valueInt64 = value;
+    return OK;
+}
+
+status_t Health::getCachedProperty(int id, struct BatteryProperty* val) {
+    if (property_cache_max_age_ms_ <= 0) return readProperty(id, val);
+
+    const int64_t now = uptimeMillis();
+    std::lock_guard<std::mutex> _lock(property_cache_lock_);
+    auto it = property_cache_.find(id);
+    if (it == property_cache_.end() || now - it->second.timestamp_ms > property_cache_max_age_ms_) {
+        CachedProperty entry;
+        entry.err = readProperty(id, val);
+        entry.value = val->valueInt64;
+        entry.timestamp_ms = now;
+        property_cache_[id] = entry;
+        return entry.err;
+    }
+    val->valueInt64 = it->second.value;
+    return it->second.err;
 }
 
 // Methods from IHealth follow.
@@ -83,12 +148,11 @@ Return<Result> Health::unregisterCallback(const sp<IHealthInfoCallback>& callbac
 }
 
 template <typename T>
-void getProperty(const std::unique_ptr<BatteryMonitor>& monitor, int id, T defaultValue,
-                 const std::function<void(Result, T)>& callback) {
+void Health::getProperty(int id, T defaultValue, const std::function<void(Result, T)>& callback) {
     struct BatteryProperty prop;
     T ret = defaultValue;
     Result result = Result::SUCCESS;
-    status_t err = monitor->getProperty(static_cast<int>(id), &prop);
+    status_t err = getCachedProperty(static_cast<int>(id), &prop);
     if (err != OK) {
         LOG(DEBUG) << "getProperty(" << id << ")"
                    << " fails: (" << err << ") " << strerror(-err);
@@ -110,32 +174,32 @@ void getProperty(const std::unique_ptr<BatteryMonitor>& monitor, int id, T defau
 }
 
 Return<void> Health::getChargeCounter(getChargeCounter_cb _hidl_cb) {
-    getProperty<int32_t>(battery_monitor_, BATTERY_PROP_CHARGE_COUNTER, 0, _hidl_cb);
+    getProperty<int32_t>(BATTERY_PROP_CHARGE_COUNTER, 0, _hidl_cb);
     return Void();
 }
 
 Return<void> Health::getCurrentNow(getCurrentNow_cb _hidl_cb) {
-    getProperty<int32_t>(battery_monitor_, BATTERY_PROP_CURRENT_NOW, 0, _hidl_cb);
+    getProperty<int32_t>(BATTERY_PROP_CURRENT_NOW, 0, _hidl_cb);
     return Void();
 }
 
 Return<void> Health::getCurrentAverage(getCurrentAverage_cb _hidl_cb) {
-    getProperty<int32_t>(battery_monitor_, BATTERY_PROP_CURRENT_AVG, 0, _hidl_cb);
+    getProperty<int32_t>(BATTERY_PROP_CURRENT_AVG, 0, _hidl_cb);
     return Void();
 }
 
 Return<void> Health::getCapacity(getCapacity_cb _hidl_cb) {
-    getProperty<int32_t>(battery_monitor_, BATTERY_PROP_CAPACITY, 0, _hidl_cb);
+    getProperty<int32_t>(BATTERY_PROP_CAPACITY, 0, _hidl_cb);
     return Void();
 }
 
 Return<void> Health::getEnergyCounter(getEnergyCounter_cb _hidl_cb) {
-    getProperty<int64_t>(battery_monitor_, BATTERY_PROP_ENERGY_COUNTER, 0, _hidl_cb);
+    getProperty<int64_t>(BATTERY_PROP_ENERGY_COUNTER, 0, _hidl_cb);
     return Void();
 }
 
 Return<void> Health::getChargeStatus(getChargeStatus_cb _hidl_cb) {
-    getProperty(battery_monitor_, BATTERY_PROP_BATTERY_STATUS, BatteryStatus::UNKNOWN, _hidl_cb);
+    getProperty(BATTERY_PROP_BATTERY_STATUS, BatteryStatus::UNKNOWN, _hidl_cb);
     return Void();
 }
 
@@ -146,6 +210,12 @@ Return<Result> Health::update() {
         return Result::UNKNOWN;
     }
 
+    // Everything is re-read from sysfs below, cached values are stale from now on.
+    {
+        std::lock_guard<std::mutex> _lock(property_cache_lock_);
+        property_cache_.clear();
+    }
+
     // Retrieve all information and call healthd_mode_ops->battery_update, which calls
     // notifyListeners.
     bool chargerOnline = battery_monitor_->update();
@@ -166,7 +236,7 @@ void Health::notifyListeners(HealthInfo* healthInfo) {
     int32_t currentAvg = 0;
 
     struct BatteryProperty prop;
-    status_t ret = battery_monitor_->getProperty(BATTERY_PROP_CURRENT_AVG, &prop);
+    status_t ret = getCachedProperty(BATTERY_PROP_CURRENT_AVG, &prop);
     if (ret == OK) {
         currentAvg = static_cast<int32_t>(prop.valueInt64);
     }
@@ -248,7 +318,7 @@ Return<void> Health::getHealthInfo(getHealthInfo_cb _hidl_cb) {
     int32_t currentAvg = 0;
 
     struct BatteryProperty prop;
-    status_t ret = battery_monitor_->getProperty(BATTERY_PROP_CURRENT_AVG, &prop);
+    status_t ret = getCachedProperty(BATTERY_PROP_CURRENT_AVG, &prop);
     if (ret == OK) {
         currentAvg = static_cast<int32_t>(prop.valueInt64);
     }
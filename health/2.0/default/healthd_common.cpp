@@ -32,6 +32,9 @@
 #include <sys/timerfd.h>
 #include <unistd.h>
 #include <utils/Errors.h>
+#include <utils/SystemClock.h>
+
+#include <algorithm>
 
 #include <health2/Health.h>
 
@@ -75,6 +78,13 @@ static int wakealarm_fd;
 // -1 for no epoll timeout
 static int awake_poll_interval = -1;
 
+// power_supply uevents tend to come in bursts (e.g. on charger plug-in). The first uevent of a burst
+// updates the battery state right away, further ones within this window are coalesced into a
+// single update at the end of the window.
+#define UEVENT_COALESCE_WINDOW_MS 100
+static int64_t last_battery_update_ms = -1;
+static bool battery_update_pending = false;
+
 static int wakealarm_wake_interval = DEFAULT_PERIODIC_CHORES_INTERVAL_FAST;
 
 using ::android::hardware::health::V2_0::implementation::Health;
@@ -139,9 +149,23 @@ void healthd_battery_update_internal(bool charger_online) {
 }
 
 static void healthd_battery_update(void) {
+    last_battery_update_ms = uptimeMillis();
+    battery_update_pending = false;
     Health::getImplementation()->update();
 }
 
+static int64_t battery_update_pending_delay_ms(void) {
+    return last_battery_update_ms + UEVENT_COALESCE_WINDOW_MS - uptimeMillis();
+}
+
+static void healthd_battery_update_coalesced(void) {
+    if (last_battery_update_ms < 0 || battery_update_pending_delay_ms() <= 0) {
+        healthd_battery_update();
+    } else {
+        battery_update_pending = true;
+    }
+}
+
 static void periodic_chores() {
     healthd_battery_update();
 }
@@ -152,25 +176,31 @@ static void uevent_event(uint32_t /*epevents*/) {
     char* cp;
     int n;
 
-    n = uevent_kernel_multicast_recv(uevent_fd, msg, UEVENT_MSG_LEN);
-    if (n <= 0) return;
-    if (n >= UEVENT_MSG_LEN) /* overflow -- discard */
-        return;
+    bool power_supply_changed = false;
 
-    msg[n] = '\0';
-    msg[n + 1] = '\0';
-    cp = msg;
+    // Drain all queued uevents, a burst results in a single battery update.
+    while ((n = uevent_kernel_multicast_recv(uevent_fd, msg, UEVENT_MSG_LEN)) > 0) {
+        if (n >= UEVENT_MSG_LEN) /* overflow -- discard */
+            continue;
+        if (power_supply_changed) continue;
 
-    while (*cp) {
-        if (!strcmp(cp, "SUBSYSTEM=" POWER_SUPPLY_SUBSYSTEM)) {
-            healthd_battery_update();
-            break;
-        }
+        msg[n] = '\0';
+        msg[n + 1] = '\0';
+        cp = msg;
+
+        while (*cp) {
+            if (!strcmp(cp, "SUBSYSTEM=" POWER_SUPPLY_SUBSYSTEM)) {
+                power_supply_changed = true;
+                break;
+            }
 
-        /* advance to after the next \0 */
-        while (*cp++)
-            ;
+            /* advance to after the next \0 */
+            while (*cp++)
+                ;
+        }
     }
+
+    if (power_supply_changed) healthd_battery_update_coalesced();
 }
 
 static void uevent_init(void) {
@@ -218,12 +248,17 @@ static void healthd_mainloop(void) {
         int mode_timeout;
 
         /* Don't wait for first timer timeout to run periodic chores */
-        if (!nevents) periodic_chores();
+        if (!nevents || (battery_update_pending && battery_update_pending_delay_ms() <= 0))
+            periodic_chores();
 
         healthd_mode_ops->heartbeat();
 
         mode_timeout = healthd_mode_ops->preparetowait();
         if (timeout < 0 || (mode_timeout > 0 && mode_timeout < timeout)) timeout = mode_timeout;
+        if (battery_update_pending) {
+            int64_t pending_timeout = std::max<int64_t>(battery_update_pending_delay_ms(), 0);
+            if (timeout < 0 || pending_timeout < timeout) timeout = static_cast<int>(pending_timeout);
+        }
         nevents = epoll_wait(epollfd, events, eventct, timeout);
         if (nevents == -1) {
             if (errno == EINTR) continue;
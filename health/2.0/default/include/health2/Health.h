@@ -1,9 +1,11 @@
 #ifndef ANDROID_HARDWARE_HEALTH_V2_0_HEALTH_H
 #define ANDROID_HARDWARE_HEALTH_V2_0_HEALTH_H
 
+#include <map>
 #include <memory>
 #include <vector>
 
+#include <android-base/unique_fd.h>
 #include <android/hardware/health/1.0/types.h>
 #include <android/hardware/health/2.0/IHealth.h>
 #include <healthd/BatteryMonitor.h>
@@ -65,7 +67,26 @@ struct Health : public IHealth, hidl_death_recipient {
     std::vector<sp<IHealthInfoCallback>> callbacks_;
     std::unique_ptr<BatteryMonitor> battery_monitor_;
 
+    // Results of recent property reads, so that clients polling the getters don't re-read sysfs
+    // on every call. Entries older than property_cache_max_age_ms_ are read again, and update()
+    // drops all of them.
+    struct CachedProperty {
+        int64_t timestamp_ms;
+        status_t err;
+        int64_t value;
+    };
+    std::mutex property_cache_lock_;
+    std::map<int, CachedProperty> property_cache_;
+    int64_t property_cache_max_age_ms_;
+    // sysfs files of integer properties, kept open and re-read with pread().
+    std::map<int, android::base::unique_fd> property_fds_;
+
     bool unregisterCallbackInternal(const sp<IBase>& cb);
+    void openPropertyFile(int id, const String8& path);
+    status_t readProperty(int id, struct BatteryProperty* val);
+    status_t getCachedProperty(int id, struct BatteryProperty* val);
+    template <typename T>
+    void getProperty(int id, T defaultValue, const std::function<void(Result, T)>& callback);
 };
 
 }  // namespace implementation
@@ -18,6 +18,7 @@
 #include <keymasterV4_0/Keymaster3.h>
 
 #include <android-base/logging.h>
+#include <keymasterV4_0/keymaster_tags.h>
 #include <keymasterV4_0/keymaster_utils.h>
 
 namespace android {
@@ -94,6 +95,37 @@ hidl_vec<V3_0::KeyParameter> convertAndAddAuthToken(const hidl_vec<KeyParameter>
     return converted;
 }
 
+bool paramEqual(const KeyParameter& a, const KeyParameter& b) {
+    if (a.tag != b.tag) return false;
+    switch (typeFromTag(a.tag)) {
+        case TagType::INVALID:
+        case TagType::BOOL:
+            return true;
+        case TagType::ENUM:
+        case TagType::ENUM_REP:
+        case TagType::UINT:
+        case TagType::UINT_REP:
+            return a.f.integer == b.f.integer;
+        case TagType::ULONG:
+        case TagType::ULONG_REP:
+            return a.f.longInteger == b.f.longInteger;
+        case TagType::DATE:
+            return a.f.dateTime == b.f.dateTime;
+        case TagType::BIGNUM:
+        case TagType::BYTES:
+            return a.blob == b.blob;
+    }
+    return false;
+}
+
+bool paramsEqual(const hidl_vec<KeyParameter>& a, const hidl_vec<KeyParameter>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!paramEqual(a[i], b[i])) return false;
+    }
+    return true;
+}
+
 KeyCharacteristics convert(const V3_0::KeyCharacteristics& chars) {
     KeyCharacteristics converted;
     converted.hardwareEnforced = convert(chars.teeEnforced);
@@ -103,6 +135,35 @@ KeyCharacteristics convert(const V3_0::KeyCharacteristics& chars) {
 
 }  // namespace
 
+std::shared_ptr<const hidl_vec<V3_0::KeyParameter>> Keymaster3::getConvertedOperationParams(
+    uint64_t operationHandle, const hidl_vec<KeyParameter>& inParams,
+    const HardwareAuthToken& authToken) {
+    std::lock_guard<std::mutex> lock(operationParamsLock_);
+    auto it = operationParams_.find(operationHandle);
+    if (it != operationParams_.end() && it->second.authToken == authToken &&
+        paramsEqual(it->second.inParams, inParams)) {
+        return it->second.converted;
+    }
+
+    auto converted = std::make_shared<const hidl_vec<V3_0::KeyParameter>>(
+        convertAndAddAuthToken(inParams, authToken));
+    if (it == operationParams_.end()) {
+        if (operationParams_.size() >= kMaxCachedOperations) {
+            operationParams_.erase(operationParams_.begin());
+        }
+        it = operationParams_.emplace(operationHandle, OperationParams()).first;
+    }
+    it->second.inParams = inParams;
+    it->second.authToken = authToken;
+    it->second.converted = converted;
+    return converted;
+}
+
+void Keymaster3::forgetOperation(uint64_t operationHandle) {
+    std::lock_guard<std::mutex> lock(operationParamsLock_);
+    operationParams_.erase(operationHandle);
+}
+
 void Keymaster3::getVersionIfNeeded() {
     if (haveVersion_) return;
 
@@ -251,13 +312,17 @@ Return<void> Keymaster3::update(uint64_t operationHandle, const hidl_vec<KeyPara
                                 const hidl_vec<uint8_t>& input, const HardwareAuthToken& authToken,
                                 const VerificationToken& /* verificationToken */,
                                 update_cb _hidl_cb) {
+    V3_0::ErrorCode result = V3_0::ErrorCode::UNKNOWN_ERROR;
     auto cb = [&](V3_0::ErrorCode error, uint32_t inputConsumed,
                   const hidl_vec<V3_0::KeyParameter>& outParams, const hidl_vec<uint8_t>& output) {
+        result = error;
         _hidl_cb(convert(error), inputConsumed, convert(outParams), output);
     };
 
-    auto rc =
-        km3_dev_->update(operationHandle, convertAndAddAuthToken(inParams, authToken), input, cb);
+    auto params = getConvertedOperationParams(operationHandle, inParams, authToken);
+    auto rc = km3_dev_->update(operationHandle, *params, input, cb);
+    // A failed update() terminates the operation.
+    if (!rc.isOk() || result != V3_0::ErrorCode::OK) forgetOperation(operationHandle);
     rc.isOk();  // move ctor prereq
     return rc;
 }
@@ -272,13 +337,15 @@ Return<void> Keymaster3::finish(uint64_t operationHandle, const hidl_vec<KeyPara
         _hidl_cb(convert(error), convert(outParams), output);
     };
 
-    auto rc = km3_dev_->finish(operationHandle, convertAndAddAuthToken(inParams, authToken), input,
-                               signature, cb);
+    auto params = getConvertedOperationParams(operationHandle, inParams, authToken);
+    forgetOperation(operationHandle);
+    auto rc = km3_dev_->finish(operationHandle, *params, input, signature, cb);
     rc.isOk();  // move ctor prereq
     return rc;
 }
 
 Return<ErrorCode> Keymaster3::abort(uint64_t operationHandle) {
+    forgetOperation(operationHandle);
     auto rc = km3_dev_->abort(operationHandle);
     if (!rc.isOk()) return StatusOf<V3_0::ErrorCode, ErrorCode>(rc);
     return convert(rc);
@@ -17,6 +17,9 @@
 #include <keymasterV4_0/authorization_set.h>
 
 #include <assert.h>
+#include <string.h>
+
+#include <algorithm>
 
 namespace android {
 namespace hardware {
@@ -81,53 +84,114 @@ inline bool keyParamEqual(const KeyParameter& a, const KeyParameter& b) {
     return false;
 }
 
-void AuthorizationSet::Sort() {
-    std::sort(data_.begin(), data_.end(), keyParamLess);
+inline bool keyParamTagLess(const KeyParameter& a, Tag tag) {
+    return a.tag < tag;
 }
 
-void AuthorizationSet::Deduplicate() {
-    if (data_.empty()) return;
+/**
+ * Returns pointers to the elements of \p params in keyParamLess order, without copying the
+ * elements themselves.
+ */
+static std::vector<const KeyParameter*> sortedView(const std::vector<KeyParameter>& params,
+                                                   bool sorted) {
+    std::vector<const KeyParameter*> view;
+    view.reserve(params.size());
+    for (const auto& param : params) view.push_back(&param);
+    if (!sorted) {
+        std::sort(view.begin(), view.end(), [](const KeyParameter* a, const KeyParameter* b) {
+            return keyParamLess(*a, *b);
+        });
+    }
+    return view;
+}
 
-    Sort();
-    std::vector<KeyParameter> result;
+/**
+ * Removes INVALID entries and adjacent duplicates from the sorted range \p params, in place.
+ */
+static void uniqueSorted(std::vector<KeyParameter>* params) {
+    if (params->empty()) return;
 
-    auto curr = data_.begin();
+    auto out = params->begin();
+    auto curr = params->begin();
     auto prev = curr++;
-    for (; curr != data_.end(); ++prev, ++curr) {
+    for (; curr != params->end(); ++prev, ++curr) {
         if (prev->tag == Tag::INVALID) continue;
 
         if (!keyParamEqual(*prev, *curr)) {
-            result.emplace_back(std::move(*prev));
+            if (out != prev) *out = std::move(*prev);
+            ++out;
         }
     }
-    result.emplace_back(std::move(*prev));
+    if (out != prev) *out = std::move(*prev);
+    ++out;
 
-    std::swap(data_, result);
+    params->erase(out, params->end());
+}
+
+void AuthorizationSet::Sort() {
+    if (!sorted_) std::sort(data_.begin(), data_.end(), keyParamLess);
+    sorted_ = true;
+}
+
+void AuthorizationSet::Deduplicate() {
+    Sort();
+    uniqueSorted(&data_);
 }
 
 void AuthorizationSet::Union(const AuthorizationSet& other) {
-    data_.insert(data_.end(), other.data_.begin(), other.data_.end());
-    Deduplicate();
+    Sort();
+    if (other.empty() || &other == this) {
+        uniqueSorted(&data_);
+        return;
+    }
+
+    // Merge the two sorted sequences, then drop the duplicates in one pass.
+    auto otherView = sortedView(other.data_, other.sorted_);
+    std::vector<KeyParameter> result;
+    result.reserve(data_.size() + otherView.size());
+    auto i = data_.begin();
+    auto j = otherView.begin();
+    while (i != data_.end() && j != otherView.end()) {
+        if (keyParamLess(**j, *i)) {
+            result.push_back(**j++);
+        } else {
+            result.push_back(std::move(*i++));
+        }
+    }
+    for (; i != data_.end(); ++i) result.push_back(std::move(*i));
+    for (; j != otherView.end(); ++j) result.push_back(**j);
+
+    uniqueSorted(&result);
+    std::swap(data_, result);
 }
 
 void AuthorizationSet::Subtract(const AuthorizationSet& other) {
+    if (&other == this) {
+        Clear();
+        return;
+    }
     Deduplicate();
-
-    auto i = other.begin();
-    while (i != other.end()) {
-        int pos = -1;
-        do {
-            pos = find(i->tag, pos);
-            if (pos != -1 && keyParamEqual(*i, data_[pos])) {
-                data_.erase(data_.begin() + pos);
-                break;
-            }
-        } while (pos != -1);
-        ++i;
+    if (other.empty()) return;
+
+    // Both sides are sorted now, so a single merge-like pass finds every element to remove.
+    auto otherView = sortedView(other.data_, other.sorted_);
+    auto j = otherView.begin();
+    auto out = data_.begin();
+    for (auto i = data_.begin(); i != data_.end(); ++i) {
+        while (j != otherView.end() && keyParamLess(**j, *i)) ++j;
+        if (j != otherView.end() && keyParamEqual(*i, **j)) {
+            ++j;
+            continue;
+        }
+        if (out != i) *out = std::move(*i);
+        ++out;
     }
+    data_.erase(out, data_.end());
 }
 
 KeyParameter& AuthorizationSet::operator[](int at) {
+    // The caller may change the tag or value through the returned reference.
+    sorted_ = false;
     return data_[at];
 }
 
@@ -137,18 +201,33 @@ const KeyParameter& AuthorizationSet::operator[](int at) const {
 
 void AuthorizationSet::Clear() {
     data_.clear();
+    sorted_ = true;
 }
 
 size_t AuthorizationSet::GetTagCount(Tag tag) const {
-    size_t count = 0;
-    for (int pos = -1; (pos = find(tag, pos)) != -1;) ++count;
-    return count;
+    if (sorted_) {
+        auto first = std::lower_bound(data_.begin(), data_.end(), tag, keyParamTagLess);
+        auto last = first;
+        while (last != data_.end() && last->tag == tag) ++last;
+        return last - first;
+    }
+    return std::count_if(data_.begin(), data_.end(),
+                         [tag](const KeyParameter& param) { return param.tag == tag; });
 }
 
 int AuthorizationSet::find(Tag tag, int begin) const {
     auto iter = data_.begin() + (1 + begin);
 
-    while (iter != data_.end() && iter->tag != tag) ++iter;
+    if (sorted_) {
+        // Entries with the same tag are adjacent, so the next match is either the following
+        // element or the first entry of the tag's run.
+        if (iter != data_.end() && iter->tag != tag) {
+            iter = std::lower_bound(iter, data_.end(), tag, keyParamTagLess);
+            if (iter != data_.end() && iter->tag != tag) iter = data_.end();
+        }
+    } else {
+        while (iter != data_.end() && iter->tag != tag) ++iter;
+    }
 
     if (iter != data_.end()) return iter - data_.begin();
     return -1;
@@ -188,52 +267,69 @@ NullOr<const KeyParameter&> AuthorizationSet::GetEntry(Tag tag) const {
  * | 32 bit indirect_offset |
  */
 
-struct OutStreams {
-    std::ostream& indirect;
-    std::ostream& elements;
+/**
+ * Writes the indirect and element sections of the persistent format. If the buffers are null
+ * nothing is written and only the section sizes are computed, which lets the caller allocate the
+ * exact output size before the actual write.
+ */
+struct FlatOut {
+    uint8_t* indirect;
+    uint8_t* elements;
+    size_t indirect_size;
+    size_t elements_size;
+    bool bad;
+
+    void writeIndirect(const void* data, size_t length) {
+        if (indirect && length) memcpy(indirect + indirect_size, data, length);
+        indirect_size += length;
+    }
+    void writeElements(const void* data, size_t length) {
+        if (elements) memcpy(elements + elements_size, data, length);
+        elements_size += length;
+    }
 };
 
-OutStreams& serializeParamValue(OutStreams& out, const hidl_vec<uint8_t>& blob) {
+FlatOut& serializeParamValue(FlatOut& out, const hidl_vec<uint8_t>& blob) {
     uint32_t buffer;
 
     // write blob_length
     auto blob_length = blob.size();
     if (blob_length > std::numeric_limits<uint32_t>::max()) {
-        out.elements.setstate(std::ios_base::badbit);
+        out.bad = true;
         return out;
     }
     buffer = blob_length;
-    out.elements.write(reinterpret_cast<const char*>(&buffer), sizeof(uint32_t));
+    out.writeElements(&buffer, sizeof(uint32_t));
 
     // write indirect_offset
-    auto offset = out.indirect.tellp();
-    if (offset < 0 || offset > std::numeric_limits<uint32_t>::max() ||
+    auto offset = out.indirect_size;
+    if (offset > std::numeric_limits<uint32_t>::max() ||
         uint32_t(offset) + uint32_t(blob_length) < uint32_t(offset)) {  // overflow check
-        out.elements.setstate(std::ios_base::badbit);
+        out.bad = true;
         return out;
     }
     buffer = offset;
-    out.elements.write(reinterpret_cast<const char*>(&buffer), sizeof(uint32_t));
+    out.writeElements(&buffer, sizeof(uint32_t));
 
-    // write blob to indirect stream
-    if (blob_length) out.indirect.write(reinterpret_cast<const char*>(&blob[0]), blob_length);
+    // write blob to indirect section
+    if (blob_length) out.writeIndirect(&blob[0], blob_length);
 
     return out;
 }
 
 template <typename T>
-OutStreams& serializeParamValue(OutStreams& out, const T& value) {
-    out.elements.write(reinterpret_cast<const char*>(&value), sizeof(T));
+FlatOut& serializeParamValue(FlatOut& out, const T& value) {
+    out.writeElements(&value, sizeof(T));
     return out;
 }
 
-OutStreams& serialize(TAG_INVALID_t&&, OutStreams& out, const KeyParameter&) {
+FlatOut& serialize(TAG_INVALID_t&&, FlatOut& out, const KeyParameter&) {
     // skip invalid entries.
     return out;
 }
 template <typename T>
-OutStreams& serialize(T ttag, OutStreams& out, const KeyParameter& param) {
-    out.elements.write(reinterpret_cast<const char*>(&param.tag), sizeof(int32_t));
+FlatOut& serialize(T ttag, FlatOut& out, const KeyParameter& param) {
+    out.writeElements(&param.tag, sizeof(int32_t));
     return serializeParamValue(out, accessTagValue(ttag, param));
 }
 
@@ -241,19 +337,19 @@ template <typename... T>
 struct choose_serializer;
 template <typename... Tags>
 struct choose_serializer<MetaList<Tags...>> {
-    static OutStreams& serialize(OutStreams& out, const KeyParameter& param) {
+    static FlatOut& serialize(FlatOut& out, const KeyParameter& param) {
         return choose_serializer<Tags...>::serialize(out, param);
     }
 };
 
 template <>
 struct choose_serializer<> {
-    static OutStreams& serialize(OutStreams& out, const KeyParameter&) { return out; }
+    static FlatOut& serialize(FlatOut& out, const KeyParameter&) { return out; }
 };
 
 template <TagType tag_type, Tag tag, typename... Tail>
 struct choose_serializer<TypedTag<tag_type, tag>, Tail...> {
-    static OutStreams& serialize(OutStreams& out, const KeyParameter& param) {
+    static FlatOut& serialize(FlatOut& out, const KeyParameter& param) {
         if (param.tag == tag) {
             return V4_0::serialize(TypedTag<tag_type, tag>(), out, param);
         } else {
@@ -262,80 +358,114 @@ struct choose_serializer<TypedTag<tag_type, tag>, Tail...> {
     }
 };
 
-OutStreams& serialize(OutStreams& out, const KeyParameter& param) {
+FlatOut& serialize(FlatOut& out, const KeyParameter& param) {
     return choose_serializer<all_tags_t>::serialize(out, param);
 }
 
-std::ostream& serialize(std::ostream& out, const std::vector<KeyParameter>& params) {
-    std::stringstream indirect;
-    std::stringstream elements;
-    OutStreams streams = {indirect, elements};
+bool serialize(const std::vector<KeyParameter>& params, std::vector<uint8_t>* out) {
+    // First pass: compute the section sizes.
+    FlatOut sizes = {nullptr, nullptr, 0, 0, false};
     for (const auto& param : params) {
-        serialize(streams, param);
+        serialize(sizes, param);
+        if (sizes.bad) return false;
     }
-    if (indirect.bad() || elements.bad()) {
-        out.setstate(std::ios_base::badbit);
-        return out;
+    if (sizes.indirect_size > std::numeric_limits<uint32_t>::max() ||
+        sizes.elements_size > std::numeric_limits<uint32_t>::max() ||
+        params.size() > std::numeric_limits<uint32_t>::max()) {
+        return false;
     }
-    auto pos = indirect.tellp();
-    if (pos < 0 || pos > std::numeric_limits<uint32_t>::max()) {
-        out.setstate(std::ios_base::badbit);
-        return out;
+    uint32_t indirect_size = sizes.indirect_size;
+    uint32_t elements_size = sizes.elements_size;
+    uint32_t element_count = params.size();
+
+    out->resize(3 * sizeof(uint32_t) + indirect_size + elements_size);
+    uint8_t* pos = out->data();
+    memcpy(pos, &indirect_size, sizeof(uint32_t));
+    pos += sizeof(uint32_t);
+    uint8_t* indirect = pos;
+    pos += indirect_size;
+    memcpy(pos, &element_count, sizeof(uint32_t));
+    pos += sizeof(uint32_t);
+    memcpy(pos, &elements_size, sizeof(uint32_t));
+    pos += sizeof(uint32_t);
+
+    // Second pass: write both sections in place.
+    FlatOut writer = {indirect, pos, 0, 0, false};
+    for (const auto& param : params) {
+        serialize(writer, param);
     }
-    uint32_t indirect_size = pos;
-    pos = elements.tellp();
-    if (pos < 0 || pos > std::numeric_limits<uint32_t>::max()) {
+    assert(writer.indirect_size == indirect_size);
+    assert(writer.elements_size == elements_size);
+    return true;
+}
+
+std::ostream& serialize(std::ostream& out, const std::vector<KeyParameter>& params) {
+    std::vector<uint8_t> buffer;
+    if (!serialize(params, &buffer)) {
         out.setstate(std::ios_base::badbit);
         return out;
     }
-    uint32_t elements_size = pos;
-    uint32_t element_count = params.size();
-
-    out.write(reinterpret_cast<const char*>(&indirect_size), sizeof(uint32_t));
-
-    pos = out.tellp();
-    if (indirect_size) out << indirect.rdbuf();
-    assert(out.tellp() - pos == indirect_size);
-
-    out.write(reinterpret_cast<const char*>(&element_count), sizeof(uint32_t));
-    out.write(reinterpret_cast<const char*>(&elements_size), sizeof(uint32_t));
-
-    pos = out.tellp();
-    if (elements_size) out << elements.rdbuf();
-    assert(out.tellp() - pos == elements_size);
-
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
     return out;
 }
 
-struct InStreams {
-    std::istream& indirect;
-    std::istream& elements;
+/**
+ * Reads the element section of the persistent format. Blobs are resolved against the indirect
+ * section and either copied or, in view mode, referenced in place.
+ */
+struct FlatIn {
+    const uint8_t* indirect;
+    size_t indirect_size;
+    const uint8_t* elements;
+    size_t elements_size;
+    size_t elements_pos;
+    bool view;
+    bool bad;
+
+    bool readElements(void* data, size_t length) {
+        if (bad || elements_size - elements_pos < length) {
+            bad = true;
+            return false;
+        }
+        memcpy(data, elements + elements_pos, length);
+        elements_pos += length;
+        return true;
+    }
 };
 
-InStreams& deserializeParamValue(InStreams& in, hidl_vec<uint8_t>* blob) {
+FlatIn& deserializeParamValue(FlatIn& in, hidl_vec<uint8_t>* blob) {
     uint32_t blob_length = 0;
     uint32_t offset = 0;
-    in.elements.read(reinterpret_cast<char*>(&blob_length), sizeof(uint32_t));
-    blob->resize(blob_length);
-    in.elements.read(reinterpret_cast<char*>(&offset), sizeof(uint32_t));
-    in.indirect.seekg(offset);
-    in.indirect.read(reinterpret_cast<char*>(&(*blob)[0]), blob->size());
+    if (!in.readElements(&blob_length, sizeof(uint32_t)) ||
+        !in.readElements(&offset, sizeof(uint32_t))) {
+        return in;
+    }
+    if (offset > in.indirect_size || blob_length > in.indirect_size - offset) {
+        in.bad = true;
+        return in;
+    }
+    if (in.view) {
+        blob->setToExternal(const_cast<uint8_t*>(in.indirect + offset), blob_length);
+    } else {
+        blob->resize(blob_length);
+        if (blob_length) memcpy(&(*blob)[0], in.indirect + offset, blob_length);
+    }
     return in;
 }
 
 template <typename T>
-InStreams& deserializeParamValue(InStreams& in, T* value) {
-    in.elements.read(reinterpret_cast<char*>(value), sizeof(T));
+FlatIn& deserializeParamValue(FlatIn& in, T* value) {
+    in.readElements(value, sizeof(T));
     return in;
 }
 
-InStreams& deserialize(TAG_INVALID_t&&, InStreams& in, KeyParameter*) {
+FlatIn& deserialize(TAG_INVALID_t&&, FlatIn& in, KeyParameter*) {
     // there should be no invalid KeyParamaters but if handle them as zero sized.
     return in;
 }
 
 template <typename T>
-InStreams& deserialize(T&& ttag, InStreams& in, KeyParameter* param) {
+FlatIn& deserialize(T&& ttag, FlatIn& in, KeyParameter* param) {
     return deserializeParamValue(in, &accessTagValue(ttag, *param));
 }
 
@@ -343,21 +473,21 @@ template <typename... T>
 struct choose_deserializer;
 template <typename... Tags>
 struct choose_deserializer<MetaList<Tags...>> {
-    static InStreams& deserialize(InStreams& in, KeyParameter* param) {
+    static FlatIn& deserialize(FlatIn& in, KeyParameter* param) {
         return choose_deserializer<Tags...>::deserialize(in, param);
     }
 };
 template <>
 struct choose_deserializer<> {
-    static InStreams& deserialize(InStreams& in, KeyParameter*) {
+    static FlatIn& deserialize(FlatIn& in, KeyParameter*) {
         // encountered an unknown tag -> fail parsing
-        in.elements.setstate(std::ios_base::badbit);
+        in.bad = true;
         return in;
     }
 };
 template <TagType tag_type, Tag tag, typename... Tail>
 struct choose_deserializer<TypedTag<tag_type, tag>, Tail...> {
-    static InStreams& deserialize(InStreams& in, KeyParameter* param) {
+    static FlatIn& deserialize(FlatIn& in, KeyParameter* param) {
         if (param->tag == tag) {
             return V4_0::deserialize(TypedTag<tag_type, tag>(), in, param);
         } else {
@@ -366,44 +496,98 @@ struct choose_deserializer<TypedTag<tag_type, tag>, Tail...> {
     }
 };
 
-InStreams& deserialize(InStreams& in, KeyParameter* param) {
-    in.elements.read(reinterpret_cast<char*>(&param->tag), sizeof(Tag));
+FlatIn& deserialize(FlatIn& in, KeyParameter* param) {
+    if (!in.readElements(&param->tag, sizeof(Tag))) return in;
     return choose_deserializer<all_tags_t>::deserialize(in, param);
 }
 
-std::istream& deserialize(std::istream& in, std::vector<KeyParameter>* params) {
+// Bounds the invalid entries appended past the element section. Key characteristics hold far
+// fewer parameters than this.
+constexpr uint32_t kMaxUnwrittenEntries = 1024;
+
+bool deserialize(const uint8_t* data, size_t size, bool view, std::vector<KeyParameter>* params) {
+    params->clear();
+    size_t pos = 0;
+    auto readUint32 = [&](uint32_t* value) {
+        if (size - pos < sizeof(uint32_t)) return false;
+        memcpy(value, data + pos, sizeof(uint32_t));
+        pos += sizeof(uint32_t);
+        return true;
+    };
+
     uint32_t indirect_size = 0;
-    in.read(reinterpret_cast<char*>(&indirect_size), sizeof(uint32_t));
-    std::string indirect_buffer(indirect_size, '\0');
-    if (indirect_buffer.size() != indirect_size) {
-        in.setstate(std::ios_base::badbit);
-        return in;
-    }
-    in.read(&indirect_buffer[0], indirect_buffer.size());
+    if (!readUint32(&indirect_size) || size - pos < indirect_size) return false;
+    const uint8_t* indirect = data + pos;
+    pos += indirect_size;
 
     uint32_t element_count = 0;
-    in.read(reinterpret_cast<char*>(&element_count), sizeof(uint32_t));
     uint32_t elements_size = 0;
-    in.read(reinterpret_cast<char*>(&elements_size), sizeof(uint32_t));
+    if (!readUint32(&element_count) || !readUint32(&elements_size) || size - pos < elements_size) {
+        return false;
+    }
+    const uint8_t* elements = data + pos;
+
+    FlatIn in = {indirect, indirect_size, elements, elements_size, 0, view, false};
+    // The count comes from the blob. Every written entry takes at least a tag, so reserve no more
+    // than the element section can hold plus the unwritten entries, and never reallocate while
+    // blobs may reference the input.
+    params->reserve(std::min<size_t>(element_count,
+                                     elements_size / sizeof(Tag) + kMaxUnwrittenEntries));
+    uint32_t i = 0;
+    for (; i < element_count && in.elements_pos < in.elements_size; ++i) {
+        params->emplace_back();
+        deserialize(in, &params->back());
+        if (in.bad) {
+            // Don't hand out a partially parsed set.
+            params->clear();
+            return false;
+        }
+    }
 
-    std::string elements_buffer(elements_size, '\0');
-    if (elements_buffer.size() != elements_size) {
-        in.setstate(std::ios_base::badbit);
-        return in;
+    // Invalid entries are counted but not written by the serializer. They come back as default
+    // initialized entries at the end of the set, up to kMaxUnwrittenEntries of them.
+    if (element_count - i > kMaxUnwrittenEntries) {
+        params->clear();
+        return false;
+    }
+    params->resize(element_count);
+    return true;
+}
+
+/**
+ * Appends \p length bytes read from \p in to \p buffer. The buffer grows in bounded steps, so a
+ * corrupt size field can't make us allocate much more than the stream actually holds.
+ */
+static bool readAppend(std::istream& in, size_t length, std::vector<uint8_t>* buffer) {
+    constexpr size_t kMaxStep = 64 * 1024;
+    while (length) {
+        size_t step = std::min(length, kMaxStep);
+        size_t pos = buffer->size();
+        buffer->resize(pos + step);
+        in.read(reinterpret_cast<char*>(&(*buffer)[pos]), step);
+        if (!in) return false;
+        length -= step;
     }
-    in.read(&elements_buffer[0], elements_buffer.size());
+    return true;
+}
 
-    if (in.bad()) return in;
+std::istream& deserialize(std::istream& in, std::vector<KeyParameter>* params) {
+    params->clear();
 
-    // TODO write one-shot stream buffer to avoid copying here
-    std::stringstream indirect(indirect_buffer);
-    std::stringstream elements(elements_buffer);
-    InStreams streams = {indirect, elements};
+    // Read the whole persistent representation into one buffer and parse it in place.
+    std::vector<uint8_t> buffer;
+    if (!readAppend(in, sizeof(uint32_t), &buffer)) return in;
+    uint32_t indirect_size = 0;
+    memcpy(&indirect_size, buffer.data(), sizeof(uint32_t));
 
-    params->resize(element_count);
+    if (!readAppend(in, indirect_size + 2 * sizeof(uint32_t), &buffer)) return in;
+    uint32_t elements_size = 0;
+    memcpy(&elements_size, &buffer[buffer.size() - sizeof(uint32_t)], sizeof(uint32_t));
 
-    for (uint32_t i = 0; i < element_count; ++i) {
-        deserialize(streams, &(*params)[i]);
+    if (!readAppend(in, elements_size, &buffer)) return in;
+
+    if (!deserialize(buffer.data(), buffer.size(), false /* view */, params)) {
+        in.setstate(std::ios_base::badbit);
     }
     return in;
 }
@@ -412,8 +596,18 @@ void AuthorizationSet::Serialize(std::ostream* out) const {
     serialize(*out, data_);
 }
 
+bool AuthorizationSet::Serialize(std::vector<uint8_t>* out) const {
+    return serialize(data_, out);
+}
+
 void AuthorizationSet::Deserialize(std::istream* in) {
     deserialize(*in, &data_);
+    sorted_ = false;
+}
+
+bool AuthorizationSet::Deserialize(const uint8_t* data, size_t size, bool view) {
+    sorted_ = false;
+    return deserialize(data, size, view, &data_);
 }
 
 AuthorizationSetBuilder& AuthorizationSetBuilder::RsaKey(uint32_t key_size,
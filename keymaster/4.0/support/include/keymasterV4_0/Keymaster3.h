@@ -18,6 +18,10 @@
 #ifndef HARDWARE_INTERFACES_KEYMASTER_40_SUPPORT_KEYMASTER_3_H_
 #define HARDWARE_INTERFACES_KEYMASTER_40_SUPPORT_KEYMASTER_3_H_
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 #include <android/hardware/keymaster/3.0/IKeymasterDevice.h>
 
 #include "Keymaster.h"
@@ -115,10 +119,29 @@ class Keymaster3 : public Keymaster {
     Return<ErrorCode> abort(uint64_t operationHandle) override;
 
    private:
+    /**
+     * The converted parameters last sent for an operation.  update() is usually called many times
+     * with the same parameters and auth token, so they are converted once and reused.
+     */
+    struct OperationParams {
+        hidl_vec<KeyParameter> inParams;
+        HardwareAuthToken authToken;
+        std::shared_ptr<const hidl_vec<V3_0::KeyParameter>> converted;
+    };
+    // Operations that are never finished or aborted must not make the cache grow without bounds.
+    static constexpr size_t kMaxCachedOperations = 32;
+
     void getVersionIfNeeded();
+    std::shared_ptr<const hidl_vec<V3_0::KeyParameter>> getConvertedOperationParams(
+        uint64_t operationHandle, const hidl_vec<KeyParameter>& inParams,
+        const HardwareAuthToken& authToken);
+    void forgetOperation(uint64_t operationHandle);
 
     sp<IKeymaster3Device> km3_dev_;
 
+    std::mutex operationParamsLock_;
+    std::unordered_map<uint64_t, OperationParams> operationParams_;
+
     bool haveVersion_;
     VersionResult version_;
     bool supportsSymmetricCryptography_;
@@ -32,6 +32,11 @@ class AuthorizationSetBuilder;
  * An ordered collection of KeyParameters. It provides memory ownership and some convenient
  * functionality for sorting, deduplicating, joining, and subtracting sets of KeyParameters.
  * For serialization, wrap the backing store of this structure in a hidl_vec<KeyParameter>.
+ *
+ * The set remembers whether it is known to be sorted (after Sort(), Deduplicate(), Union() or
+ * Subtract()). While it is, tag lookups use binary search instead of a linear scan. Any
+ * modification that may break the order (push_back, non-const operator[], assignment from a
+ * hidl_vec or Deserialize) drops back to linear lookups until the set is sorted again.
  */
 class AuthorizationSet {
    public:
@@ -40,26 +45,32 @@ class AuthorizationSet {
     /**
      * Construct an empty, dynamically-allocated, growable AuthorizationSet.
      */
-    AuthorizationSet(){};
+    AuthorizationSet() : sorted_(true){};
 
     // Copy constructor.
-    AuthorizationSet(const AuthorizationSet& other) : data_(other.data_) {}
+    AuthorizationSet(const AuthorizationSet& other) : data_(other.data_), sorted_(other.sorted_) {}
 
     // Move constructor.
-    AuthorizationSet(AuthorizationSet&& other) : data_(std::move(other.data_)) {}
+    AuthorizationSet(AuthorizationSet&& other)
+        : data_(std::move(other.data_)), sorted_(other.sorted_) {
+        other.sorted_ = false;
+    }
 
     // Constructor from hidl_vec<KeyParameter>
-    AuthorizationSet(const hidl_vec<KeyParameter>& other) { *this = other; }
+    AuthorizationSet(const hidl_vec<KeyParameter>& other) : sorted_(true) { *this = other; }
 
     // Copy assignment.
     AuthorizationSet& operator=(const AuthorizationSet& other) {
         data_ = other.data_;
+        sorted_ = other.sorted_;
         return *this;
     }
 
     // Move assignment.
     AuthorizationSet& operator=(AuthorizationSet&& other) {
         data_ = std::move(other.data_);
+        sorted_ = other.sorted_;
+        other.sorted_ = false;
         return *this;
     }
 
@@ -71,6 +82,7 @@ class AuthorizationSet {
                  * See assignment operator/copy constructor of hidl_vec.*/
                 data_[i] = other[i];
             }
+            sorted_ = false;
         }
         return *this;
     }
@@ -121,7 +133,7 @@ class AuthorizationSet {
 
     /**
      * Returns the offset of the next entry that matches \p tag, starting from the element after \p
-     * begin.  If not found, returns -1.
+     * begin.  If not found, returns -1.  Logarithmic if the set is sorted, linear otherwise.
      */
     int find(Tag tag, int begin = -1) const;
 
@@ -162,8 +174,8 @@ class AuthorizationSet {
 
     template <TagType tag_type, Tag tag, typename ValueT>
     bool Contains(TypedTag<tag_type, tag> ttag, const ValueT& value) const {
-        for (const auto& param : data_) {
-            auto entry = authorizationValue(ttag, param);
+        for (int pos = find(tag); pos != -1; pos = find(tag, pos)) {
+            auto entry = authorizationValue(ttag, data_[pos]);
             if (entry.isOk() && static_cast<ValueT>(entry.value()) == value) return true;
         }
         return false;
@@ -180,8 +192,14 @@ class AuthorizationSet {
         return {};
     }
 
-    void push_back(const KeyParameter& param) { data_.push_back(param); }
-    void push_back(KeyParameter&& param) { data_.push_back(std::move(param)); }
+    void push_back(const KeyParameter& param) {
+        data_.push_back(param);
+        sorted_ = false;
+    }
+    void push_back(KeyParameter&& param) {
+        data_.push_back(std::move(param));
+        sorted_ = false;
+    }
     void push_back(const AuthorizationSet& set) {
         for (auto& entry : set) {
             push_back(entry);
@@ -216,12 +234,36 @@ class AuthorizationSet {
     }
 
     void Serialize(std::ostream* out) const;
+
+    /**
+     * Replaces the content of the set with the serialized set read from \p in. On failure the set
+     * is left empty. A truncated stream leaves \p in failed; malformed content, including a tag
+     * this version does not know, sets badbit. Earlier versions skipped unknown tags silently and
+     * kept whatever had been parsed so far.
+     */
     void Deserialize(std::istream* in);
 
+    /**
+     * Serializes the set into \p out, in the same format as Serialize(std::ostream*). The exact
+     * size is computed up front so the output is written with a single allocation. Returns false
+     * if the set can't be represented in the persistent format.
+     */
+    bool Serialize(std::vector<uint8_t>* out) const;
+
+    /**
+     * Replaces the content of the set with the serialized set in \p data. If \p view is true,
+     * BYTES and BIGNUM values reference \p data instead of owning a copy, so \p data must outlive
+     * the set. Returns false, leaving the set empty, if \p data is truncated or malformed or
+     * contains a tag this version does not know.
+     */
+    bool Deserialize(const uint8_t* data, size_t size, bool view = false);
+
    private:
     NullOr<const KeyParameter&> GetEntry(Tag tag) const;
 
     std::vector<KeyParameter> data_;
+    // True if data_ is known to be ordered by keyParamLess.
+    bool sorted_;
 };
 
 class AuthorizationSetBuilder : public AuthorizationSet {
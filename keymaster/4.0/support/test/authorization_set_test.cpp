@@ -0,0 +1,629 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <keymasterV4_0/authorization_set.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace android {
+namespace hardware {
+namespace keymaster {
+namespace V4_0 {
+namespace test {
+
+namespace {
+
+/*
+ * goldenSet() serialized by the stream based implementation that predates the flat buffer one.
+ * The persistent format must not change, keys stored by older versions are parsed with it.
+ */
+const uint8_t kGoldenBytes[] = {
+    0x03, 0x00, 0x00, 0x00, 0x61, 0x70, 0x70, 0x0a, 0x00, 0x00, 0x00, 0x5d,
+    0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x10, 0x01, 0x00, 0x00, 0x00, 0x03,
+    0x00, 0x00, 0x30, 0x00, 0x08, 0x00, 0x00, 0xc8, 0x00, 0x00, 0x50, 0x01,
+    0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x20, 0x02,
+    0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x20, 0x03, 0x00, 0x00, 0x00, 0x05,
+    0x00, 0x00, 0x20, 0x04, 0x00, 0x00, 0x00, 0xf7, 0x01, 0x00, 0x70, 0x01,
+    0x59, 0x02, 0x00, 0x90, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xbc, 0x02, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+    0x90, 0x01, 0x00, 0x60, 0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01,
+};
+
+// Offsets into kGoldenBytes.
+constexpr size_t kElementCountOffset = 7;
+constexpr size_t kElementsSizeOffset = 11;
+constexpr size_t kAlgorithmTagOffset = 15;
+constexpr size_t kApplicationIdLengthOffset = 76;
+constexpr size_t kApplicationIdOffsetOffset = 80;
+
+const uint8_t kEmptyBytes[] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+/*
+ * More sets serialized by the stream based implementation, see baselineCases() for the sets.
+ */
+const uint8_t kInvalidEntryBytes[] = {
+    0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x00, 0x10, 0x03, 0x00, 0x00, 0x00, 0xf7, 0x01, 0x00, 0x70,
+    0x01,
+};
+
+const uint8_t kOnlyInvalidBytes[] = {
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+const uint8_t kAllTagTypesBytes[] = {
+    0x0b, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x69, 0x64, 0x64,
+    0x61, 0x74, 0x61, 0x0b, 0x00, 0x00, 0x00, 0x6d, 0x00, 0x00, 0x00, 0x01,
+    0x00, 0x00, 0x20, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x20, 0x03,
+    0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x10, 0x80, 0x00, 0x00, 0x00, 0x08,
+    0x00, 0x00, 0x30, 0x80, 0x00, 0x00, 0x00, 0xf6, 0x01, 0x00, 0xa0, 0x88,
+    0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, 0xc8, 0x00, 0x00, 0x50, 0x03,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x91, 0x01, 0x00, 0x60, 0x00,
+    0x98, 0xf7, 0x3e, 0x5d, 0x01, 0x00, 0x00, 0x07, 0x00, 0x00, 0x70, 0x01,
+    0xc4, 0x02, 0x00, 0x90, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x59, 0x02, 0x00, 0x90, 0x02, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00,
+    0xbc, 0x02, 0x00, 0x90, 0x04, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00,
+};
+
+AuthorizationSet goldenSet() {
+    return AuthorizationSetBuilder()
+        .RsaSigningKey(2048, 65537)
+        .Digest(Digest::SHA_2_256)
+        .Authorization(TAG_NO_AUTH_REQUIRED)
+        .Authorization(TAG_APPLICATION_ID, hidl_vec<uint8_t>({'a', 'p', 'p'}))
+        .Authorization(TAG_APPLICATION_DATA, hidl_vec<uint8_t>())
+        .Authorization(TAG_ACTIVE_DATETIME, 0x0102030405060708ull);
+}
+
+std::vector<uint8_t> goldenBytes() {
+    return std::vector<uint8_t>(kGoldenBytes, kGoldenBytes + sizeof(kGoldenBytes));
+}
+
+void expectSameParams(const AuthorizationSet& expected, const AuthorizationSet& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_TRUE(expected[i] == actual[i]) << "at index " << i;
+    }
+}
+
+void writeUint32(std::vector<uint8_t>* bytes, size_t offset, uint32_t value) {
+    memcpy(bytes->data() + offset, &value, sizeof(value));
+}
+
+struct BaselineCase {
+    const char* name;
+    AuthorizationSet set;
+    std::vector<uint8_t> bytes;
+    // What the stream based implementation parsed the bytes back to. Invalid entries are not
+    // written, so they move to the end of the set.
+    AuthorizationSet parsed;
+};
+
+template <size_t N>
+std::vector<uint8_t> toVector(const uint8_t (&bytes)[N]) {
+    return std::vector<uint8_t>(bytes, bytes + N);
+}
+
+std::vector<BaselineCase> baselineCases() {
+    std::vector<BaselineCase> cases;
+    cases.push_back({"empty", AuthorizationSet(), toVector(kEmptyBytes), AuthorizationSet()});
+    cases.push_back({"golden", goldenSet(), goldenBytes(), goldenSet()});
+
+    AuthorizationSet invalidEntry;
+    invalidEntry.push_back(TAG_ALGORITHM, Algorithm::EC);
+    invalidEntry.push_back(KeyParameter{});
+    invalidEntry.push_back(TAG_NO_AUTH_REQUIRED);
+    AuthorizationSet invalidEntryParsed;
+    invalidEntryParsed.push_back(TAG_ALGORITHM, Algorithm::EC);
+    invalidEntryParsed.push_back(TAG_NO_AUTH_REQUIRED);
+    invalidEntryParsed.push_back(KeyParameter{});
+    cases.push_back(
+        {"invalid entry", invalidEntry, toVector(kInvalidEntryBytes), invalidEntryParsed});
+
+    AuthorizationSet onlyInvalid;
+    onlyInvalid.push_back(KeyParameter{});
+    cases.push_back({"only invalid", onlyInvalid, toVector(kOnlyInvalidBytes), onlyInvalid});
+
+    AuthorizationSet allTagTypes(
+        AuthorizationSetBuilder()
+            .Authorization(TAG_PURPOSE, KeyPurpose::SIGN)
+            .Authorization(TAG_PURPOSE, KeyPurpose::VERIFY)
+            .Authorization(TAG_ALGORITHM, Algorithm::HMAC)
+            .Authorization(TAG_MIN_MAC_LENGTH, 128u)
+            .Authorization(TAG_USER_SECURE_ID, 0x1122334455667788ull)
+            .Authorization(TAG_RSA_PUBLIC_EXPONENT, 3ull)
+            .Authorization(TAG_ORIGINATION_EXPIRE_DATETIME, 1500000000000ull)
+            .Authorization(TAG_CALLER_NONCE)
+            .Authorization(TAG_ATTESTATION_CHALLENGE, hidl_vec<uint8_t>({1, 2, 3, 4, 5}))
+            .Authorization(TAG_APPLICATION_ID, hidl_vec<uint8_t>({'i', 'd'}))
+            .Authorization(TAG_APPLICATION_DATA, hidl_vec<uint8_t>({'d', 'a', 't', 'a'})));
+    cases.push_back({"all tag types", allTagTypes, toVector(kAllTagTypesBytes), allTagTypes});
+    return cases;
+}
+
+/*
+ * Checks that both Deserialize() flavors agree on \p bytes, and that whatever parses serializes
+ * to a form that parses back to the same set.
+ */
+void checkSeed(const std::vector<uint8_t>& bytes) {
+    AuthorizationSet copied;
+    bool parsed = copied.Deserialize(bytes.data(), bytes.size());
+
+    AuthorizationSet viewed;
+    ASSERT_EQ(parsed, viewed.Deserialize(bytes.data(), bytes.size(), true /* view */));
+
+    std::stringstream stream(std::string(bytes.begin(), bytes.end()));
+    AuthorizationSet streamed;
+    streamed.Deserialize(&stream);
+    ASSERT_EQ(parsed, !stream.fail());
+
+    if (!parsed) {
+        EXPECT_TRUE(copied.empty());
+        EXPECT_TRUE(viewed.empty());
+        EXPECT_TRUE(streamed.empty());
+        return;
+    }
+    expectSameParams(copied, viewed);
+    expectSameParams(copied, streamed);
+
+    // Invalid entries move to the end on the first round trip, after that the form is stable.
+    std::vector<uint8_t> serialized;
+    ASSERT_TRUE(copied.Serialize(&serialized));
+    AuthorizationSet reparsed;
+    ASSERT_TRUE(reparsed.Deserialize(serialized.data(), serialized.size()));
+    ASSERT_EQ(copied.size(), reparsed.size());
+    std::vector<uint8_t> reserialized;
+    ASSERT_TRUE(reparsed.Serialize(&reserialized));
+    EXPECT_EQ(serialized, reserialized);
+}
+
+}  // namespace
+
+TEST(AuthorizationSetSerializationTest, SerializeMatchesGoldenBytes) {
+    std::vector<uint8_t> flat;
+    ASSERT_TRUE(goldenSet().Serialize(&flat));
+    EXPECT_EQ(goldenBytes(), flat);
+
+    std::stringstream stream;
+    goldenSet().Serialize(&stream);
+    ASSERT_TRUE(stream.good());
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(kGoldenBytes), sizeof(kGoldenBytes)),
+              stream.str());
+}
+
+TEST(AuthorizationSetSerializationTest, SerializeEmptySet) {
+    std::vector<uint8_t> flat;
+    ASSERT_TRUE(AuthorizationSet().Serialize(&flat));
+    EXPECT_EQ(std::vector<uint8_t>(kEmptyBytes, kEmptyBytes + sizeof(kEmptyBytes)), flat);
+}
+
+TEST(AuthorizationSetSerializationTest, DeserializeGoldenBytes) {
+    AuthorizationSet set;
+    ASSERT_TRUE(set.Deserialize(kGoldenBytes, sizeof(kGoldenBytes)));
+    expectSameParams(goldenSet(), set);
+
+    std::stringstream stream(
+        std::string(reinterpret_cast<const char*>(kGoldenBytes), sizeof(kGoldenBytes)));
+    AuthorizationSet streamed;
+    streamed.Deserialize(&stream);
+    ASSERT_FALSE(stream.fail());
+    expectSameParams(goldenSet(), streamed);
+}
+
+TEST(AuthorizationSetSerializationTest, DeserializeViewReferencesInput) {
+    std::vector<uint8_t> bytes = goldenBytes();
+    AuthorizationSet set;
+    ASSERT_TRUE(set.Deserialize(bytes.data(), bytes.size(), true /* view */));
+    expectSameParams(goldenSet(), set);
+
+    auto applicationId = set.GetTagValue(TAG_APPLICATION_ID);
+    ASSERT_TRUE(applicationId.isOk());
+    EXPECT_EQ(bytes.data() + 4, &applicationId.value()[0]);
+}
+
+TEST(AuthorizationSetSerializationTest, RoundTrip) {
+    AuthorizationSet original = goldenSet();
+    original.push_back(TAG_ATTESTATION_CHALLENGE, hidl_vec<uint8_t>(std::vector<uint8_t>(300, 7)));
+    original.push_back(TAG_USER_SECURE_ID, 0xfedcba9876543210ull);
+    original.push_back(TAG_USER_SECURE_ID, 42ull);
+
+    std::vector<uint8_t> flat;
+    ASSERT_TRUE(original.Serialize(&flat));
+    AuthorizationSet copied;
+    ASSERT_TRUE(copied.Deserialize(flat.data(), flat.size()));
+    expectSameParams(original, copied);
+
+    std::stringstream stream;
+    original.Serialize(&stream);
+    EXPECT_EQ(std::string(flat.begin(), flat.end()), stream.str());
+    AuthorizationSet streamed;
+    streamed.Deserialize(&stream);
+    ASSERT_FALSE(stream.fail());
+    expectSameParams(original, streamed);
+}
+
+TEST(AuthorizationSetSerializationTest, TruncatedInputFails) {
+    for (size_t size = 0; size < sizeof(kGoldenBytes); ++size) {
+        AuthorizationSet set = goldenSet();
+        EXPECT_FALSE(set.Deserialize(kGoldenBytes, size)) << "size " << size;
+        EXPECT_TRUE(set.empty()) << "size " << size;
+
+        std::stringstream stream(std::string(reinterpret_cast<const char*>(kGoldenBytes), size));
+        AuthorizationSet streamed = goldenSet();
+        streamed.Deserialize(&stream);
+        EXPECT_TRUE(stream.fail()) << "size " << size;
+        EXPECT_TRUE(streamed.empty()) << "size " << size;
+    }
+}
+
+TEST(AuthorizationSetSerializationTest, UnknownTagFails) {
+    std::vector<uint8_t> bytes = goldenBytes();
+    writeUint32(&bytes, kAlgorithmTagOffset, static_cast<uint32_t>(TagType::ENUM) | 4095);
+
+    AuthorizationSet set = goldenSet();
+    EXPECT_FALSE(set.Deserialize(bytes.data(), bytes.size()));
+    EXPECT_TRUE(set.empty());
+
+    std::stringstream stream(std::string(bytes.begin(), bytes.end()));
+    AuthorizationSet streamed = goldenSet();
+    streamed.Deserialize(&stream);
+    EXPECT_TRUE(stream.bad());
+    EXPECT_TRUE(streamed.empty());
+}
+
+TEST(AuthorizationSetSerializationTest, BlobOutsideIndirectSectionFails) {
+    std::vector<uint8_t> bytes = goldenBytes();
+    writeUint32(&bytes, kApplicationIdLengthOffset, 4);
+    AuthorizationSet set;
+    EXPECT_FALSE(set.Deserialize(bytes.data(), bytes.size()));
+    EXPECT_TRUE(set.empty());
+
+    bytes = goldenBytes();
+    writeUint32(&bytes, kApplicationIdOffsetOffset, 0xffffffff);
+    EXPECT_FALSE(set.Deserialize(bytes.data(), bytes.size()));
+    EXPECT_TRUE(set.empty());
+}
+
+TEST(AuthorizationSetSerializationTest, OversizedSectionsFail) {
+    std::vector<uint8_t> bytes = goldenBytes();
+    writeUint32(&bytes, 0, 0xffffffff);
+    AuthorizationSet set;
+    EXPECT_FALSE(set.Deserialize(bytes.data(), bytes.size()));
+
+    bytes = goldenBytes();
+    writeUint32(&bytes, kElementsSizeOffset, 0xffff);
+    EXPECT_FALSE(set.Deserialize(bytes.data(), bytes.size()));
+    EXPECT_TRUE(set.empty());
+
+    // A count far beyond what the element section holds is rejected.
+    bytes = goldenBytes();
+    writeUint32(&bytes, kElementCountOffset, 0xffffffff);
+    EXPECT_FALSE(set.Deserialize(bytes.data(), bytes.size()));
+    EXPECT_TRUE(set.empty());
+}
+
+TEST(AuthorizationSetSerializationTest, MatchesBaselineImplementation) {
+    for (const auto& c : baselineCases()) {
+        SCOPED_TRACE(c.name);
+
+        std::vector<uint8_t> flat;
+        ASSERT_TRUE(c.set.Serialize(&flat));
+        EXPECT_EQ(c.bytes, flat);
+        std::stringstream out;
+        c.set.Serialize(&out);
+        EXPECT_EQ(std::string(c.bytes.begin(), c.bytes.end()), out.str());
+
+        AuthorizationSet copied;
+        ASSERT_TRUE(copied.Deserialize(c.bytes.data(), c.bytes.size()));
+        expectSameParams(c.parsed, copied);
+        AuthorizationSet viewed;
+        ASSERT_TRUE(viewed.Deserialize(c.bytes.data(), c.bytes.size(), true /* view */));
+        expectSameParams(c.parsed, viewed);
+        std::stringstream in(std::string(c.bytes.begin(), c.bytes.end()));
+        AuthorizationSet streamed;
+        streamed.Deserialize(&in);
+        ASSERT_FALSE(in.fail());
+        expectSameParams(c.parsed, streamed);
+    }
+}
+
+TEST(AuthorizationSetSerializationTest, RoundTripsInvalidEntry) {
+    AuthorizationSet original;
+    original.push_back(TAG_ALGORITHM, Algorithm::EC);
+    original.push_back(KeyParameter{});
+    original.push_back(TAG_APPLICATION_ID, hidl_vec<uint8_t>({'a', 'p', 'p'}));
+
+    std::vector<uint8_t> flat;
+    ASSERT_TRUE(original.Serialize(&flat));
+    AuthorizationSet copied;
+    ASSERT_TRUE(copied.Deserialize(flat.data(), flat.size()));
+    ASSERT_EQ(3u, copied.size());
+    EXPECT_TRUE(original[0] == copied[0]);
+    EXPECT_TRUE(original[2] == copied[1]);
+    EXPECT_TRUE(KeyParameter{} == copied[2]);
+
+    std::vector<uint8_t> reserialized;
+    ASSERT_TRUE(copied.Serialize(&reserialized));
+    EXPECT_EQ(flat, reserialized);
+}
+
+TEST(AuthorizationSetSerializationTest, BoundsUnwrittenEntries) {
+    std::vector<uint8_t> bytes = toVector(kOnlyInvalidBytes);
+    AuthorizationSet set;
+    writeUint32(&bytes, 4, 1024);
+    ASSERT_TRUE(set.Deserialize(bytes.data(), bytes.size()));
+    EXPECT_EQ(1024u, set.size());
+
+    writeUint32(&bytes, 4, 1025);
+    EXPECT_FALSE(set.Deserialize(bytes.data(), bytes.size()));
+    EXPECT_TRUE(set.empty());
+}
+
+/*
+ * Replaces a fuzz target: replays a corpus of valid and corrupt blobs through checkSeed().
+ */
+TEST(AuthorizationSetSerializationTest, SeedCorpus) {
+    std::vector<std::vector<uint8_t>> seeds;
+    for (const auto& c : baselineCases()) {
+        seeds.push_back(c.bytes);
+    }
+
+    // Explicit INVALID tag in the element section, followed by unwritten entries.
+    seeds.push_back({0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00,
+                     0xf7, 0x01, 0x00, 0x70, 0x01, 0x00, 0x00, 0x00, 0x00});
+    // Bytes left in the element section after the counted entries.
+    seeds.push_back({0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00,
+                     0xf7, 0x01, 0x00, 0x70, 0x01, 0xf7, 0x01, 0x00, 0x70, 0x01});
+    // Element section ending inside a tag.
+    seeds.push_back({0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00,
+                     0xf7, 0x01, 0x00, 0x70, 0x01, 0xf7, 0x01});
+
+    // Every truncation and a bit flip at every position of the golden set.
+    for (size_t size = 0; size < sizeof(kGoldenBytes); ++size) {
+        seeds.push_back(std::vector<uint8_t>(kGoldenBytes, kGoldenBytes + size));
+    }
+    for (size_t i = 0; i < sizeof(kGoldenBytes) * 8; ++i) {
+        std::vector<uint8_t> bytes = goldenBytes();
+        bytes[i / 8] ^= 1 << (i % 8);
+        seeds.push_back(bytes);
+    }
+
+    for (size_t i = 0; i < seeds.size(); ++i) {
+        SCOPED_TRACE(i);
+        checkSeed(seeds[i]);
+    }
+}
+
+namespace {
+
+/*
+ * Reference model for the set operations: a plain vector manipulated the way AuthorizationSet did
+ * before it tracked sortedness, i.e. with linear scans only.
+ */
+typedef std::vector<KeyParameter> Model;
+
+const Tag kModelTags[] = {Tag::PURPOSE,          Tag::ALGORITHM,      Tag::KEY_SIZE,
+                          Tag::DIGEST,           Tag::NO_AUTH_REQUIRED, Tag::APPLICATION_ID,
+                          Tag::USER_SECURE_ID,   Tag::ACTIVE_DATETIME};
+
+KeyParameter randomParam(std::mt19937* rng) {
+    // Few distinct values, so duplicates and equal tags with different values are common.
+    uint32_t value = (*rng)() % 3;
+    switch ((*rng)() % 8) {
+        case 0:
+            return Authorization(TAG_PURPOSE, static_cast<KeyPurpose>(value));
+        case 1:
+            return Authorization(TAG_ALGORITHM, value ? Algorithm::EC : Algorithm::RSA);
+        case 2:
+            return Authorization(TAG_KEY_SIZE, 128 * (value + 1));
+        case 3:
+            return Authorization(TAG_DIGEST, static_cast<Digest>(value));
+        case 4:
+            return Authorization(TAG_NO_AUTH_REQUIRED);
+        case 5:
+            return Authorization(TAG_APPLICATION_ID,
+                                 hidl_vec<uint8_t>(std::vector<uint8_t>(value, 'a')));
+        case 6:
+            return Authorization(TAG_USER_SECURE_ID, uint64_t(value) << 40);
+        default:
+            return Authorization(TAG_ACTIVE_DATETIME, uint64_t(value));
+    }
+}
+
+AuthorizationSet randomSet(std::mt19937* rng, size_t maxSize) {
+    AuthorizationSet set;
+    size_t size = (*rng)() % (maxSize + 1);
+    for (size_t i = 0; i < size; ++i) set.push_back(randomParam(rng));
+    if ((*rng)() % 2) set.Sort();
+    return set;
+}
+
+Model toModel(const AuthorizationSet& set) {
+    return Model(set.begin(), set.end());
+}
+
+Model modelSort(const Model& model) {
+    // Sort() itself is unchanged, a fresh set only knows how to order the entries.
+    AuthorizationSet set;
+    for (const auto& param : model) set.push_back(param);
+    set.Sort();
+    return toModel(set);
+}
+
+Model modelDeduplicate(const Model& model) {
+    Model sorted = modelSort(model);
+    Model result;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        if (i + 1 < sorted.size() && sorted[i].tag == Tag::INVALID) continue;
+        if (i + 1 < sorted.size() && sorted[i] == sorted[i + 1]) continue;
+        result.push_back(sorted[i]);
+    }
+    return result;
+}
+
+Model modelUnion(Model model, const Model& other) {
+    model.insert(model.end(), other.begin(), other.end());
+    return modelDeduplicate(model);
+}
+
+Model modelSubtract(const Model& model, const Model& other) {
+    Model result = modelDeduplicate(model);
+    for (const auto& param : other) {
+        auto pos = std::find(result.begin(), result.end(), param);
+        if (pos != result.end()) result.erase(pos);
+    }
+    return result;
+}
+
+int modelFind(const Model& model, Tag tag, int begin) {
+    for (size_t i = begin + 1; i < model.size(); ++i) {
+        if (model[i].tag == tag) return i;
+    }
+    return -1;
+}
+
+void expectMatchesModel(const Model& model, const AuthorizationSet& set) {
+    ASSERT_EQ(model.size(), set.size());
+    for (size_t i = 0; i < model.size(); ++i) {
+        ASSERT_TRUE(model[i] == set[i]) << "at index " << i;
+    }
+    for (Tag tag : kModelTags) {
+        size_t count = 0;
+        int expected = -1;
+        int actual = -1;
+        do {
+            expected = modelFind(model, tag, expected);
+            actual = set.find(tag, actual);
+            ASSERT_EQ(expected, actual) << "tag " << static_cast<uint32_t>(tag);
+            if (expected != -1) ++count;
+        } while (expected != -1);
+        EXPECT_EQ(count, set.GetTagCount(tag)) << "tag " << static_cast<uint32_t>(tag);
+        EXPECT_EQ(count != 0, set.Contains(tag)) << "tag " << static_cast<uint32_t>(tag);
+    }
+}
+
+}  // namespace
+
+TEST(AuthorizationSetOperationsTest, UnionAndSubtractOfSortedAndUnsortedSets) {
+    std::mt19937 rng(1);
+    for (int i = 0; i < 500; ++i) {
+        AuthorizationSet a = randomSet(&rng, 12);
+        AuthorizationSet b = randomSet(&rng, 12);
+
+        AuthorizationSet united = a;
+        united.Union(b);
+        expectMatchesModel(modelUnion(toModel(a), toModel(b)), united);
+
+        AuthorizationSet subtracted = a;
+        subtracted.Subtract(b);
+        expectMatchesModel(modelSubtract(toModel(a), toModel(b)), subtracted);
+
+        // Subtracting a subset that is known to be sorted takes the merge path on both sides.
+        AuthorizationSet subset = a;
+        subset.Deduplicate();
+        while (!subset.empty() && rng() % 3) subset.erase(rng() % subset.size());
+        subtracted = a;
+        subtracted.Subtract(subset);
+        expectMatchesModel(modelSubtract(toModel(a), toModel(subset)), subtracted);
+    }
+}
+
+TEST(AuthorizationSetOperationsTest, SelfUnionAndSubtract) {
+    std::mt19937 rng(2);
+    for (int i = 0; i < 100; ++i) {
+        AuthorizationSet set = randomSet(&rng, 12);
+        Model model = toModel(set);
+
+        set.Union(set);
+        expectMatchesModel(modelDeduplicate(model), set);
+
+        set.Subtract(set);
+        EXPECT_TRUE(set.empty());
+    }
+}
+
+TEST(AuthorizationSetOperationsTest, MixedOperationsMatchLinearModel) {
+    std::mt19937 rng(3);
+    for (int run = 0; run < 50; ++run) {
+        AuthorizationSet set;
+        Model model;
+        for (int step = 0; step < 200; ++step) {
+            switch (rng() % 8) {
+                case 0:
+                case 1: {
+                    KeyParameter param = randomParam(&rng);
+                    set.push_back(param);
+                    model.push_back(param);
+                    break;
+                }
+                case 2:
+                    if (!model.empty()) {
+                        int index = rng() % model.size();
+                        ASSERT_TRUE(set.erase(index));
+                        model.erase(model.begin() + index);
+                    }
+                    break;
+                case 3: {
+                    AuthorizationSet other = randomSet(&rng, 6);
+                    set.Union(other);
+                    model = modelUnion(model, toModel(other));
+                    break;
+                }
+                case 4: {
+                    AuthorizationSet other = randomSet(&rng, 6);
+                    set.Subtract(other);
+                    model = modelSubtract(model, toModel(other));
+                    break;
+                }
+                case 5:
+                    set.Sort();
+                    model = modelSort(model);
+                    break;
+                case 6:
+                    set.Deduplicate();
+                    model = modelDeduplicate(model);
+                    break;
+                case 7:
+                    // Writing through operator[] may break the order of a sorted set.
+                    if (!model.empty()) {
+                        int index = rng() % model.size();
+                        KeyParameter param = randomParam(&rng);
+                        set[index] = param;
+                        model[index] = param;
+                    }
+                    break;
+            }
+            ASSERT_NO_FATAL_FAILURE(expectMatchesModel(model, set)) << "run " << run << " step "
+                                                                    << step;
+        }
+    }
+}
+
+}  // namespace test
+}  // namespace V4_0
+}  // namespace keymaster
+}  // namespace hardware
+}  // namespace android
@@ -56,7 +56,9 @@ static Result ResultFromStatus(status_t err) {
 Sensors::Sensors()
     : mInitCheck(NO_INIT),
       mSensorModule(nullptr),
-      mSensorDevice(nullptr) {
+      mSensorDevice(nullptr),
+      mPollBuffer(new sensors_event_t[kPollMaxBufferSize]),
+      mPollEvents(kPollMaxBufferSize) {
     status_t err = OK;
     if (UseMultiHal()) {
         mSensorModule = ::get_multi_hal_module_info();
@@ -162,9 +164,14 @@ Return<void> Sensors::poll(int32_t maxCount, poll_cb _hidl_cb) {
     hidl_vec<Event> out;
     hidl_vec<SensorInfo> dynamicSensorsAdded;
 
-    std::unique_ptr<sensors_event_t[]> data;
     int err = android::NO_ERROR;
 
+    // Guards mPollBuffer and mPollEvents, and is held until _hidl_cb(...) returns because |out|
+    // refers to mPollEvents. Unlike the re-entry lock below, waiting for it is fine: it is only
+    // contended while the previous call is still returning from _hidl_cb(...) on another
+    // binder thread.
+    std::unique_lock<std::mutex> bufferLock(mPollBufferLock, std::defer_lock);
+
     { // scope of reentry lock
 
         // This enforces a single client, meaning that a maximum of one client can call poll().
@@ -183,14 +190,15 @@ Return<void> Sensors::poll(int32_t maxCount, poll_cb _hidl_cb) {
             ::exit(-1);
         }
 
+        bufferLock.lock();
+
         if (maxCount <= 0) {
             err = android::BAD_VALUE;
         } else {
             int bufferSize = maxCount <= kPollMaxBufferSize ? maxCount : kPollMaxBufferSize;
-            data.reset(new sensors_event_t[bufferSize]);
             err = mSensorDevice->poll(
                     reinterpret_cast<sensors_poll_device_t *>(mSensorDevice),
-                    data.get(), bufferSize);
+                    mPollBuffer.get(), bufferSize);
         }
     }
 
@@ -200,6 +208,7 @@ Return<void> Sensors::poll(int32_t maxCount, poll_cb _hidl_cb) {
     }
 
     const size_t count = (size_t)err;
+    const sensors_event_t *data = mPollBuffer.get();
 
     for (size_t i = 0; i < count; ++i) {
         if (data[i].type != SENSOR_TYPE_DYNAMIC_SENSOR_META) {
@@ -223,8 +232,8 @@ Return<void> Sensors::poll(int32_t maxCount, poll_cb _hidl_cb) {
         dynamicSensorsAdded[numDynamicSensors] = info;
     }
 
-    out.resize(count);
-    convertFromSensorEvents(err, data.get(), &out);
+    convertFromSensorEvents(count, data, mPollEvents.data());
+    out.setToExternal(mPollEvents.data(), count);
 
     _hidl_cb(Result::OK, out, dynamicSensorsAdded);
 
@@ -328,19 +337,6 @@ Return<void> Sensors::configDirectReport(
     return Void();
 }
 
-// static
-void Sensors::convertFromSensorEvents(
-        size_t count,
-        const sensors_event_t *srcArray,
-        hidl_vec<Event> *dstVec) {
-    for (size_t i = 0; i < count; ++i) {
-        const sensors_event_t &src = srcArray[i];
-        Event *dst = &(*dstVec)[i];
-
-        convertFromSensorEvent(src, dst);
-    }
-}
-
 ISensors *HIDL_FETCH_ISensors(const char * /* hal */) {
     Sensors *sensors = new Sensors;
     if (sensors->initCheck() != OK) {
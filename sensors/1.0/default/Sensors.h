@@ -21,6 +21,7 @@
 #include <android-base/macros.h>
 #include <android/hardware/sensors/1.0/ISensors.h>
 #include <hardware/sensors.h>
+#include <memory>
 #include <mutex>
 
 namespace android {
@@ -68,12 +69,13 @@ private:
     sensors_module_t *mSensorModule;
     sensors_poll_device_1_t *mSensorDevice;
     std::mutex mPollLock;
+    std::mutex mPollBufferLock;
+    // Reused by every poll() call, guarded by mPollBufferLock.
+    std::unique_ptr<sensors_event_t[]> mPollBuffer;
+    hidl_vec<Event> mPollEvents;
 
     int getHalDeviceVersion() const;
 
-    static void convertFromSensorEvents(
-            size_t count, const sensors_event_t *src, hidl_vec<Event> *dst);
-
     DISALLOW_COPY_AND_ASSIGN(Sensors);
 };
 
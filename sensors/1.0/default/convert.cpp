@@ -207,6 +207,14 @@ void convertFromSensorEvent(const sensors_event_t &src, Event *dst) {
   }
 }
 
+void convertFromSensorEvents(size_t count, const sensors_event_t *src, Event *dst) {
+    // convertFromSensorEvent is in the same translation unit and gets inlined here, so
+    // converting a whole poll batch is a single tight loop without a call per event.
+    for (const sensors_event_t *end = src + count; src != end; ++src, ++dst) {
+        convertFromSensorEvent(*src, dst);
+    }
+}
+
 void convertToSensorEvent(const Event &src, sensors_event_t *dst) {
   *dst = {
       .version = sizeof(sensors_event_t),
@@ -43,6 +43,7 @@ LOCAL_SRC_FILES := \
     wifi_feature_flags.cpp \
     wifi_legacy_hal.cpp \
     wifi_legacy_hal_stubs.cpp \
+    wifi_link_layer_stats_sampler.cpp \
     wifi_mode_controller.cpp \
     wifi_nan_iface.cpp \
     wifi_p2p_iface.cpp \
@@ -106,7 +107,8 @@ LOCAL_SRC_FILES := \
     tests/mock_wifi_legacy_hal.cpp \
     tests/mock_wifi_mode_controller.cpp \
     tests/ringbuffer_unit_tests.cpp \
-    tests/wifi_chip_unit_tests.cpp
+    tests/wifi_chip_unit_tests.cpp \
+    tests/wifi_link_layer_stats_sampler_unit_tests.cpp
 LOCAL_STATIC_LIBRARIES := \
     libgmock \
     libgtest \
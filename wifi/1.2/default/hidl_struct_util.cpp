@@ -508,24 +508,25 @@ bool convertLegacyIeToHidl(
     if (!hidl_ie) {
         return false;
     }
-    *hidl_ie = {};
     hidl_ie->id = legacy_ie.id;
-    hidl_ie->data =
-        std::vector<uint8_t>(legacy_ie.data, legacy_ie.data + legacy_ie.len);
+    // Size the destination once and copy straight into it, instead of going
+    // through an intermediate std::vector.
+    hidl_ie->data.resize(legacy_ie.len);
+    if (legacy_ie.len > 0) {
+        memcpy(hidl_ie->data.data(), legacy_ie.data, legacy_ie.len);
+    }
     return true;
 }
 
-bool convertLegacyIeBlobToHidl(const uint8_t* ie_blob, uint32_t ie_blob_len,
-                               std::vector<WifiInformationElement>* hidl_ies) {
-    if (!ie_blob || !hidl_ies) {
-        return false;
-    }
-    *hidl_ies = {};
-    const uint8_t* ies_begin = ie_blob;
+// Walks the IE blob once without converting anything and returns the number
+// of complete IEs in it, so that the output vector can be sized up front.
+size_t countLegacyIesInBlob(const uint8_t* ie_blob, uint32_t ie_blob_len,
+                            const uint8_t** parsed_end) {
     const uint8_t* ies_end = ie_blob + ie_blob_len;
-    const uint8_t* next_ie = ies_begin;
+    const uint8_t* next_ie = ie_blob;
     using wifi_ie = legacy_hal::wifi_information_element;
     constexpr size_t kIeHeaderLen = sizeof(wifi_ie);
+    size_t num_ies = 0;
     // Each IE should atleast have the header (i.e |id| & |len| fields).
     while (next_ie + kIeHeaderLen <= ies_end) {
         const wifi_ie& legacy_ie = (*reinterpret_cast<const wifi_ie*>(next_ie));
@@ -536,19 +537,40 @@ bool convertLegacyIeBlobToHidl(const uint8_t* ie_blob, uint32_t ie_blob_len,
                        << ", IEs End: " << (void*)ies_end;
             break;
         }
-        WifiInformationElement hidl_ie;
-        if (!convertLegacyIeToHidl(legacy_ie, &hidl_ie)) {
+        num_ies++;
+        next_ie += curr_ie_len;
+    }
+    *parsed_end = next_ie;
+    return num_ies;
+}
+
+bool convertLegacyIeBlobToHidl(const uint8_t* ie_blob, uint32_t ie_blob_len,
+                               hidl_vec<WifiInformationElement>* hidl_ies) {
+    if (!ie_blob || !hidl_ies) {
+        return false;
+    }
+    const uint8_t* ies_end = ie_blob + ie_blob_len;
+    const uint8_t* parsed_end = ie_blob;
+    const size_t num_ies =
+        countLegacyIesInBlob(ie_blob, ie_blob_len, &parsed_end);
+    // Check if the blob can be fully consumed.
+    if (parsed_end != ies_end) {
+        LOG(ERROR) << "Failed to fully parse IE blob. Next IE: "
+                   << (void*)parsed_end << ", IEs End: " << (void*)ies_end;
+    }
+    hidl_ies->resize(num_ies);
+    using wifi_ie = legacy_hal::wifi_information_element;
+    constexpr size_t kIeHeaderLen = sizeof(wifi_ie);
+    const uint8_t* next_ie = ie_blob;
+    for (size_t ie_idx = 0; ie_idx < num_ies; ie_idx++) {
+        const wifi_ie& legacy_ie = (*reinterpret_cast<const wifi_ie*>(next_ie));
+        if (!convertLegacyIeToHidl(legacy_ie, &(*hidl_ies)[ie_idx])) {
             LOG(ERROR) << "Error converting IE. Id: " << legacy_ie.id
                        << ", len: " << legacy_ie.len;
+            hidl_ies->resize(ie_idx);
             break;
         }
-        hidl_ies->push_back(std::move(hidl_ie));
-        next_ie += curr_ie_len;
-    }
-    // Check if the blob has been fully consumed.
-    if (next_ie != ies_end) {
-        LOG(ERROR) << "Failed to fully parse IE blob. Next IE: "
-                   << (void*)next_ie << ", IEs End: " << (void*)ies_end;
+        next_ie += kIeHeaderLen + legacy_ie.len;
     }
     return true;
 }
@@ -561,10 +583,10 @@ bool convertLegacyGscanResultToHidl(
     }
     *hidl_scan_result = {};
     hidl_scan_result->timeStampInUs = legacy_scan_result.ts;
-    hidl_scan_result->ssid = std::vector<uint8_t>(
-        legacy_scan_result.ssid,
-        legacy_scan_result.ssid + strnlen(legacy_scan_result.ssid,
-                                          sizeof(legacy_scan_result.ssid) - 1));
+    const size_t ssid_len = strnlen(legacy_scan_result.ssid,
+                                    sizeof(legacy_scan_result.ssid) - 1);
+    hidl_scan_result->ssid.resize(ssid_len);
+    memcpy(hidl_scan_result->ssid.data(), legacy_scan_result.ssid, ssid_len);
     memcpy(hidl_scan_result->bssid.data(), legacy_scan_result.bssid,
            hidl_scan_result->bssid.size());
     hidl_scan_result->frequency = legacy_scan_result.channel;
@@ -572,13 +594,12 @@ bool convertLegacyGscanResultToHidl(
     hidl_scan_result->beaconPeriodInMs = legacy_scan_result.beacon_period;
     hidl_scan_result->capability = legacy_scan_result.capability;
     if (has_ie_data) {
-        std::vector<WifiInformationElement> ies;
         if (!convertLegacyIeBlobToHidl(
                 reinterpret_cast<const uint8_t*>(legacy_scan_result.ie_data),
-                legacy_scan_result.ie_length, &ies)) {
+                legacy_scan_result.ie_length,
+                &hidl_scan_result->informationElements)) {
             return false;
         }
-        hidl_scan_result->informationElements = std::move(ies);
     }
     return true;
 }
@@ -602,18 +623,16 @@ bool convertLegacyCachedGscanResultsToHidl(
 
     CHECK(legacy_cached_scan_result.num_results >= 0 &&
           legacy_cached_scan_result.num_results <= MAX_AP_CACHE_PER_SCAN);
-    std::vector<StaScanResult> hidl_scan_results;
+    // Size the results once and convert each entry in place.
+    hidl_scan_data->results.resize(legacy_cached_scan_result.num_results);
     for (int32_t result_idx = 0;
          result_idx < legacy_cached_scan_result.num_results; result_idx++) {
-        StaScanResult hidl_scan_result;
         if (!convertLegacyGscanResultToHidl(
                 legacy_cached_scan_result.results[result_idx], false,
-                &hidl_scan_result)) {
+                &hidl_scan_data->results[result_idx])) {
             return false;
         }
-        hidl_scan_results.push_back(hidl_scan_result);
     }
-    hidl_scan_data->results = std::move(hidl_scan_results);
     return true;
 }
 
@@ -625,13 +644,14 @@ bool convertLegacyVectorOfCachedGscanResultsToHidl(
         return false;
     }
     *hidl_scan_datas = {};
-    for (const auto& legacy_cached_scan_result : legacy_cached_scan_results) {
-        StaScanData hidl_scan_data;
-        if (!convertLegacyCachedGscanResultsToHidl(legacy_cached_scan_result,
-                                                   &hidl_scan_data)) {
+    hidl_scan_datas->resize(legacy_cached_scan_results.size());
+    for (size_t scan_idx = 0; scan_idx < legacy_cached_scan_results.size();
+         scan_idx++) {
+        if (!convertLegacyCachedGscanResultsToHidl(
+                legacy_cached_scan_results[scan_idx],
+                &(*hidl_scan_datas)[scan_idx])) {
             return false;
         }
-        hidl_scan_datas->push_back(hidl_scan_data);
     }
     return true;
 }
@@ -31,6 +31,10 @@ std::unique_lock<std::recursive_mutex> acquireGlobalLock() {
     return std::unique_lock<std::recursive_mutex>{g_mutex};
 }
 
+std::unique_lock<std::recursive_mutex> tryAcquireGlobalLock() {
+    return std::unique_lock<std::recursive_mutex>{g_mutex, std::try_to_lock};
+}
+
 }  // namespace hidl_sync_util
 }  // namespace implementation
 }  // namespace V1_2
@@ -28,6 +28,9 @@ namespace V1_2 {
 namespace implementation {
 namespace hidl_sync_util {
 std::unique_lock<std::recursive_mutex> acquireGlobalLock();
+// Non-blocking variant of |acquireGlobalLock|. The returned lock does not own
+// the mutex if it is currently held by another thread.
+std::unique_lock<std::recursive_mutex> tryAcquireGlobalLock();
 }  // namespace hidl_sync_util
 }  // namespace implementation
 }  // namespace V1_2
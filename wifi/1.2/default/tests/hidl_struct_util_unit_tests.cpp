@@ -122,6 +122,38 @@ TEST_F(HidlStructUtilTest, CanConvertLegacyWifiMacInfosToHidlWithTwoMac) {
     EXPECT_EQ(static_cast<uint32_t>(legacy_iface_info2.channel),
               hidl_iface_info2.channel);
 }
+
+TEST_F(HidlStructUtilTest, CanConvertLegacyGscanResultWithIesToHidl) {
+    // Two well-formed IEs followed by a truncated one.
+    const std::vector<uint8_t> ie_blob = {0x00, 0x04, 't',  'e',  's',
+                                          't',  0xdd, 0x02, 0x50, 0x6f,
+                                          0x30, 0x05, 0x01};
+    std::vector<uint8_t> legacy_buf(sizeof(legacy_hal::wifi_scan_result) +
+                                    ie_blob.size());
+    auto* legacy_scan_result =
+        reinterpret_cast<legacy_hal::wifi_scan_result*>(legacy_buf.data());
+    strncpy(legacy_scan_result->ssid, "test", sizeof(legacy_scan_result->ssid));
+    legacy_scan_result->rssi = -50;
+    legacy_scan_result->ie_length = ie_blob.size();
+    memcpy(legacy_scan_result->ie_data, ie_blob.data(), ie_blob.size());
+
+    StaScanResult hidl_scan_result;
+    ASSERT_TRUE(hidl_struct_util::convertLegacyGscanResultToHidl(
+        *legacy_scan_result, true, &hidl_scan_result));
+
+    EXPECT_EQ(std::vector<uint8_t>({'t', 'e', 's', 't'}),
+              std::vector<uint8_t>(hidl_scan_result.ssid));
+    EXPECT_EQ(-50, hidl_scan_result.rssi);
+    ASSERT_EQ(2u, hidl_scan_result.informationElements.size());
+    EXPECT_EQ(0x00, hidl_scan_result.informationElements[0].id);
+    EXPECT_EQ(std::vector<uint8_t>({'t', 'e', 's', 't'}),
+              std::vector<uint8_t>(
+                  hidl_scan_result.informationElements[0].data));
+    EXPECT_EQ(0xdd, hidl_scan_result.informationElements[1].id);
+    EXPECT_EQ(std::vector<uint8_t>({0x50, 0x6f}),
+              std::vector<uint8_t>(
+                  hidl_scan_result.informationElements[1].data));
+}
 }  // namespace implementation
 }  // namespace V1_2
 }  // namespace wifi
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2018, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <gmock/gmock.h>
+
+#include "wifi_link_layer_stats_sampler.h"
+
+using testing::Test;
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_2 {
+namespace implementation {
+
+class WifiLinkLayerStatsSamplerTest : public Test {
+   public:
+    const size_t maxDeltas_ = 2;
+    WifiLinkLayerStatsSampler sampler_{
+        [](legacy_hal::LinkLayerStats*) { return false; }, 1000, 10000,
+        maxDeltas_};
+
+    legacy_hal::LinkLayerStats createStats(uint32_t be_tx_mpdu,
+                                           uint32_t on_time) {
+        legacy_hal::LinkLayerStats stats{};
+        stats.iface.ac[legacy_hal::WIFI_AC_BE].tx_mpdu = be_tx_mpdu;
+        legacy_hal::LinkLayerRadioStats radio{};
+        radio.stats.on_time = on_time;
+        stats.radios.push_back(radio);
+        return stats;
+    }
+};
+
+TEST_F(WifiLinkLayerStatsSamplerTest, FirstSampleProducesNoDelta) {
+    sampler_.addSample(createStats(10, 100), 1000);
+    EXPECT_TRUE(sampler_.getDeltas().empty());
+}
+
+TEST_F(WifiLinkLayerStatsSamplerTest, ComputesDeltaBetweenSamples) {
+    sampler_.addSample(createStats(10, 100), 1000);
+    sampler_.addSample(createStats(25, 400), 1500);
+    const auto deltas = sampler_.getDeltas();
+    ASSERT_EQ(1u, deltas.size());
+    EXPECT_EQ(1500u, deltas[0].timestamp_ms);
+    EXPECT_EQ(500u, deltas[0].duration_ms);
+    EXPECT_EQ(15u, deltas[0].ac[legacy_hal::WIFI_AC_BE].tx_mpdu);
+    EXPECT_EQ(0u, deltas[0].ac[legacy_hal::WIFI_AC_VO].tx_mpdu);
+    ASSERT_EQ(1u, deltas[0].radios.size());
+    EXPECT_EQ(300u, deltas[0].radios[0].on_time);
+}
+
+TEST_F(WifiLinkLayerStatsSamplerTest, HandlesCounterWrapAround) {
+    sampler_.addSample(createStats(0xFFFFFFF0, 0), 1000);
+    sampler_.addSample(createStats(0x10, 0), 2000);
+    const auto deltas = sampler_.getDeltas();
+    ASSERT_EQ(1u, deltas.size());
+    EXPECT_EQ(0x20u, deltas[0].ac[legacy_hal::WIFI_AC_BE].tx_mpdu);
+}
+
+TEST_F(WifiLinkLayerStatsSamplerTest, OldDeltasAreRemovedOnOverflow) {
+    for (uint32_t i = 0; i < 4; i++) {
+        sampler_.addSample(createStats(i * 10, 0), i * 1000);
+    }
+    const auto deltas = sampler_.getDeltas();
+    ASSERT_EQ(maxDeltas_, deltas.size());
+    EXPECT_EQ(2000u, deltas.front().timestamp_ms);
+    EXPECT_EQ(3000u, deltas.back().timestamp_ms);
+}
+
+TEST_F(WifiLinkLayerStatsSamplerTest, NoCachedStatsWhenNotRunning) {
+    sampler_.addSample(createStats(10, 100), 1000);
+    legacy_hal::LinkLayerStats stats;
+    uint64_t timestamp_ms;
+    EXPECT_FALSE(sampler_.getCachedStats(&stats, &timestamp_ms));
+}
+
+TEST_F(WifiLinkLayerStatsSamplerTest, PollingPausesWithoutRequests) {
+    std::atomic<uint32_t> num_polls{0};
+    WifiLinkLayerStatsSampler sampler(
+        [&num_polls](legacy_hal::LinkLayerStats*) {
+            num_polls++;
+            return true;
+        },
+        10, 50, maxDeltas_);
+    sampler.start();
+    for (int i = 0; i < 100 && sampler.isPolling(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_FALSE(sampler.isPolling());
+    const uint32_t paused_num_polls = num_polls;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(paused_num_polls, num_polls);
+
+    // The stats are stale, but the request resumes polling.
+    legacy_hal::LinkLayerStats stats;
+    uint64_t timestamp_ms;
+    EXPECT_FALSE(sampler.getCachedStats(&stats, &timestamp_ms));
+    EXPECT_TRUE(sampler.isPolling());
+    for (int i = 0; i < 100 && num_polls == paused_num_polls; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_LT(paused_num_polls, num_polls);
+    sampler.stop();
+}
+}  // namespace implementation
+}  // namespace V1_2
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
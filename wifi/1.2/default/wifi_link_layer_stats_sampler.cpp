@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/logging.h>
+#include <utils/SystemClock.h>
+
+#include "wifi_link_layer_stats_sampler.h"
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_2 {
+namespace implementation {
+
+WifiLinkLayerStatsSampler::WifiLinkLayerStatsSampler(
+    const PollFunction& poll_fn, uint32_t interval_ms,
+    uint32_t idle_timeout_ms, size_t max_deltas)
+    : poll_fn_(poll_fn),
+      interval_ms_(interval_ms),
+      idle_timeout_ms_(idle_timeout_ms),
+      max_deltas_(max_deltas),
+      running_(false),
+      polling_(false),
+      last_request_ms_(0),
+      has_sample_(false),
+      last_sample_ms_(0),
+      last_stats_{} {}
+
+WifiLinkLayerStatsSampler::~WifiLinkLayerStatsSampler() { stop(); }
+
+void WifiLinkLayerStatsSampler::start() {
+    std::unique_lock<std::mutex> lock(lock_);
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    polling_ = true;
+    last_request_ms_ = uptimeMillis();
+    has_sample_ = false;
+    deltas_.clear();
+    sampler_thread_ =
+        std::thread(&WifiLinkLayerStatsSampler::samplerThreadLoop, this);
+}
+
+void WifiLinkLayerStatsSampler::stop() {
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+        polling_ = false;
+        has_sample_ = false;
+    }
+    wakeup_cv_.notify_all();
+    if (sampler_thread_.joinable()) {
+        sampler_thread_.join();
+    }
+}
+
+bool WifiLinkLayerStatsSampler::isRunning() {
+    std::unique_lock<std::mutex> lock(lock_);
+    return running_;
+}
+
+bool WifiLinkLayerStatsSampler::isPolling() {
+    std::unique_lock<std::mutex> lock(lock_);
+    return polling_;
+}
+
+bool WifiLinkLayerStatsSampler::getCachedStats(
+    legacy_hal::LinkLayerStats* stats, uint64_t* timestamp_ms) {
+    std::unique_lock<std::mutex> lock(lock_);
+    if (!running_) {
+        return false;
+    }
+    const uint64_t now_ms = uptimeMillis();
+    last_request_ms_ = now_ms;
+    if (!polling_) {
+        polling_ = true;
+        wakeup_cv_.notify_all();
+    }
+    if (!has_sample_) {
+        return false;
+    }
+    if (now_ms - last_sample_ms_ > 2 * static_cast<uint64_t>(interval_ms_)) {
+        return false;
+    }
+    *stats = last_stats_;
+    *timestamp_ms = last_sample_ms_;
+    return true;
+}
+
+std::vector<WifiLinkLayerStatsSampler::Delta>
+WifiLinkLayerStatsSampler::getDeltas() {
+    std::unique_lock<std::mutex> lock(lock_);
+    return std::vector<Delta>(deltas_.begin(), deltas_.end());
+}
+
+void WifiLinkLayerStatsSampler::addSample(
+    const legacy_hal::LinkLayerStats& stats, uint64_t timestamp_ms) {
+    std::unique_lock<std::mutex> lock(lock_);
+    if (has_sample_) {
+        // The legacy counters are unsigned 32 bit values, so the unsigned
+        // subtraction below also handles a counter wrapping around.
+        Delta delta{};
+        delta.timestamp_ms = timestamp_ms;
+        delta.duration_ms = timestamp_ms - last_sample_ms_;
+        for (size_t i = 0; i < delta.ac.size(); i++) {
+            const auto& cur = stats.iface.ac[i];
+            const auto& prev = last_stats_.iface.ac[i];
+            delta.ac[i].tx_mpdu = cur.tx_mpdu - prev.tx_mpdu;
+            delta.ac[i].rx_mpdu = cur.rx_mpdu - prev.rx_mpdu;
+            delta.ac[i].mpdu_lost = cur.mpdu_lost - prev.mpdu_lost;
+            delta.ac[i].retries = cur.retries - prev.retries;
+        }
+        if (stats.radios.size() == last_stats_.radios.size()) {
+            delta.radios.resize(stats.radios.size());
+            for (size_t i = 0; i < stats.radios.size(); i++) {
+                const auto& cur = stats.radios[i].stats;
+                const auto& prev = last_stats_.radios[i].stats;
+                delta.radios[i].on_time = cur.on_time - prev.on_time;
+                delta.radios[i].tx_time = cur.tx_time - prev.tx_time;
+                delta.radios[i].rx_time = cur.rx_time - prev.rx_time;
+                delta.radios[i].on_time_scan =
+                    cur.on_time_scan - prev.on_time_scan;
+            }
+        }
+        deltas_.push_back(std::move(delta));
+        while (deltas_.size() > max_deltas_) {
+            deltas_.pop_front();
+        }
+    }
+    last_stats_ = stats;
+    last_sample_ms_ = timestamp_ms;
+    has_sample_ = true;
+}
+
+void WifiLinkLayerStatsSampler::samplerThreadLoop() {
+    LOG(INFO) << "Starting link layer stats sampler, interval: "
+              << interval_ms_ << "ms";
+    std::unique_lock<std::mutex> lock(lock_);
+    while (running_) {
+        lock.unlock();
+        legacy_hal::LinkLayerStats stats{};
+        if (poll_fn_(&stats)) {
+            addSample(stats, uptimeMillis());
+        }
+        lock.lock();
+        wakeup_cv_.wait_for(lock, std::chrono::milliseconds(interval_ms_),
+                            [this] { return !running_; });
+        if (running_ &&
+            uptimeMillis() - last_request_ms_ >= idle_timeout_ms_) {
+            LOG(INFO) << "Pausing link layer stats sampler, no requests for "
+                      << idle_timeout_ms_ << "ms";
+            polling_ = false;
+            wakeup_cv_.wait(lock, [this] { return !running_ || polling_; });
+        }
+    }
+    LOG(INFO) << "Stopped link layer stats sampler";
+}
+
+}  // namespace implementation
+}  // namespace V1_2
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
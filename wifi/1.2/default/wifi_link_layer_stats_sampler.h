@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WIFI_LINK_LAYER_STATS_SAMPLER_H_
+#define WIFI_LINK_LAYER_STATS_SAMPLER_H_
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <android-base/macros.h>
+
+#include "wifi_legacy_hal.h"
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_2 {
+namespace implementation {
+
+/**
+ * Background sampler for link layer stats.
+ *
+ * Polls the legacy HAL at a fixed interval, caches the most recent stats so
+ * that |IWifiStaIface.getLinkLayerStats| can be served without a netlink round
+ * trip, and keeps a bounded history of per-AC/per-radio deltas between
+ * consecutive samples.
+ *
+ * Polling pauses once the cached stats have not been requested for
+ * |idle_timeout_ms| and resumes on the next request.
+ */
+class WifiLinkLayerStatsSampler {
+   public:
+    using PollFunction = std::function<bool(legacy_hal::LinkLayerStats*)>;
+
+    struct AcDelta {
+        uint32_t tx_mpdu;
+        uint32_t rx_mpdu;
+        uint32_t mpdu_lost;
+        uint32_t retries;
+    };
+    struct RadioDelta {
+        uint32_t on_time;
+        uint32_t tx_time;
+        uint32_t rx_time;
+        uint32_t on_time_scan;
+    };
+    struct Delta {
+        uint64_t timestamp_ms;
+        uint64_t duration_ms;
+        std::array<AcDelta, legacy_hal::WIFI_AC_MAX> ac;
+        // Empty if the number of radios changed between the two samples.
+        std::vector<RadioDelta> radios;
+    };
+
+    // |poll_fn| is invoked on the sampler thread. It may return false to skip
+    // a sample (e.g. if the legacy HAL is busy).
+    WifiLinkLayerStatsSampler(const PollFunction& poll_fn,
+                              uint32_t interval_ms, uint32_t idle_timeout_ms,
+                              size_t max_deltas);
+    ~WifiLinkLayerStatsSampler();
+
+    void start();
+    void stop();
+    bool isRunning();
+    // Returns false while polling is paused for lack of requests.
+    bool isPolling();
+    // Copies the last sample into |stats| if it is no older than twice the
+    // sampling interval. Returns false if no fresh sample is available.
+    // Resumes polling if it was paused.
+    bool getCachedStats(legacy_hal::LinkLayerStats* stats,
+                        uint64_t* timestamp_ms);
+    std::vector<Delta> getDeltas();
+    // Records a new sample and computes the delta against the previous one.
+    void addSample(const legacy_hal::LinkLayerStats& stats,
+                   uint64_t timestamp_ms);
+
+   private:
+    void samplerThreadLoop();
+
+    const PollFunction poll_fn_;
+    const uint32_t interval_ms_;
+    const uint32_t idle_timeout_ms_;
+    const size_t max_deltas_;
+    std::mutex lock_;
+    std::condition_variable wakeup_cv_;
+    std::thread sampler_thread_;
+    bool running_;
+    bool polling_;
+    uint64_t last_request_ms_;
+    bool has_sample_;
+    uint64_t last_sample_ms_;
+    legacy_hal::LinkLayerStats last_stats_;
+    std::deque<Delta> deltas_;
+
+    DISALLOW_COPY_AND_ASSIGN(WifiLinkLayerStatsSampler);
+};
+
+}  // namespace implementation
+}  // namespace V1_2
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
+
+#endif  // WIFI_LINK_LAYER_STATS_SAMPLER_H_
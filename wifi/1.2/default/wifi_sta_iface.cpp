@@ -14,10 +14,16 @@
  * limitations under the License.
  */
 
+#include <cinttypes>
+
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <cutils/properties.h>
 
 #include "hidl_return_util.h"
 #include "hidl_struct_util.h"
+#include "hidl_sync_util.h"
 #include "wifi_sta_iface.h"
 #include "wifi_status_util.h"
 
@@ -28,6 +34,19 @@ namespace V1_2 {
 namespace implementation {
 using hidl_return_util::validateAndCall;
 
+namespace {
+// Interval at which link layer stats are sampled in the background. Sampling
+// is disabled (and every request goes to the driver) when this is 0.
+constexpr char kLinkLayerStatsSampleIntervalProperty[] =
+    "vendor.wifi.llstats.sample_interval_ms";
+// Number of sampling intervals without a request for link layer stats after
+// which the sampler stops polling the driver. The framework polls the stats
+// every few seconds while it is interested in them.
+constexpr uint32_t kLinkLayerStatsSamplerIdleIntervals = 10;
+// Number of sample deltas retained by the sampler.
+constexpr size_t kMaxLinkLayerStatsDeltas = 64;
+}  // namespace
+
 WifiStaIface::WifiStaIface(
     const std::string& ifname,
     const std::weak_ptr<legacy_hal::WifiLegacyHal> legacy_hal)
@@ -42,6 +61,10 @@ WifiStaIface::WifiStaIface(
 }
 
 void WifiStaIface::invalidate() {
+    if (link_layer_stats_sampler_) {
+        link_layer_stats_sampler_->stop();
+        link_layer_stats_sampler_.reset();
+    }
     legacy_hal_.reset();
     event_cb_handler_.invalidate();
     is_valid_ = false;
@@ -248,6 +271,43 @@ Return<void> WifiStaIface::setMacAddress(const hidl_array<uint8_t, 6>& mac,
                            mac);
 }
 
+Return<void> WifiStaIface::debug(const hidl_handle& handle,
+                                 const hidl_vec<hidl_string>&) {
+    if (handle == nullptr || handle->numFds < 1) {
+        LOG(ERROR) << "File handle error";
+        return Void();
+    }
+    const auto lock = hidl_sync_util::acquireGlobalLock();
+    std::string dump = "Link layer stats sampler: ";
+    if (!link_layer_stats_sampler_) {
+        dump += "disabled\n";
+    } else {
+        dump += link_layer_stats_sampler_->isPolling() ? "polling\n"
+                                                       : "paused\n";
+        // Oldest first, counters per AC in VO/VI/BE/BK order.
+        for (const auto& delta : link_layer_stats_sampler_->getDeltas()) {
+            dump += android::base::StringPrintf(
+                "%" PRIu64 " +%" PRIu64 "ms", delta.timestamp_ms,
+                delta.duration_ms);
+            for (const auto& ac : delta.ac) {
+                dump += android::base::StringPrintf(
+                    " tx=%u rx=%u lost=%u retries=%u", ac.tx_mpdu,
+                    ac.rx_mpdu, ac.mpdu_lost, ac.retries);
+            }
+            for (const auto& radio : delta.radios) {
+                dump += android::base::StringPrintf(
+                    " on=%u tx_time=%u rx_time=%u scan=%u", radio.on_time,
+                    radio.tx_time, radio.rx_time, radio.on_time_scan);
+            }
+            dump += "\n";
+        }
+    }
+    if (!android::base::WriteStringToFd(dump, handle->data[0])) {
+        LOG(ERROR) << "Failed to write link layer stats dump";
+    }
+    return Void();
+}
+
 std::pair<WifiStatus, std::string> WifiStaIface::getNameInternal() {
     return {createWifiStatus(WifiStatusCode::SUCCESS), ifname_};
 }
@@ -436,10 +496,45 @@ WifiStatus WifiStaIface::stopBackgroundScanInternal(uint32_t cmd_id) {
 WifiStatus WifiStaIface::enableLinkLayerStatsCollectionInternal(bool debug) {
     legacy_hal::wifi_error legacy_status =
         legacy_hal_.lock()->enableLinkLayerStats(ifname_, debug);
-    return createWifiStatusFromLegacyError(legacy_status);
+    if (legacy_status != legacy_hal::WIFI_SUCCESS) {
+        return createWifiStatusFromLegacyError(legacy_status);
+    }
+    const int32_t interval_ms =
+        property_get_int32(kLinkLayerStatsSampleIntervalProperty, 0);
+    if (interval_ms > 0 && !link_layer_stats_sampler_) {
+        std::string ifname = ifname_;
+        std::weak_ptr<legacy_hal::WifiLegacyHal> weak_legacy_hal = legacy_hal_;
+        // The sampler thread must never block on the global lock, since the
+        // HIDL thread holds it while stopping the sampler.
+        const auto& poll_fn = [ifname, weak_legacy_hal](
+                                  legacy_hal::LinkLayerStats* stats) {
+            const auto lock = hidl_sync_util::tryAcquireGlobalLock();
+            if (!lock.owns_lock()) {
+                return false;
+            }
+            const auto legacy_hal_ptr = weak_legacy_hal.lock();
+            if (!legacy_hal_ptr) {
+                return false;
+            }
+            legacy_hal::wifi_error legacy_status;
+            std::tie(legacy_status, *stats) =
+                legacy_hal_ptr->getLinkLayerStats(ifname);
+            return legacy_status == legacy_hal::WIFI_SUCCESS;
+        };
+        link_layer_stats_sampler_.reset(new WifiLinkLayerStatsSampler(
+            poll_fn, interval_ms,
+            interval_ms * kLinkLayerStatsSamplerIdleIntervals,
+            kMaxLinkLayerStatsDeltas));
+        link_layer_stats_sampler_->start();
+    }
+    return createWifiStatus(WifiStatusCode::SUCCESS);
 }
 
 WifiStatus WifiStaIface::disableLinkLayerStatsCollectionInternal() {
+    if (link_layer_stats_sampler_) {
+        link_layer_stats_sampler_->stop();
+        link_layer_stats_sampler_.reset();
+    }
     legacy_hal::wifi_error legacy_status =
         legacy_hal_.lock()->disableLinkLayerStats(ifname_);
     return createWifiStatusFromLegacyError(legacy_status);
@@ -447,18 +542,28 @@ WifiStatus WifiStaIface::disableLinkLayerStatsCollectionInternal() {
 
 std::pair<WifiStatus, StaLinkLayerStats>
 WifiStaIface::getLinkLayerStatsInternal() {
-    legacy_hal::wifi_error legacy_status;
     legacy_hal::LinkLayerStats legacy_stats;
-    std::tie(legacy_status, legacy_stats) =
-        legacy_hal_.lock()->getLinkLayerStats(ifname_);
-    if (legacy_status != legacy_hal::WIFI_SUCCESS) {
-        return {createWifiStatusFromLegacyError(legacy_status), {}};
+    uint64_t sample_timestamp_ms = 0;
+    bool from_cache = link_layer_stats_sampler_ &&
+                      link_layer_stats_sampler_->getCachedStats(
+                          &legacy_stats, &sample_timestamp_ms);
+    if (!from_cache) {
+        legacy_hal::wifi_error legacy_status;
+        std::tie(legacy_status, legacy_stats) =
+            legacy_hal_.lock()->getLinkLayerStats(ifname_);
+        if (legacy_status != legacy_hal::WIFI_SUCCESS) {
+            return {createWifiStatusFromLegacyError(legacy_status), {}};
+        }
     }
     StaLinkLayerStats hidl_stats;
     if (!hidl_struct_util::convertLegacyLinkLayerStatsToHidl(legacy_stats,
                                                              &hidl_stats)) {
         return {createWifiStatus(WifiStatusCode::ERROR_UNKNOWN), {}};
     }
+    if (from_cache) {
+        // Report when the stats were actually collected from the driver.
+        hidl_stats.timeStampInMs = sample_timestamp_ms;
+    }
     return {createWifiStatus(WifiStatusCode::SUCCESS), hidl_stats};
 }
 
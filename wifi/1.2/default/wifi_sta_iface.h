@@ -25,6 +25,7 @@
 
 #include "hidl_callback_util.h"
 #include "wifi_legacy_hal.h"
+#include "wifi_link_layer_stats_sampler.h"
 
 namespace android {
 namespace hardware {
@@ -107,6 +108,9 @@ class WifiStaIface : public V1_2::IWifiStaIface {
         getDebugRxPacketFates_cb hidl_status_cb) override;
     Return<void> setMacAddress(const hidl_array<uint8_t, 6>& mac,
                                setMacAddress_cb hidl_status_cb) override;
+    // Dumps the link layer stats sampled in the background.
+    Return<void> debug(const hidl_handle& handle,
+                       const hidl_vec<hidl_string>& options) override;
 
    private:
     // Corresponding worker functions for the HIDL methods.
@@ -158,6 +162,8 @@ class WifiStaIface : public V1_2::IWifiStaIface {
     hidl_callback_util::HidlCallbackHandler<IWifiStaIfaceEventCallback>
         event_cb_handler_;
     wifi_system::InterfaceTool iface_tool_;
+    // Only set when background link layer stats sampling is enabled.
+    std::unique_ptr<WifiLinkLayerStatsSampler> link_layer_stats_sampler_;
 
     DISALLOW_COPY_AND_ASSIGN(WifiStaIface);
 };